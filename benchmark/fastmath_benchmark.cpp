@@ -0,0 +1,181 @@
+// ****
+// *
+// * Benchmark of the Fast Exp10 and Log10 Kernels for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+// Times <Exp10Array>, <Log10Array> and <CRadiation::GetGridRadiation> against loops of pow( 10.0, x ),
+// log10( x ) and <CRadiation::GetRadiation> / <CRadiation::GetFreeFreeRad>, and measures the largest error
+// of the array versions against long double. Build it once with and once without -DFASTMATH (see README.md)
+// and compare. Usage: fastmath_benchmark <configuration file>
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../source/fastmath.h"
+#include "../source/radiation.h"
+
+// Number of values in each array and number of times each timed loop is repeated
+#define NUM_VALUES 4096
+#define NUM_REPEATS 2000
+
+// Number of times each measurement is made, the fastest being reported
+#define NUM_TRIALS 5
+
+
+static double GetTime( void )
+{
+struct timespec t;
+
+clock_gettime( CLOCK_MONOTONIC, &t );
+
+return (double)t.tv_sec + 1E-9 * (double)t.tv_nsec;
+}
+
+// Largest difference between the values and the reference values in units of the last place of the reference values
+static double GetMaxUlpError( int iNumValues, double *py, long double *pRef )
+{
+double fUlp, fError, fMaxError = 0.0;
+int i;
+
+for( i=0; i<iNumValues; i++ )
+{
+    fUlp = nextafter( fabs( (double)pRef[i] ), HUGE_VAL ) - fabs( (double)pRef[i] );
+    fError = (double)( fabsl( (long double)py[i] - pRef[i] ) / (long double)fUlp );
+
+    if( fError > fMaxError )
+        fMaxError = fError;
+}
+
+return fMaxError;
+}
+
+int main( int argc, char **argv )
+{
+static double x[NUM_VALUES], z[NUM_VALUES], y[NUM_VALUES], T[NUM_VALUES], n[NUM_VALUES], Rad[NUM_VALUES], FreeFree[NUM_VALUES];
+static long double Ref[NUM_VALUES];
+PRADIATION pRadiation;
+double t0, fBest[6], fSum = 0.0, flog_10T, flog_10n;
+int i, j, k;
+
+if( argc < 2 )
+{
+    printf( "Usage: %s <configuration file>\n", argv[0] );
+    return 1;
+}
+
+#ifdef FASTMATH
+printf( "Built with FASTMATH\n\n" );
+#else // FASTMATH
+printf( "Built without FASTMATH\n\n" );
+#endif // FASTMATH
+
+// Exponents spanning the range of the radiation module's tables and their powers of 10
+srand( 1 );
+for( i=0; i<NUM_VALUES; i++ )
+{
+    x[i] = -30.0 + 60.0 * (double)rand() / (double)RAND_MAX;
+    z[i] = pow( 10.0, x[i] );
+}
+
+// A grid of cells spanning the transition region and corona, held in linear form
+for( i=0; i<NUM_VALUES; i++ )
+{
+    T[i] = pow( 10.0, 4.5 + 3.0 * (double)i / (double)NUM_VALUES );
+    n[i] = pow( 10.0, 11.0 - 2.0 * (double)i / (double)NUM_VALUES );
+}
+
+pRadiation = new CRadiation( argv[1], true );
+
+for( k=0; k<6; k++ )
+    fBest[k] = HUGE_VAL;
+
+for( j=0; j<NUM_TRIALS; j++ )
+{
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS; k++ )
+    {
+        for( i=0; i<NUM_VALUES; i++ )
+            y[i] = pow( 10.0, x[i] );
+        fSum += y[k%NUM_VALUES];
+    }
+    fBest[0] = fmin( fBest[0], GetTime() - t0 );
+
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS; k++ )
+    {
+        Exp10Array( NUM_VALUES, x, y );
+        fSum += y[k%NUM_VALUES];
+    }
+    fBest[1] = fmin( fBest[1], GetTime() - t0 );
+
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS; k++ )
+    {
+        for( i=0; i<NUM_VALUES; i++ )
+            y[i] = log10( z[i] );
+        fSum += y[k%NUM_VALUES];
+    }
+    fBest[2] = fmin( fBest[2], GetTime() - t0 );
+
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS; k++ )
+    {
+        Log10Array( NUM_VALUES, z, y );
+        fSum += y[k%NUM_VALUES];
+    }
+    fBest[3] = fmin( fBest[3], GetTime() - t0 );
+
+    // The radiation of each cell as a host holding linear values would calculate it without the grid function
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS/20; k++ )
+        for( i=0; i<NUM_VALUES; i++ )
+        {
+            flog_10T = log10( T[i] );
+            flog_10n = log10( n[i] );
+            Rad[i] = pRadiation->GetRadiation( flog_10T, flog_10n );
+            FreeFree[i] = pRadiation->GetFreeFreeRad( flog_10T, flog_10n );
+        }
+    fBest[4] = fmin( fBest[4], GetTime() - t0 );
+    fSum += Rad[j] + FreeFree[j];
+
+    t0 = GetTime();
+    for( k=0; k<NUM_REPEATS/20; k++ )
+        pRadiation->GetGridRadiation( NUM_VALUES, NULL, NULL, T, n, Rad, FreeFree );
+    fBest[5] = fmin( fBest[5], GetTime() - t0 );
+    fSum += Rad[j] + FreeFree[j];
+}
+
+printf( "Time per value (ns):\n" );
+printf( "  pow( 10.0, x ) loop          %8.2f\n", 1E9 * fBest[0] / ( (double)NUM_REPEATS * NUM_VALUES ) );
+printf( "  Exp10Array                   %8.2f\n", 1E9 * fBest[1] / ( (double)NUM_REPEATS * NUM_VALUES ) );
+printf( "  log10( x ) loop              %8.2f\n", 1E9 * fBest[2] / ( (double)NUM_REPEATS * NUM_VALUES ) );
+printf( "  Log10Array                   %8.2f\n", 1E9 * fBest[3] / ( (double)NUM_REPEATS * NUM_VALUES ) );
+printf( "Time per cell (ns):\n" );
+printf( "  GetRadiation + GetFreeFreeRad %7.2f\n", 1E9 * fBest[4] / ( (double)( NUM_REPEATS / 20 ) * NUM_VALUES ) );
+printf( "  GetGridRadiation              %7.2f\n", 1E9 * fBest[5] / ( (double)( NUM_REPEATS / 20 ) * NUM_VALUES ) );
+
+// Accuracy against long double
+for( i=0; i<NUM_VALUES; i++ )
+    Ref[i] = powl( 10.0L, (long double)x[i] );
+Exp10Array( NUM_VALUES, x, y );
+printf( "Largest error (ulp):\n" );
+printf( "  Exp10Array                   %8.2f\n", GetMaxUlpError( NUM_VALUES, y, Ref ) );
+
+for( i=0; i<NUM_VALUES; i++ )
+    Ref[i] = log10l( (long double)z[i] );
+Log10Array( NUM_VALUES, z, y );
+printf( "  Log10Array                   %8.2f\n", GetMaxUlpError( NUM_VALUES, y, Ref ) );
+
+// Prevent the timed loops from being removed
+if( fSum == 0.0 ) printf( "\n" );
+
+delete pRadiation;
+
+return 0;
+}
@@ -16,6 +16,7 @@
 #include <math.h>
 
 #include "OpticallyThickIon.h"
+#include "../fastmath.h"
 #include "../../../rsp_toolkit/source/file.h"
 #include "../../../rsp_toolkit/source/fitpoly.h"
 
@@ -434,7 +435,7 @@ y[2] = ppkappa_0[1][i];
 
 LinearFit( x, y, flog_10T, &fkappa_0 );
 
-return pow( 10.0, fkappa_0 );
+return Exp10( fkappa_0 );
 }
 
 double COpticallyThickIon::GetVolumetricLossRate( double flog_10T, double fX, double n_e_rho )
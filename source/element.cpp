@@ -15,12 +15,21 @@
 #include <math.h>
 
 #include "element.h"
+#include "interp.h"
+#include "fastmath.h"
 #include "../../rsp_toolkit/source/file.h"
 #include "../../rsp_toolkit/source/fitpoly.h"
 #include "../../rsp_toolkit/source/constants.h"
 #include "../../rsp_toolkit/source/xmlreader.h"
 
 
+// Accuracies of the characteristic time-scale where the ion populations are not transported:
+// epsilon_d = 0.1 and, from epsilon_r = 0.6, 0.5 * ( |10^-epsilon_r - 1| + 10^epsilon_r - 1 )
+// = 0.5 * ( 0.748811357 + 2.981071706 ) = 1.864941531
+#define LOCAL_EPSILON_D 0.1
+#define LOCAL_EPSILON_R 1.864941531
+
+
 CElement::CElement( int iZ, char *szRangesFilename, char *szAbundFilename, char *szEmissFilename, char *szRatesFilename, char *szIonFracFilename, bool doEmissCalc, tinyxml2::XMLElement *root )
 {
 SetConfigVars(root);
@@ -40,6 +49,11 @@ Z = iZ;
 // Set emission calc bool for use in IonPopSolver
 do_emiss_calc = doEmissCalc;
 
+// The equilibrium ion population fractions are on a uniform grid if they are calculated from the rates
+uniform_equilibrium = equilibrium_from_rates;
+bFineTables = false;
+bLogTables = false;
+
 // Open the data files and initialise the element
 OpenRangesFile( szRangesFilename );
 OpenAbundanceFile( szAbundFilename );
@@ -48,7 +62,15 @@ if(do_emiss_calc)
 	OpenEmissivityFile( szEmissFilename );
 }
 OpenRatesFile( szRatesFilename );
-OpenIonFracFile( szIonFracFilename );
+if(equilibrium_from_rates)
+{
+	// Calculate the ionisation balance consistent with the rates
+	CalculateEquilIonFrac();
+}
+else
+{
+	OpenIonFracFile( szIonFracFilename );
+}
 
 if(do_emiss_calc)
 {
@@ -57,6 +79,14 @@ if(do_emiss_calc)
 	// Calculate the total phi of all radiating elements as a function of temperature and density
 	CalculateTotalPhi();
 }
+
+// Resample the temperature only tables once phi has been calculated from the tabulated values
+if( !density_dependent_rates && ( fine_table_resolution > 0.0 || fine_table_tolerance > 0.0 ) )
+	ResampleFineTables();
+
+// Hold the tables as log_10 values once every quantity derived from them has been calculated
+if( log_space_tables )
+	ConvertTablesToLog10();
 }
 
 void CElement::SetConfigVars(tinyxml2::XMLElement *root)
@@ -69,6 +99,33 @@ void CElement::SetConfigVars(tinyxml2::XMLElement *root)
 	epsilon_d = atof(check_element(recursive_read(root,"epsilon_d"),"epsilon_d")->GetText());
 	epsilon_r = atof(check_element(recursive_read(root,"epsilon_r"),"epsilon_r")->GetText());
 	max_optically_thin_density = atof(check_element(recursive_read(root,"max_optically_thin_density"),"max_optically_thin_density")->GetText());
+
+	//Optional config variables take their default values if they are not present
+	tinyxml2::XMLElement *pOption;
+	pOption = recursive_read(root,"equilibrium_from_rates");
+	equilibrium_from_rates = pOption ? string2bool(pOption->GetText()) : false;
+	pOption = recursive_read(root,"equilibrium_resolution");
+	equilibrium_resolution = pOption ? atof(pOption->GetText()) : 0.01;
+	pOption = recursive_read(root,"fine_table_resolution");
+	fine_table_resolution = pOption ? atof(pOption->GetText()) : 0.0;
+	pOption = recursive_read(root,"fine_table_tolerance");
+	fine_table_tolerance = pOption ? atof(pOption->GetText()) : 0.0;
+	pOption = recursive_read(root,"log_space_tables");
+	log_space_tables = pOption ? string2bool(pOption->GetText()) : false;
+	pOption = recursive_read(root,"rates_interpolation");
+	rates_interpolation = pOption ? GetInterpolationOrder(pOption->GetText()) : INTERP_CUBIC;
+	pOption = recursive_read(root,"balances_interpolation");
+	balances_interpolation = pOption ? GetInterpolationOrder(pOption->GetText()) : INTERP_CUBIC;
+	pOption = recursive_read(root,"emissivities_interpolation");
+	emissivities_interpolation = pOption ? GetInterpolationOrder(pOption->GetText()) : INTERP_CUBIC;
+	pOption = recursive_read(root,"total_phi_interpolation");
+	total_phi_interpolation = pOption ? GetInterpolationOrder(pOption->GetText()) : INTERP_CUBIC;
+
+	//Select the interpolation kernel of each table once rather than on every look-up
+	pRatesKernel = GetInterpolationKernel(rates_interpolation);
+	pBalancesKernel = GetInterpolationKernel(balances_interpolation);
+	pEmissivitiesKernel = GetInterpolationKernel(emissivities_interpolation);
+	pTotalPhiKernel = GetInterpolationKernel(total_phi_interpolation);
 }
 
 void CElement::OpenRangesFile( char *szRangesFilename )
@@ -190,6 +247,19 @@ while( buffer != '.' )
 for( i=0; i<NumIons; i++ )
     fscanf( pFile, "%i", &pSpecNum[i] );
 
+// Index the emissivities by ion, so that the file need not list the ions in order of spectroscopic number
+pEmissIndex = (int*)malloc( sizeof(int) * ( Z + 1 ) );
+for( i=0; i<=Z; i++ )
+    pEmissIndex[i] = -1;
+
+for( i=0; i<NumIons; i++ )
+{
+    if( pSpecNum[i] >= 1 && pSpecNum[i] <= Z + 1 && pEmissIndex[pSpecNum[i]-1] == -1 )
+        pEmissIndex[pSpecNum[i]-1] = i;
+    else
+        printf( "Warning: ion %i of element %i is out of range or repeated in %s and is ignored by the fused calculations.\n", pSpecNum[i], Z, szEmissFilename );
+}
+
 // Get the emissivity values for each ion
 
 // Allocate an array to hold the pointers to the emissivity for each ion
@@ -328,6 +398,278 @@ for( j=0; j<NumTempxNumDen; j++ )
 fclose( pFile );
 }
 
+void CElement::CalculateEquilIonFrac( void )
+{
+double *pIonRate, *pRecRate, *plog_10ni, flog_10T, fRatio, fMax, fTotal;
+int i, j, k, iNumDen, NumEquilTempxNumDen;
+
+// The temperature values span the tabulated range with the requested spacing
+NumEquilTemp = (int)ceil( ( pTemp[NumTemp-1] - pTemp[0] ) / equilibrium_resolution ) + 1;
+if( NumEquilTemp < 2 ) NumEquilTemp = 2;
+
+if(density_dependent_rates)
+    iNumDen = NumDen;
+else
+    iNumDen = 1;
+
+NumEquilTempxNumDen = NumEquilTemp * iNumDen;
+
+// Allocate arrays to hold the pointers to the fractional populations for each ion
+ppIonFrac = (double**)malloc( sizeof(double*) * ( Z + 1 ) );
+for( i=0; i<=Z; i++ )
+    ppIonFrac[i] = (double*)malloc( sizeof(double) * NumEquilTempxNumDen );
+
+pIonRate = (double*)alloca( sizeof(double) * Z );
+pRecRate = (double*)alloca( sizeof(double) * Z );
+plog_10ni = (double*)alloca( sizeof(double) * ( Z + 1 ) );
+
+for( k=0; k<iNumDen; k++ )
+    for( j=0; j<NumEquilTemp; j++ )
+    {
+        flog_10T = pTemp[0] + j * ( pTemp[NumTemp-1] - pTemp[0] ) / ( NumEquilTemp - 1 );
+
+        if(density_dependent_rates)
+            GetAllRates( flog_10T, pDen[k], pIonRate, pRecRate );
+        else
+            GetAllRates( flog_10T, pIonRate, pRecRate, NULL, NULL );
+
+        // In equilibrium the net rate between each pair of adjacent ions is zero, so that
+        // n(i+1) / n(i) = IonRate(i) / RecRate(i). The populations are built up as the
+        // product of these ratios in log space to avoid overflow
+        plog_10ni[0] = fMax = 0.0;
+        for( i=0; i<Z; i++ )
+        {
+            // An ion that cannot be ionised (or recombined into) isolates the ions above (or below) it
+            if( pIonRate[i] <= 0.0 )
+                fRatio = -1000.0;
+            else if( pRecRate[i] <= 0.0 )
+                fRatio = 1000.0;
+            else
+                fRatio = log10( pIonRate[i] / pRecRate[i] );
+
+            plog_10ni[i+1] = plog_10ni[i] + fRatio;
+
+            if( plog_10ni[i+1] > fMax )
+                fMax = plog_10ni[i+1];
+        }
+
+        fTotal = 0.0;
+        for( i=0; i<=Z; i++ )
+        {
+            plog_10ni[i] = pow( 10.0, plog_10ni[i] - fMax );
+            fTotal += plog_10ni[i];
+        }
+
+        for( i=0; i<=Z; i++ )
+            ppIonFrac[i][k*NumEquilTemp+j] = plog_10ni[i] / fTotal;
+    }
+}
+
+void CElement::InterpolateTables( double **ppTable, int iNumTables, double flog_10T, double *pValue )
+{
+double x[4], w[4];
+int i, j, l;
+
+// Select the four temperature values surrounding the desired one
+j = LocateStencil( pTemp, NumTemp, &flog_10T );
+
+for( l=0; l<4; l++ )
+    x[l] = pTemp[j+l-2];
+
+GetLagrangeWeights( x, 4, flog_10T, w, NULL );
+
+for( i=0; i<iNumTables; i++ )
+{
+    pValue[i] = 0.0;
+    for( l=0; l<4; l++ )
+        pValue[i] += w[l] * ppTable[i][j+l-2];
+
+    // Check values are physically realistic
+    if( pValue[i] < 0.0 ) pValue[i] = 0.0;
+}
+}
+
+void CElement::ResampleFineTables( void )
+{
+double **ppTable, **ppFineIonFrac, *pLower, *pUpper, *pMid, *pScale, *pfSwap, fRange, fSpacing, fError, fMaxError;
+int i, j, iNumTables, iNumIonFrac;
+
+fRange = pTemp[NumTemp-1] - pTemp[0];
+
+// The rates are resampled together with the ionisation balance if it was read from file (the
+// ionisation balance calculated from the rates is already on a uniform grid)
+iNumIonFrac = equilibrium_from_rates ? 0 : Z + 1;
+iNumTables = 2 * Z + iNumIonFrac;
+
+ppTable = (double**)alloca( sizeof(double*) * iNumTables );
+for( i=0; i<Z; i++ )
+{
+    ppTable[i] = ppIonRate[i];
+    ppTable[Z+i] = ppRecRate[i];
+}
+for( i=0; i<iNumIonFrac; i++ )
+    ppTable[2*Z+i] = ppIonFrac[i];
+
+pLower = (double*)alloca( sizeof(double) * iNumTables );
+pUpper = (double*)alloca( sizeof(double) * iNumTables );
+pMid = (double*)alloca( sizeof(double) * iNumTables );
+
+if( fine_table_resolution > 0.0 )
+{
+    NumFineTemp = (int)ceil( fRange / fine_table_resolution ) + 1;
+    if( NumFineTemp < 2 ) NumFineTemp = 2;
+}
+else
+{
+    // The error of each table is measured relative to its value, but not relative to values smaller
+    // than a millionth of its largest tabulated value
+    pScale = (double*)alloca( sizeof(double) * iNumTables );
+    for( i=0; i<iNumTables; i++ )
+    {
+        pScale[i] = 0.0;
+        for( j=0; j<NumTemp; j++ )
+            if( fabs( ppTable[i][j] ) > pScale[i] )
+                pScale[i] = fabs( ppTable[i][j] );
+        pScale[i] *= 1E-6;
+    }
+
+    // Halve the spacing, starting from the average tabulated spacing, until linear interpolation between
+    // adjacent fine values reproduces the polynomial interpolation at every midpoint within the tolerance
+    NumFineTemp = NumTemp;
+    for( ;; )
+    {
+        fSpacing = fRange / ( NumFineTemp - 1 );
+        fMaxError = 0.0;
+
+        InterpolateTables( ppTable, iNumTables, pTemp[0], pLower );
+        for( j=1; j<NumFineTemp; j++ )
+        {
+            InterpolateTables( ppTable, iNumTables, pTemp[0] + j * fSpacing, pUpper );
+            InterpolateTables( ppTable, iNumTables, pTemp[0] + ( j - 0.5 ) * fSpacing, pMid );
+
+            for( i=0; i<iNumTables; i++ )
+            {
+                fError = fabs( 0.5 * ( pLower[i] + pUpper[i] ) - pMid[i] ) / max( pMid[i], pScale[i] );
+                if( fError > fMaxError )
+                    fMaxError = fError;
+            }
+
+            pfSwap = pLower;
+            pLower = pUpper;
+            pUpper = pfSwap;
+        }
+
+        if( fMaxError <= fine_table_tolerance || 2 * NumFineTemp - 1 > MAX_FINE_TABLE_TEMP ) break;
+
+        NumFineTemp = 2 * NumFineTemp - 1;
+    }
+}
+
+fSpacing = fRange / ( NumFineTemp - 1 );
+fInvFineSpacing = 1.0 / fSpacing;
+
+// Allocate the fine tables
+ppFineIonRate = (double**)malloc( sizeof(double*) * Z );
+ppFineRecRate = (double**)malloc( sizeof(double*) * Z );
+for( i=0; i<Z; i++ )
+{
+    ppFineIonRate[i] = (double*)malloc( sizeof(double) * NumFineTemp );
+    ppFineRecRate[i] = (double*)malloc( sizeof(double) * NumFineTemp );
+}
+
+ppFineIonFrac = (double**)malloc( sizeof(double*) * ( Z + 1 ) );
+for( i=0; i<iNumIonFrac; i++ )
+    ppFineIonFrac[i] = (double*)malloc( sizeof(double) * NumFineTemp );
+
+for( j=0; j<NumFineTemp; j++ )
+{
+    // The last value is taken at the end of the tabulated range exactly
+    InterpolateTables( ppTable, iNumTables, j < NumFineTemp-1 ? pTemp[0] + j * fSpacing : pTemp[NumTemp-1], pMid );
+
+    for( i=0; i<Z; i++ )
+    {
+        ppFineIonRate[i][j] = pMid[i];
+        ppFineRecRate[i][j] = pMid[Z+i];
+    }
+    for( i=0; i<iNumIonFrac; i++ )
+        ppFineIonFrac[i][j] = pMid[2*Z+i];
+}
+
+if( iNumIonFrac )
+{
+    // Replace the ionisation balance read from file, which is then looked up in the same way as the
+    // ionisation balance calculated from the rates
+    for( i=0; i<=Z; i++ )
+        free( ppIonFrac[i] );
+    free( ppIonFrac );
+
+    ppIonFrac = ppFineIonFrac;
+    NumEquilTemp = NumFineTemp;
+    uniform_equilibrium = true;
+}
+else
+    free( ppFineIonFrac );
+
+bFineTables = true;
+}
+
+int CElement::LocateFineTemp( double flog_10T, double *px )
+{
+int j;
+
+// If the temperature is out of range then set it to the appropriate limit
+if( flog_10T < pTemp[0] )
+    flog_10T = pTemp[0];
+else if( flog_10T > pTemp[NumTemp-1] )
+    flog_10T = pTemp[NumTemp-1];
+
+// The temperature values are uniformly spaced, so the two surrounding the desired one are found directly
+*px = ( flog_10T - pTemp[0] ) * fInvFineSpacing;
+j = (int)*px;
+if( j > NumFineTemp-2 ) j = NumFineTemp-2;
+*px -= j;
+
+return j;
+}
+
+long CElement::GetFineTableSize( void )
+{
+if( !bFineTables ) return 0;
+
+// The rates, and the ionisation balance if it was resampled from the file
+return (long)sizeof(double) * NumFineTemp * ( 2 * Z + ( equilibrium_from_rates ? 0 : Z + 1 ) );
+}
+
+void CElement::ConvertTablesToLog10( void )
+{
+int i, iNumValues;
+
+// The rates are tabulated against temperature and density only if they are density dependent
+if( density_dependent_rates )
+    iNumValues = NumTemp * NumDen;
+else
+    iNumValues = NumTemp;
+
+for( i=0; i<Z; i++ )
+{
+    ConvertToLog10( ppIonRate[i], iNumValues );
+    ConvertToLog10( ppRecRate[i], iNumValues );
+}
+
+if( do_emiss_calc )
+{
+    for( i=0; i<NumIons; i++ )
+    {
+        ConvertToLog10( ppEmiss[i], NumTemp * NumDen );
+        ConvertToLog10( ppPhi[i], NumTemp * NumDen );
+    }
+
+    ConvertToLog10( pTotalPhi, NumTemp * NumDen );
+}
+
+bLogTables = true;
+}
+
 void CElement::CalculatePhi( void )
 {
 int i, j, NumTempxNumDen, indexTemp, indexDen;
@@ -395,6 +737,7 @@ int i;
 if(do_emiss_calc)
 {
 	free( pSpecNum );
+	free( pEmissIndex );
 }
 free( pTemp );
 free( pDen );
@@ -427,6 +770,17 @@ if(do_emiss_calc)
 }
 free( ppIonRate );
 free( ppRecRate );
+
+if( bFineTables )
+{
+    for( i=0; i<Z; i++ )
+    {
+        free( ppFineIonRate[i] );
+        free( ppFineRecRate[i] );
+    }
+    free( ppFineIonRate );
+    free( ppFineRecRate );
+}
 free( ppIonFrac );
 if(do_emiss_calc)
 {
@@ -447,6 +801,15 @@ for( i=0; i<NumIons; i++ )
 // If the requested ion is not in the list of spectroscopic numbers then return 0.0
 if( i == NumIons ) return 0.0;
 
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 emissivity between the two temperature and two density values surrounding the desired ones
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, x1 );
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n, x2 );
+
+    return GetLog10TableValue( ppEmiss[i], NumTemp, j, x1[0], k, x2[0] );
+}
+
 // Select the four temperature values surrounding the desired one
 
 // If the temperature is out of range then set it to the appropriate limit
@@ -489,6 +852,9 @@ x2[2] = pDen[k-1];
 x2[3] = pDen[k];
 x2[4] = pDen[k+1];
 
+if( emissivities_interpolation != INTERP_CUBIC )
+    return InterpolateStencil2D( pEmissivitiesKernel, ppEmiss[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
 // We are using the i'th ion
 // We are using the j-2, j-1, j and j+1 'th temperature values
 // We are using the k-2, k-1, k and k+1 'th density values
@@ -536,7 +902,7 @@ return fAbund;
 
 void CElement::GetRates( int iIon, double flog_10T, double *pfIonRate, double *pfRecRate )
 {
-double x[5], Ion_y[5], Rec_y[5], error;
+double x[5], Ion_y[5], Rec_y[5], error, xFine;
 int i, j;
 
 if( !iIon || iIon > Z )
@@ -550,6 +916,28 @@ if( !iIon || iIon > Z )
 // Select the required ion
 i = iIon - 1;
 
+if( bFineTables )
+{
+    // Linear interpolation between the two fine uniform values surrounding the desired one
+    j = LocateFineTemp( flog_10T, &xFine );
+
+    *pfIonRate = ppFineIonRate[i][j] + xFine * ( ppFineIonRate[i][j+1] - ppFineIonRate[i][j] );
+    *pfRecRate = ppFineRecRate[i][j] + xFine * ( ppFineRecRate[i][j+1] - ppFineRecRate[i][j] );
+
+    return;
+}
+
+if( bLogTables )
+{
+    // Linear interpolation of log_10 rates between the two temperature values surrounding the desired one
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, &xFine );
+
+    *pfIonRate = GetLog10TableValue( ppIonRate[i], j, xFine );
+    *pfRecRate = GetLog10TableValue( ppRecRate[i], j, xFine );
+
+    return;
+}
+
 // Select the four temperature values, ionisation and recombination rates surrounding 
 // the desired one
 
@@ -572,6 +960,14 @@ x[2] = pTemp[j-1];
 x[3] = pTemp[j];
 x[4] = pTemp[j+1];
 
+if( rates_interpolation != INTERP_CUBIC )
+{
+    *pfIonRate = pRatesKernel( pTemp + j - 2, ppIonRate[i] + j - 2, flog_10T, NULL );
+    *pfRecRate = pRatesKernel( pTemp + j - 2, ppRecRate[i] + j - 2, flog_10T, NULL );
+
+    return;
+}
+
 Ion_y[1] = ppIonRate[i][j-2];
 Ion_y[2] = ppIonRate[i][j-1];
 Ion_y[3] = ppIonRate[i][j];
@@ -607,6 +1003,18 @@ if( !iIon || iIon > Z )
 // Select the required ion
 i = iIon - 1;
 
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 rates between the two temperature and two density values surrounding the desired ones
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, x1 );
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n, x2 );
+
+    *pfIonRate = GetLog10TableValue( ppIonRate[i], NumTemp, j, x1[0], k, x2[0] );
+    *pfRecRate = GetLog10TableValue( ppRecRate[i], NumTemp, j, x1[0], k, x2[0] );
+
+    return;
+}
+
 // Select the four temperature values, ionisation and recombination rates surrounding 
 // the desired one
 
@@ -650,6 +1058,14 @@ x2[2] = pDen[k-1];
 x2[3] = pDen[k];
 x2[4] = pDen[k+1];
 
+if( rates_interpolation != INTERP_CUBIC )
+{
+    *pfIonRate = InterpolateStencil2D( pRatesKernel, ppIonRate[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+    *pfRecRate = InterpolateStencil2D( pRatesKernel, ppRecRate[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
+    return;
+}
+
 // We are using the i'th ion
 // We are using the j-2, j-1, j and j+1 'th temperature values
 // We are using the k-2, k-1, k and k+1 'th density values
@@ -713,6 +1129,9 @@ int i, j;
 if( !iIon || iIon > Z+1 )
     return 0.0;
 
+if(uniform_equilibrium)
+    return GetRatesEquilIonFrac( iIon, flog_10T );
+
 // Select the required ion
 i = iIon - 1;
 
@@ -738,6 +1157,17 @@ x[2] = pTemp[j-1];
 x[3] = pTemp[j];
 x[4] = pTemp[j+1];
 
+if( balances_interpolation != INTERP_CUBIC )
+{
+    IonFrac = pBalancesKernel( pTemp + j - 2, ppIonFrac[i] + j - 2, flog_10T, NULL );
+
+    // Ensure the minimum ion fraction remains above the cut-off
+    if( IonFrac < cutoff_ion_fraction )
+        IonFrac = 0.0;
+
+    return IonFrac;
+}
+
 y[1] = ppIonFrac[i][j-2];
 y[2] = ppIonFrac[i][j-1];
 y[3] = ppIonFrac[i][j];
@@ -761,6 +1191,9 @@ int i, j, k, l;
 if( !iIon || iIon > Z+1 )
     return 0.0;
 
+if(uniform_equilibrium)
+    return GetRatesEquilIonFrac( iIon, flog_10T, flog_10n );
+
 // Select the required ion
 i = iIon - 1;
 
@@ -807,6 +1240,17 @@ x2[2] = pDen[k-1];
 x2[3] = pDen[k];
 x2[4] = pDen[k+1];
 
+if( balances_interpolation != INTERP_CUBIC )
+{
+    IonFrac = InterpolateStencil2D( pBalancesKernel, ppIonFrac[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
+    // Ensure the minimum ion fraction remains above the cut-off
+    if( IonFrac < cutoff_ion_fraction )
+        IonFrac = 0.0;
+
+    return IonFrac;
+}
+
 // We are using the i'th ion
 // We are using the j-2, j-1, j and j+1 'th temperature values
 // We are using the k-2, k-1, k and k+1 'th density values
@@ -845,20 +1289,13 @@ if( IonFrac < cutoff_ion_fraction )
 return IonFrac;
 }
 
-double CElement::GetEmissivity( int iIon, double flog_10T, double flog_10n )
+double CElement::GetRatesEquilIonFrac( int iIon, double flog_10T )
 {
-double x1[5], x2[5], **y, *pfTemp, result, error;
-int i, j, k, l;
+double x, IonFrac;
+int i, j;
 
 // Select the required ion
-
-for( i=0; i<NumIons; i++ )
-    if( iIon == pSpecNum[i] ) break;
-
-// If the requested ion is not in the list of spectroscopic numbers then return 0.0
-if( i == NumIons ) return 0.0;
-
-// Select the four temperature values surrounding the desired one
+i = iIon - 1;
 
 // If the temperature is out of range then set it to the appropriate limit
 if( flog_10T < pTemp[0] )
@@ -866,64 +1303,371 @@ if( flog_10T < pTemp[0] )
 else if( flog_10T > pTemp[NumTemp-1] )
     flog_10T = pTemp[NumTemp-1];
 
-for( j=0; j<NumTemp; j++ )
-    if( pTemp[j] >= flog_10T ) break;
+// The temperature values are uniformly spaced, so the two surrounding the desired one are found directly
+x = ( flog_10T - pTemp[0] ) * ( NumEquilTemp - 1 ) / ( pTemp[NumTemp-1] - pTemp[0] );
+j = (int)x;
+if( j > NumEquilTemp-2 ) j = NumEquilTemp-2;
+x -= j;
 
-// Deal with the special cases where there aren't two values either side of the
-// desired one
-if( j < 2 ) j = 2;
-else if( j == NumTemp-1 ) j = NumTemp-2;
+// If the rates depend on density then the fractional populations at the lowest tabulated
+// density are used (as the ionisation balance file read by the temperature only overload)
+IonFrac = ( 1.0 - x ) * ppIonFrac[i][j] + x * ppIonFrac[i][j+1];
 
-x1[1] = pTemp[j-2];
-x1[2] = pTemp[j-1];
-x1[3] = pTemp[j];
-x1[4] = pTemp[j+1];
+// Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+if( IonFrac < cutoff_ion_fraction )
+    IonFrac = 0.0;
 
-// Select the four density values surrounding the desired one
+return IonFrac;
+}
 
-// If the density is out of range then set it to the appropriate limit
-if( flog_10n < pDen[0] )
-    flog_10n = pDen[0];
-else if ( flog_10n > pDen[NumDen-1] )
-    flog_10n = pDen[NumDen-1];
+double CElement::GetRatesEquilIonFrac( int iIon, double flog_10T, double flog_10n )
+{
+double x1, x2[4], w2[4], *pfTemp, IonFrac;
+int i, j, k, l;
 
-for( k=0; k<NumDen; k++ )
-    if( pDen[k] >= flog_10n ) break;
+if(!density_dependent_rates)
+    return GetRatesEquilIonFrac( iIon, flog_10T );
 
-// Deal with the special cases where there aren't two values either side of the
-// desired one
-if( k < 2 ) k = 2;
-else if( k == NumDen-1 ) k = NumDen-2;
+// Select the required ion
+i = iIon - 1;
 
-x2[1] = pDen[k-2];
-x2[2] = pDen[k-1];
-x2[3] = pDen[k];
-x2[4] = pDen[k+1];
+// If the temperature is out of range then set it to the appropriate limit
+if( flog_10T < pTemp[0] )
+    flog_10T = pTemp[0];
+else if( flog_10T > pTemp[NumTemp-1] )
+    flog_10T = pTemp[NumTemp-1];
 
-// We are using the i'th ion
-// We are using the j-2, j-1, j and j+1 'th temperature values
-// We are using the k-2, k-1, k and k+1 'th density values
+// The temperature values are uniformly spaced, so the two surrounding the desired one are found directly
+x1 = ( flog_10T - pTemp[0] ) * ( NumEquilTemp - 1 ) / ( pTemp[NumTemp-1] - pTemp[0] );
+j = (int)x1;
+if( j > NumEquilTemp-2 ) j = NumEquilTemp-2;
+x1 -= j;
 
-// Select the sixteen phi( n, T ) values corresponding to the grid
+// Select the four density values surrounding the desired one
+k = LocateStencil( pDen, NumDen, &flog_10n );
 
-// Allocate an array of pointers to pointers for the values
-y = (double**)alloca( sizeof(double) * 5 );
+for( l=0; l<4; l++ )
+    x2[l] = pDen[k+l-2];
 
-// Allocate an array to hold the values corresponding to the specified range of
-// densities and temperatures
-for( l=1; l<=4; l++ )
-    y[l] = (double*)alloca( sizeof(double) * 5 );
+GetLagrangeWeights( x2, 4, flog_10n, w2, NULL );
 
-for( l=1; l<=4; l++ )
+// Interpolate linearly in temperature and with a cubic polynomial in density
+IonFrac = 0.0;
+for( l=0; l<4; l++ )
 {
-    // Point to the start of the phi( n, T ) values for the required ion
-    pfTemp = ppPhi[i];
-
-    // Skip to the set corresponding to the l'th density value and get the
-    // values of phi( n, T ) corresponding to the four temperature values
-    pfTemp += ( k + l - 3 ) * NumTemp;
+    pfTemp = ppIonFrac[i] + ( k + l - 2 ) * NumEquilTemp;
+    IonFrac += w2[l] * ( ( 1.0 - x1 ) * pfTemp[j] + x1 * pfTemp[j+1] );
+}
 
-    y[1][l] = *( pfTemp + ( j - 2 ) );
+// Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+if( IonFrac < cutoff_ion_fraction )
+    IonFrac = 0.0;
+
+return IonFrac;
+}
+
+int CElement::LocateEquilTemp( double flog_10T, double *pw )
+{
+double x1;
+int j;
+
+// If the temperature is out of range then set it to the appropriate limit
+if( flog_10T < pTemp[0] )
+    flog_10T = pTemp[0];
+else if( flog_10T > pTemp[NumTemp-1] )
+    flog_10T = pTemp[NumTemp-1];
+
+// Linear interpolation between the two uniformly spaced values surrounding the desired one
+x1 = ( flog_10T - pTemp[0] ) * ( NumEquilTemp - 1 ) / ( pTemp[NumTemp-1] - pTemp[0] );
+j = (int)x1;
+if( j > NumEquilTemp-2 ) j = NumEquilTemp-2;
+x1 -= j;
+
+pw[0] = 1.0 - x1;
+pw[1] = x1;
+
+return j;
+}
+
+void CElement::InterpolateEquilIonFrac( int j, int iNumT, double *wT, int iRowLength, int k, int iNumn, double *wn, double *pni, int iIonStride )
+{
+double *pfTemp, IonFrac, fTotal = 0.0;
+int i, l, m;
+
+for( i=0; i<=Z; i++ )
+{
+    IonFrac = 0.0;
+
+    for( l=0; l<iNumn; l++ )
+    {
+        // Point to the set corresponding to the l'th density value
+        pfTemp = ppIonFrac[i] + ( k + l ) * iRowLength + j;
+
+        for( m=0; m<iNumT; m++ )
+            IonFrac += wn[l] * wT[m] * pfTemp[m];
+    }
+
+    // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+    if( IonFrac < cutoff_ion_fraction )
+        IonFrac = 0.0;
+
+    pni[i*iIonStride] = IonFrac;
+    fTotal += IonFrac;
+}
+
+// Normalise the sum total of the ion fractional populations to 1
+for( i=0; i<=Z; i++ )
+    pni[i*iIonStride] /= fTotal;
+}
+
+void CElement::InterpolateEquilIonFrac( int j, double flog_10T, int k, double *pflog_10n, double *pni, int iIonStride )
+{
+double IonFrac, fTotal = 0.0;
+int i;
+
+for( i=0; i<=Z; i++ )
+{
+    if( pflog_10n )
+        IonFrac = InterpolateStencil2D( pBalancesKernel, ppIonFrac[i], NumTemp, pTemp, j, flog_10T, pDen, k, *pflog_10n, NULL, NULL );
+    else
+        IonFrac = pBalancesKernel( pTemp + j - 2, ppIonFrac[i] + j - 2, flog_10T, NULL );
+
+    // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+    if( IonFrac < cutoff_ion_fraction )
+        IonFrac = 0.0;
+
+    pni[i*iIonStride] = IonFrac;
+    fTotal += IonFrac;
+}
+
+// Normalise the sum total of the ion fractional populations to 1
+for( i=0; i<=Z; i++ )
+    pni[i*iIonStride] /= fTotal;
+}
+
+void CElement::GetStridedEquilIonFrac( double flog_10T, double *pflog_10n, double *pni, int iIonStride, int *piTempHint, int *piDenHint )
+{
+double x[4], wT[4], wn[4];
+int j, k, l, iNumT, iNumn, iRowLength;
+
+if( !uniform_equilibrium && balances_interpolation != INTERP_CUBIC )
+{
+    // Interpolate the tabulated ionisation balance with the requested order
+    j = LocateStencil( pTemp, NumTemp, &flog_10T, piTempHint );
+
+    if( pflog_10n && density_dependent_rates )
+    {
+        k = LocateStencil( pDen, NumDen, pflog_10n, piDenHint );
+        InterpolateEquilIonFrac( j, flog_10T, k, pflog_10n, pni, iIonStride );
+    }
+    else
+        InterpolateEquilIonFrac( j, flog_10T, 0, NULL, pni, iIonStride );
+
+    return;
+}
+
+// Select the temperature values surrounding the desired one and calculate their weights
+if(uniform_equilibrium)
+{
+    j = LocateEquilTemp( flog_10T, wT );
+    iNumT = 2;
+    iRowLength = NumEquilTemp;
+}
+else
+{
+    // Polynomial interpolation between the four values surrounding the desired one
+    j = LocateStencil( pTemp, NumTemp, &flog_10T, piTempHint );
+    j -= 2;
+
+    for( l=0; l<4; l++ )
+        x[l] = pTemp[j+l];
+
+    iNumT = 4;
+    GetLagrangeWeights( x, 4, flog_10T, wT, NULL );
+    iRowLength = NumTemp;
+}
+
+// Select the four density values surrounding the desired one and calculate their weights
+if( pflog_10n && density_dependent_rates )
+{
+    k = LocateStencil( pDen, NumDen, pflog_10n, piDenHint );
+    k -= 2;
+
+    for( l=0; l<4; l++ )
+        x[l] = pDen[k+l];
+
+    iNumn = 4;
+    GetLagrangeWeights( x, 4, *pflog_10n, wn, NULL );
+}
+else
+{
+    // Use the first (or only) set of values
+    k = 0;
+    iNumn = 1;
+    wn[0] = 1.0;
+}
+
+InterpolateEquilIonFrac( j, iNumT, wT, iRowLength, k, iNumn, wn, pni, iIonStride );
+}
+
+void CElement::GetAllEquilIonFrac( double flog_10T, double *pni )
+{
+GetStridedEquilIonFrac( flog_10T, NULL, pni, 1, NULL, NULL );
+}
+
+void CElement::GetAllEquilIonFrac( double flog_10T, double flog_10n, double *pni )
+{
+GetStridedEquilIonFrac( flog_10T, &flog_10n, pni, 1, NULL, NULL );
+}
+
+void CElement::GetAllEquilIonFrac( CELLCONTEXT *pContext, double *pni )
+{
+double wT[2], wn = 1.0;
+int j;
+
+// The temperature (and density) stencils of the tables are taken from the context
+if(uniform_equilibrium)
+{
+    j = LocateEquilTemp( pContext->flog_10T_clamped, wT );
+
+    if(density_dependent_rates)
+        InterpolateEquilIonFrac( j, 2, wT, NumEquilTemp, pContext->k - 2, 4, pContext->wn, pni, 1 );
+    else
+        InterpolateEquilIonFrac( j, 2, wT, NumEquilTemp, 0, 1, &wn, pni, 1 );
+}
+else if( balances_interpolation != INTERP_CUBIC )
+{
+    if(density_dependent_rates)
+        InterpolateEquilIonFrac( pContext->j, pContext->flog_10T_clamped, pContext->k, &(pContext->flog_10n_clamped), pni, 1 );
+    else
+        InterpolateEquilIonFrac( pContext->j, pContext->flog_10T_clamped, 0, NULL, pni, 1 );
+}
+else
+{
+    if(density_dependent_rates)
+        InterpolateEquilIonFrac( pContext->j - 2, 4, pContext->wT, NumTemp, pContext->k - 2, 4, pContext->wn, pni, 1 );
+    else
+        InterpolateEquilIonFrac( pContext->j - 2, 4, pContext->wT, NumTemp, 0, 1, &wn, pni, 1 );
+}
+}
+
+void CElement::GetGridEquilIonFrac( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride )
+{
+#ifdef OPENMP
+#pragma omp parallel
+#endif // OPENMP
+{
+// The stencils of each cell are hunted for from those of the previous cell handled by the same thread
+int c, iTempHint = -1, iDenHint = -1;
+
+#ifdef OPENMP
+#pragma omp for
+#endif // OPENMP
+for( c=0; c<iNumCells; c++ )
+{
+    if( pflog_10n )
+    {
+        // The density is passed by pointer because it may be clamped
+        double flog_10n = pflog_10n[c];
+        GetStridedEquilIonFrac( pflog_10T[c], &flog_10n, pni + (size_t)c * iCellStride, iIonStride, &iTempHint, &iDenHint );
+    }
+    else
+        GetStridedEquilIonFrac( pflog_10T[c], NULL, pni + (size_t)c * iCellStride, iIonStride, &iTempHint, &iDenHint );
+}
+}
+}
+
+double CElement::GetEmissivity( int iIon, double flog_10T, double flog_10n )
+{
+double x1[5], x2[5], **y, *pfTemp, result, error;
+int i, j, k, l;
+
+// Select the required ion
+
+for( i=0; i<NumIons; i++ )
+    if( iIon == pSpecNum[i] ) break;
+
+// If the requested ion is not in the list of spectroscopic numbers then return 0.0
+if( i == NumIons ) return 0.0;
+
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 phi( n, T ) between the two temperature and two density values surrounding the desired ones
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, x1 );
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n, x2 );
+
+    return GetLog10TableValue( ppPhi[i], NumTemp, j, x1[0], k, x2[0] );
+}
+
+// Select the four temperature values surrounding the desired one
+
+// If the temperature is out of range then set it to the appropriate limit
+if( flog_10T < pTemp[0] )
+    flog_10T = pTemp[0];
+else if( flog_10T > pTemp[NumTemp-1] )
+    flog_10T = pTemp[NumTemp-1];
+
+for( j=0; j<NumTemp; j++ )
+    if( pTemp[j] >= flog_10T ) break;
+
+// Deal with the special cases where there aren't two values either side of the
+// desired one
+if( j < 2 ) j = 2;
+else if( j == NumTemp-1 ) j = NumTemp-2;
+
+x1[1] = pTemp[j-2];
+x1[2] = pTemp[j-1];
+x1[3] = pTemp[j];
+x1[4] = pTemp[j+1];
+
+// Select the four density values surrounding the desired one
+
+// If the density is out of range then set it to the appropriate limit
+if( flog_10n < pDen[0] )
+    flog_10n = pDen[0];
+else if ( flog_10n > pDen[NumDen-1] )
+    flog_10n = pDen[NumDen-1];
+
+for( k=0; k<NumDen; k++ )
+    if( pDen[k] >= flog_10n ) break;
+
+// Deal with the special cases where there aren't two values either side of the
+// desired one
+if( k < 2 ) k = 2;
+else if( k == NumDen-1 ) k = NumDen-2;
+
+x2[1] = pDen[k-2];
+x2[2] = pDen[k-1];
+x2[3] = pDen[k];
+x2[4] = pDen[k+1];
+
+if( emissivities_interpolation != INTERP_CUBIC )
+    return InterpolateStencil2D( pEmissivitiesKernel, ppPhi[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
+// We are using the i'th ion
+// We are using the j-2, j-1, j and j+1 'th temperature values
+// We are using the k-2, k-1, k and k+1 'th density values
+
+// Select the sixteen phi( n, T ) values corresponding to the grid
+
+// Allocate an array of pointers to pointers for the values
+y = (double**)alloca( sizeof(double) * 5 );
+
+// Allocate an array to hold the values corresponding to the specified range of
+// densities and temperatures
+for( l=1; l<=4; l++ )
+    y[l] = (double*)alloca( sizeof(double) * 5 );
+
+for( l=1; l<=4; l++ )
+{
+    // Point to the start of the phi( n, T ) values for the required ion
+    pfTemp = ppPhi[i];
+
+    // Skip to the set corresponding to the l'th density value and get the
+    // values of phi( n, T ) corresponding to the four temperature values
+    pfTemp += ( k + l - 3 ) * NumTemp;
+
+    y[1][l] = *( pfTemp + ( j - 2 ) );
     y[2][l] = *( pfTemp + ( j - 1 ) );
     y[3][l] = *( pfTemp + j );
     y[4][l] = *( pfTemp + ( j + 1 ) );
@@ -944,6 +1688,15 @@ double CElement::GetEmissivity( double flog_10T, double flog_10n )
 double x1[5], x2[5], **y, *pfTemp, result, error;
 int j, k, l;
 
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 total phi( n, T ) between the two temperature and two density values surrounding the desired ones
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, x1 );
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n, x2 );
+
+    return GetLog10TableValue( pTotalPhi, NumTemp, j, x1[0], k, x2[0] );
+}
+
 // Select the four temperature values surrounding the desired one
 
 // If the temperature is out of range then set it to the appropriate limit
@@ -986,6 +1739,9 @@ x2[2] = pDen[k-1];
 x2[3] = pDen[k];
 x2[4] = pDen[k+1];
 
+if( total_phi_interpolation != INTERP_CUBIC )
+    return InterpolateStencil2D( pTotalPhiKernel, pTotalPhi, NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
 // We are using the j-2, j-1, j and j+1 'th temperature values
 // We are using the k-2, k-1, k and k+1 'th density values
 
@@ -1024,9 +1780,25 @@ if( result < 0.0 ) result = 0.0;
 return result;
 }
 
+double CElement::GetIondnibydt( double ne, double niBelow, double ni, double niAbove, double IonRateBelow, double RecRateBelow, double IonRate, double RecRate, double fEpsilon_d, double fEpsilon_r, double *pdnibydt )
+{
+double term5, delta_t1, delta_t2;
+
+term5 = ne * ( ( niBelow * IonRateBelow ) + ( niAbove * RecRate ) - ( ni * ( IonRate + RecRateBelow ) ) );
+
+*pdnibydt = term5;
+
+delta_t1 = safety_atomic * ( fEpsilon_d / fabs( term5 ) );
+delta_t2 = safety_atomic * ni * ( fEpsilon_r / fabs( term5 ) );
+delta_t1 = min( delta_t1, delta_t2 );
+
+// The time-scale is calculated before the test so that the function has no branches where it is inlined into a loop over the ions
+return ( ( term5 == 0.0 ) | ( ni <= cutoff_ion_fraction ) ) ? LARGEST_DOUBLE : delta_t1;
+}
+
 void CElement::Getdnibydt( double flog_10T, double flog_10n, double *pni0, double *pni1, double *pni2, double *pni3, double *pni4, double *s, double *s_pos, double *pv, double delta_s, double *pdnibydt, double *pTimeScale )
 {
-double ne, IonRate[2], RecRate[2], term1, term2, term3, term4, term5, delta_t1, delta_t2, TimeScale, SmallestTimeScale;
+double ne, IonRate[2], RecRate[2], term1, term5, TimeScale, SmallestTimeScale;
 int iIndex, iSpecNum;
 
 // Variables used for interpolation
@@ -1039,7 +1811,7 @@ double Q1, Q2, Q3, QT, ni0, ni2;
 TimeScale = SmallestTimeScale = LARGEST_DOUBLE;
 
 // Calculate the electron number density
-ne = pow( 10.0, flog_10n );
+ne = Exp10( flog_10n );
 
 for( iIndex=0; iIndex<=Z; iIndex++ )
 {
@@ -1205,10 +1977,7 @@ for( iIndex=0; iIndex<=Z; iIndex++ )
 		{
 	        GetRates( iSpecNum-1, flog_10T, &IonRate[0], &RecRate[0] );
 		}
-		term2 = pni2[iIndex-1] * IonRate[0];
     }
-    else
-        term2 = 0.0;
 	
     if( iSpecNum < Z+1 )
     {
@@ -1220,42 +1989,25 @@ for( iIndex=0; iIndex<=Z; iIndex++ )
 		{
 	        GetRates( iSpecNum, flog_10T, &IonRate[1], &RecRate[1] );
 		}
-		term3 = pni2[iIndex+1] * RecRate[1];
     }
-    else
-        term3 = 0.0;
-	
-    term4 = - pni2[iIndex] * ( IonRate[1] + RecRate[0] );
 
-    term5 = ne * ( term2 + term3 + term4 );
+    TimeScale = GetIondnibydt( ne, iSpecNum > 1 ? pni2[iIndex-1] : 0.0, pni2[iIndex], iSpecNum < Z+1 ? pni2[iIndex+1] : 0.0, IonRate[0], RecRate[0], IonRate[1], RecRate[1], epsilon_d, epsilon_r, &term5 );
 
     pdnibydt[iIndex] = term1 + term5;
 	
-    if( term5 && pni2[iIndex] > cutoff_ion_fraction )
+    if( TimeScale < minimum_collisional_coupling_time_scale )
     {
-        term5 = fabs( term5 );
-
-        delta_t1 = safety_atomic * ( epsilon_d / term5 );
-        delta_t2 = safety_atomic * pni2[iIndex] * ( epsilon_r / term5 );
-
-        TimeScale = min( delta_t1, delta_t2 );
-
-        if( TimeScale < minimum_collisional_coupling_time_scale )
-        {
-			if(density_dependent_rates)
-			{
-	            pni2[iIndex] = GetEquilIonFrac( iIndex+1, flog_10T, flog_10n );
-			}
-			else
-			{
-	            pni2[iIndex] = GetEquilIonFrac( iIndex+1, flog_10T );
-			}
-            pdnibydt[iIndex] = 0.0;
-            TimeScale = LARGEST_DOUBLE;
-        }
-    }
-    else
+		if(density_dependent_rates)
+		{
+	        pni2[iIndex] = GetEquilIonFrac( iIndex+1, flog_10T, flog_10n );
+		}
+		else
+		{
+	        pni2[iIndex] = GetEquilIonFrac( iIndex+1, flog_10T );
+		}
+        pdnibydt[iIndex] = 0.0;
         TimeScale = LARGEST_DOUBLE;
+    }
 
     if( TimeScale < SmallestTimeScale )
         SmallestTimeScale = TimeScale;
@@ -1266,11 +2018,11 @@ for( iIndex=0; iIndex<=Z; iIndex++ )
 
 void CElement::Getdnibydt( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale )
 {
-double ne, IonRate[2], RecRate[2], term2, term3, term4, term5, delta_t1, delta_t2, TimeScale, SmallestTimeScale;
+double ne, IonRate[2], RecRate[2], TimeScale, SmallestTimeScale;
 int iIndex, iSpecNum;
 
 // Calculate the electron number density
-ne = pow( 10.0, flog_10n );
+ne = Exp10( flog_10n );
 
 // Initialise the characteristic time-scales
 TimeScale = SmallestTimeScale = LARGEST_DOUBLE;
@@ -1294,45 +2046,12 @@ else
 	    iSpecNum = iIndex + 1;
 
 		if( iSpecNum > 1 )
-		{
 	        GetRates( iSpecNum-1, flog_10T, &IonRate[0], &RecRate[0] );
-	        term2 = pni[iIndex-1] * IonRate[0];
-	    }
-		else
-	        term2 = 0.0;
 		
 		if( iSpecNum < Z+1 )
-		{
 	        GetRates( iSpecNum, flog_10T, &IonRate[1], &RecRate[1] );
-			term3 = pni[iIndex+1] * RecRate[1];
-		}
-		else
-	        term3 = 0.0;
-		
-		term4 = - pni[iIndex] * ( IonRate[1] + RecRate[0] );
-
-		term5 = ne * ( term2 + term3 + term4 );
-
-		pdnibydt[iIndex] = term5;
-		
-		if( term5 && pni[iIndex] > cutoff_ion_fraction )
-		{
-			term5 = fabs( term5 );
-
-			// epsilon_d = 0.1;
-			delta_t1 = safety_atomic * ( 0.1 / term5 );
-
-			// epsilon_r = 0.6
-			// |(10^-epsilon_r - 1.0)| = 0.748811357
-			// 10^epsilon_r - 1.0 = 2.981071706
-			// 0.748811357 + 2.981071706 = 3.729883062
-			// 0.5 * 3.729883062 = 1.864941531
-			delta_t2 = safety_atomic * 1.864941531 * ( pni[iIndex] / term5 );
 
-			TimeScale = min( delta_t1, delta_t2 );
-		}
-		else
-			TimeScale = LARGEST_DOUBLE;
+		TimeScale = GetIondnibydt( ne, iSpecNum > 1 ? pni[iIndex-1] : 0.0, pni[iIndex], iSpecNum < Z+1 ? pni[iIndex+1] : 0.0, IonRate[0], RecRate[0], IonRate[1], RecRate[1], LOCAL_EPSILON_D, LOCAL_EPSILON_R, &pdnibydt[iIndex] );
 
 		if( TimeScale < SmallestTimeScale )
 			SmallestTimeScale = TimeScale;
@@ -1342,21 +2061,917 @@ else
 *pTimeScale = SmallestTimeScale;
 }
 
-double CElement::GetEmissivity( int iIon, double flog_10T, double flog_10n, double ni )
+void CElement::GetdnibydtFromRates( double flog_10T, double ne, bool bEquilibrium, double *pIonRate, double *pRecRate, double *pni, double *pdnibydt, double *pTimeScale )
 {
-return GetIonEmissivity( iIon, flog_10T, flog_10n ) * ni;
-}
+double IonRate, RecRate, IonRateBelow, RecRateBelow, TimeScale, SmallestTimeScale;
+int iIndex;
 
-double CElement::GetEmissivity( double flog_10T, double flog_10n, double *pni )
-{
-double Emiss = 0.0;
-int i, iIndex;
+// Initialise the characteristic time-scales
+TimeScale = SmallestTimeScale = LARGEST_DOUBLE;
 
-for( i=0; i<NumIons; i++ )
+if( bEquilibrium )
 {
-    iIndex = pSpecNum[i] - 1;
-    Emiss += GetIonEmissivity( pSpecNum[i], flog_10T, flog_10n ) * pni[iIndex];
+    for( iIndex=0; iIndex<=Z; iIndex++ )
+    {
+        pni[iIndex] = GetEquilIonFrac( iIndex+1, flog_10T );
+        pdnibydt[iIndex] = 0.0;
+    }
+
+    *pTimeScale = SmallestTimeScale;
+    return;
 }
 
+// There is no ionisation to or recombination from below the first ion
+IonRate = RecRate = 0.0;
+
+for( iIndex=0; iIndex<=Z; iIndex++ )
+{
+    IonRateBelow = IonRate;
+    RecRateBelow = RecRate;
+
+    // The rates between this ion and the ion above
+    if( iIndex < Z )
+    {
+        IonRate = pIonRate[iIndex];
+        RecRate = pRecRate[iIndex];
+    }
+    else
+        IonRate = RecRate = 0.0;
+
+    TimeScale = GetIondnibydt( ne, iIndex > 0 ? pni[iIndex-1] : 0.0, pni[iIndex], iIndex < Z ? pni[iIndex+1] : 0.0, IonRateBelow, RecRateBelow, IonRate, RecRate, LOCAL_EPSILON_D, LOCAL_EPSILON_R, &pdnibydt[iIndex] );
+
+    if( TimeScale < SmallestTimeScale )
+        SmallestTimeScale = TimeScale;
+}
+
+*pTimeScale = SmallestTimeScale;
+}
+
+void CElement::GetFaceIonFrac( int iFace, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pFaceni )
+{
+double *pnia, *pnib, *pniu, w1, w2, Q1, Q2, Q3;
+int iIndex, iOffset;
+
+// Point to the cells either side of the face
+pnia = pni + (size_t)( iFace - 1 ) * iCellStride;
+pnib = pni + (size_t)iFace * iCellStride;
+
+// Calculate the geometric interpolation weight between the cells either side of the face
+w2 = ( s_face[iFace] - s[iFace-1] ) / ( s[iFace] - s[iFace-1] );
+
+if( pv_face[iFace] > 0.0 )
+{
+    // Calculate the weight between the upwind cell and the next cell upwind
+    pniu = pni + (size_t)( iFace - 2 ) * iCellStride;
+    w1 = ( s_face[iFace] - s[iFace-2] ) / ( s[iFace-1] - s[iFace-2] );
+
+    for( iIndex=0; iIndex<=Z; iIndex++ )
+    {
+        iOffset = iIndex * iIonStride;
+
+        Q1 = pniu[iOffset] + ( pnia[iOffset] - pniu[iOffset] ) * w1;
+        Q2 = pnia[iOffset] + ( pnib[iOffset] - pnia[iOffset] ) * w2;
+        Q3 = pnia[iOffset];
+
+        if( pnib[iOffset] <= pnia[iOffset] )
+            pFaceni[iIndex] = min( Q3, max( Q1, Q2 ) );
+        else
+            pFaceni[iIndex] = max( Q3, min( Q1, Q2 ) );
+    }
+}
+else
+{
+    // Calculate the weight between the upwind cell and the next cell upwind
+    pniu = pni + (size_t)( iFace + 1 ) * iCellStride;
+    w1 = ( s_face[iFace] - s[iFace] ) / ( s[iFace+1] - s[iFace] );
+
+    for( iIndex=0; iIndex<=Z; iIndex++ )
+    {
+        iOffset = iIndex * iIonStride;
+
+        Q1 = pnib[iOffset] + ( pniu[iOffset] - pnib[iOffset] ) * w1;
+        Q2 = pnia[iOffset] + ( pnib[iOffset] - pnia[iOffset] ) * w2;
+        Q3 = pnib[iOffset];
+
+        if( pnib[iOffset] <= pnia[iOffset] )
+            pFaceni[iIndex] = max( Q3, min( Q1, Q2 ) );
+        else
+            pFaceni[iIndex] = min( Q3, max( Q1, Q2 ) );
+    }
+}
+}
+
+void CElement::GetGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale )
+{
+GetGriddnibydt( iNumCells, pflog_10T, pflog_10n, pni, iCellStride, iIonStride, s, s_face, pv_face, pdelta_s, pdnibydt, pTimeScale, false );
+}
+
+void CElement::GetGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale, bool bSmallest )
+{
+double *pLeftni, *pRightni, *pSwap, *pIonRate, *pRecRate, *pterm1, *pIonTimeScale, *pni2, *pdni;
+double ne, term5, TimeScale, SmallestTimeScale;
+int iCell, iIndex, iOffset, iTempHint = -1, iDenHint = -1;
+
+pLeftni = (double*)alloca( sizeof(double) * ( Z + 1 ) );
+pRightni = (double*)alloca( sizeof(double) * ( Z + 1 ) );
+pterm1 = (double*)alloca( sizeof(double) * ( Z + 1 ) );
+pIonTimeScale = (double*)alloca( sizeof(double) * ( Z + 1 ) );
+
+// The rates are held from index 1 between two zeros, so that the rates below and above every ion are in range
+pIonRate = (double*)alloca( sizeof(double) * ( Z + 2 ) );
+pRecRate = (double*)alloca( sizeof(double) * ( Z + 2 ) );
+pIonRate[0] = pRecRate[0] = pIonRate[Z+1] = pRecRate[Z+1] = 0.0;
+
+// Calculate the ion fractions at the left-hand face of the first cell with two cells either side
+if( iNumCells >= 5 )
+    GetFaceIonFrac( 2, pni, iCellStride, iIonStride, s, s_face, pv_face, pLeftni );
+
+for( iCell=0; iCell<iNumCells; iCell++ )
+{
+    if( iCell >= 2 && iCell <= iNumCells-3 )
+    {
+        // Calculate the ion fractions at the right-hand face of the cell; the left-hand face
+        // is shared with the previous cell
+        GetFaceIonFrac( iCell+1, pni, iCellStride, iIonStride, s, s_face, pv_face, pRightni );
+
+        for( iIndex=0; iIndex<=Z; iIndex++ )
+            pterm1[iIndex] = - ( ( pRightni[iIndex] * pv_face[iCell+1] ) - ( pLeftni[iIndex] * pv_face[iCell] ) ) / pdelta_s[iCell];
+
+        // The right-hand face of this cell is the left-hand face of the next
+        pSwap = pLeftni;
+        pLeftni = pRightni;
+        pRightni = pSwap;
+    }
+    else
+    {
+        // The face ion fractions need two cells either side, so the cells at the ends of the grid
+        // change by ionisation and recombination alone
+        for( iIndex=0; iIndex<=Z; iIndex++ )
+            pterm1[iIndex] = 0.0;
+    }
+
+    // Calculate the electron number density and the rates for every ion from a single stencil
+    ne = Exp10( pflog_10n[iCell] );
+
+    // The stencils are hunted for from those of the previous cell
+    if( density_dependent_rates )
+        GetAllRates( pflog_10T[iCell], pflog_10n[iCell], pIonRate + 1, pRecRate + 1, &iTempHint, &iDenHint );
+    else
+        GetAllRates( pflog_10T[iCell], pIonRate + 1, pRecRate + 1, NULL, NULL, &iTempHint );
+
+    pni2 = pni + (size_t)iCell * iCellStride;
+    pdni = pdnibydt + (size_t)iCell * iCellStride;
+
+    // The rates of change of the ions are independent of each other until an ion is reset to equilibrium, so they
+    // are calculated first in a loop without branches that the compiler can vectorise. The ions at either end are
+    // calculated separately because they have no neighbour below or above
+    pIonTimeScale[0] = GetIondnibydt( ne, 0.0, pni2[0], pni2[iIonStride], pIonRate[0], pRecRate[0], pIonRate[1], pRecRate[1], epsilon_d, epsilon_r, &term5 );
+    pdni[0] = pterm1[0] + term5;
+
+    for( iIndex=1; iIndex<Z; iIndex++ )
+    {
+        iOffset = iIndex * iIonStride;
+
+        pIonTimeScale[iIndex] = GetIondnibydt( ne, pni2[iOffset-iIonStride], pni2[iOffset], pni2[iOffset+iIonStride], pIonRate[iIndex], pRecRate[iIndex], pIonRate[iIndex+1], pRecRate[iIndex+1], epsilon_d, epsilon_r, &term5 );
+        pdni[iOffset] = pterm1[iIndex] + term5;
+    }
+
+    iOffset = Z * iIonStride;
+    pIonTimeScale[Z] = GetIondnibydt( ne, pni2[iOffset-iIonStride], pni2[iOffset], 0.0, pIonRate[Z], pRecRate[Z], pIonRate[Z+1], pRecRate[Z+1], epsilon_d, epsilon_r, &term5 );
+    pdni[iOffset] = pterm1[Z] + term5;
+
+    // Start from the time-scale already held for the cell if only a smaller one is to replace it
+    SmallestTimeScale = bSmallest ? pTimeScale[iCell] : LARGEST_DOUBLE;
+
+    for( iIndex=0; iIndex<=Z; iIndex++ )
+    {
+        iOffset = iIndex * iIonStride;
+        TimeScale = pIonTimeScale[iIndex];
+
+        if( TimeScale < minimum_collisional_coupling_time_scale )
+        {
+            if( density_dependent_rates )
+                pni2[iOffset] = GetEquilIonFrac( iIndex+1, pflog_10T[iCell], pflog_10n[iCell] );
+            else
+                pni2[iOffset] = GetEquilIonFrac( iIndex+1, pflog_10T[iCell] );
+
+            pdni[iOffset] = 0.0;
+            TimeScale = LARGEST_DOUBLE;
+
+            // The rate of change of the ion above depends on the ion fraction just reset, so it is calculated again
+            if( iIndex < Z )
+            {
+                iOffset += iIonStride;
+
+                pIonTimeScale[iIndex+1] = GetIondnibydt( ne, pni2[iOffset-iIonStride], pni2[iOffset], iIndex+1 < Z ? pni2[iOffset+iIonStride] : 0.0, pIonRate[iIndex+1], pRecRate[iIndex+1], pIonRate[iIndex+2], pRecRate[iIndex+2], epsilon_d, epsilon_r, &term5 );
+                pdni[iOffset] = pterm1[iIndex+1] + term5;
+            }
+        }
+
+        if( TimeScale < SmallestTimeScale )
+            SmallestTimeScale = TimeScale;
+    }
+
+    pTimeScale[iCell] = SmallestTimeScale;
+}
+}
+
+double CElement::GetEmissivity( CELLCONTEXT *pContext )
+{
+double *pfTemp, wT, wn, result = 0.0;
+int j, k, l, m;
+
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 total phi( n, T ) within the stencils of the cell
+    j = GetLinearInterval( pTemp, NumTemp, pContext->j, pContext->flog_10T_clamped, &wT );
+    k = GetLinearInterval( pDen, NumDen, pContext->k, pContext->flog_10n_clamped, &wn );
+
+    return GetLog10TableValue( pTotalPhi, NumTemp, j, wT, k, wn );
+}
+
+if( total_phi_interpolation != INTERP_CUBIC )
+    return InterpolateStencil2D( pTotalPhiKernel, pTotalPhi, NumTemp, pTemp, pContext->j, pContext->flog_10T_clamped, pDen, pContext->k, pContext->flog_10n_clamped, NULL, NULL );
+
+for( l=0; l<4; l++ )
+{
+    // Point to the set corresponding to the l'th density value
+    pfTemp = pTotalPhi + ( pContext->k + l - 2 ) * NumTemp + pContext->j - 2;
+
+    for( m=0; m<4; m++ )
+        result += pContext->wT[m] * pContext->wn[l] * pfTemp[m];
+}
+
+// Check the value of phi( n, T ) is physically realistic
+if( result < 0.0 ) result = 0.0;
+
+return result;
+}
+
+double CElement::GetEmissivity( CELLCONTEXT *pContext, double *pni )
+{
+double *pfTemp, fIonEmiss, wT, wn, Emiss = 0.0;
+int i, j, k, l, m;
+
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 emissivity within the stencils of the cell
+    j = GetLinearInterval( pTemp, NumTemp, pContext->j, pContext->flog_10T_clamped, &wT );
+    k = GetLinearInterval( pDen, NumDen, pContext->k, pContext->flog_10n_clamped, &wn );
+
+    for( i=0; i<NumIons; i++ )
+        Emiss += GetLog10TableValue( ppEmiss[i], NumTemp, j, wT, k, wn ) * pni[pSpecNum[i]-1];
+
+    return Emiss;
+}
+
+if( emissivities_interpolation == INTERP_LINEAR )
+{
+    // Bilinear interpolation within the stencils of the cell
+    j = GetLinearInterval( pTemp, NumTemp, pContext->j, pContext->flog_10T_clamped, &wT );
+    k = GetLinearInterval( pDen, NumDen, pContext->k, pContext->flog_10n_clamped, &wn );
+
+    for( i=0; i<NumIons; i++ )
+        Emiss += GetLinearTableValue( ppEmiss[i], NumTemp, j, wT, k, wn ) * pni[pSpecNum[i]-1];
+
+    return Emiss;
+}
+
+if( emissivities_interpolation == INTERP_HERMITE )
+{
+    for( i=0; i<NumIons; i++ )
+        Emiss += InterpolateStencil2D( pEmissivitiesKernel, ppEmiss[i], NumTemp, pTemp, pContext->j, pContext->flog_10T_clamped, pDen, pContext->k, pContext->flog_10n_clamped, NULL, NULL ) * pni[pSpecNum[i]-1];
+
+    return Emiss;
+}
+
+for( i=0; i<NumIons; i++ )
+{
+    fIonEmiss = 0.0;
+
+    for( l=0; l<4; l++ )
+    {
+        // Point to the emissivity set corresponding to the l'th density value
+        pfTemp = ppEmiss[i] + ( pContext->k + l - 2 ) * NumTemp + pContext->j - 2;
+
+        for( m=0; m<4; m++ )
+            fIonEmiss += pContext->wT[m] * pContext->wn[l] * pfTemp[m];
+    }
+
+    // Check emissivity is physically realistic
+    if( fIonEmiss > 0.0 )
+        Emiss += fIonEmiss * pni[pSpecNum[i]-1];
+}
+
+return Emiss;
+}
+
+double CElement::GetEmissivity( int iIon, double flog_10T, double flog_10n, double ni )
+{
+return GetIonEmissivity( iIon, flog_10T, flog_10n ) * ni;
+}
+
+double CElement::GetEmissivity( double flog_10T, double flog_10n, double *pni )
+{
+double Emiss = 0.0;
+int i, iIndex;
+
+for( i=0; i<NumIons; i++ )
+{
+    iIndex = pSpecNum[i] - 1;
+    Emiss += GetIonEmissivity( pSpecNum[i], flog_10T, flog_10n ) * pni[iIndex];
+}
+
+return Emiss;
+}
+
+void CElement::GetAllRates( double flog_10T, double *pIonRate, double *pRecRate, double *pdIonRatebydlog_10T, double *pdRecRatebydlog_10T )
+{
+GetAllRates( flog_10T, pIonRate, pRecRate, pdIonRatebydlog_10T, pdRecRatebydlog_10T, NULL );
+}
+
+void CElement::GetAllRates( double flog_10T, double *pIonRate, double *pRecRate, double *pdIonRatebydlog_10T, double *pdRecRatebydlog_10T, int *piTempHint )
+{
+double x[4], w[4], dw[4], flog_10T_clamped;
+int i, j, l;
+
+if( bFineTables )
+{
+    // Linear interpolation between the two fine uniform values surrounding the desired one
+    j = LocateFineTemp( flog_10T, &(w[0]) );
+
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = ppFineIonRate[i][j] + w[0] * ( ppFineIonRate[i][j+1] - ppFineIonRate[i][j] );
+        pRecRate[i] = ppFineRecRate[i][j] + w[0] * ( ppFineRecRate[i][j+1] - ppFineRecRate[i][j] );
+
+        // The derivatives are the slopes of the linear segments and the rates are held constant
+        // outside of the tabulated temperature range
+        if( pdIonRatebydlog_10T )
+        {
+            if( flog_10T < pTemp[0] || flog_10T > pTemp[NumTemp-1] )
+                pdIonRatebydlog_10T[i] = pdRecRatebydlog_10T[i] = 0.0;
+            else
+            {
+                pdIonRatebydlog_10T[i] = ( ppFineIonRate[i][j+1] - ppFineIonRate[i][j] ) * fInvFineSpacing;
+                pdRecRatebydlog_10T[i] = ( ppFineRecRate[i][j+1] - ppFineRecRate[i][j] ) * fInvFineSpacing;
+            }
+        }
+    }
+
+    return;
+}
+
+// Select the four temperature values surrounding the desired one
+flog_10T_clamped = flog_10T;
+j = LocateStencil( pTemp, NumTemp, &flog_10T_clamped, piTempHint );
+
+if( bLogTables )
+{
+    // Linear interpolation of log_10 rates between the two temperature values surrounding the desired one
+    j = GetLinearInterval( pTemp, NumTemp, j, flog_10T_clamped, &(w[0]) );
+
+    // d( rate ) / d( log_10 T ) = ln( 10 ) * rate * d( log_10 rate ) / d( log_10 T ), with the rates held constant
+    // outside of the tabulated temperature range
+    if( flog_10T_clamped != flog_10T )
+        dw[0] = 0.0;
+    else
+        dw[0] = LN_10 / ( pTemp[j+1] - pTemp[j] );
+
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = GetLog10TableValue( ppIonRate[i], j, w[0] );
+        pRecRate[i] = GetLog10TableValue( ppRecRate[i], j, w[0] );
+
+        if( pdIonRatebydlog_10T )
+        {
+            pdIonRatebydlog_10T[i] = dw[0] * pIonRate[i] * ( ppIonRate[i][j+1] - ppIonRate[i][j] );
+            pdRecRatebydlog_10T[i] = dw[0] * pRecRate[i] * ( ppRecRate[i][j+1] - ppRecRate[i][j] );
+        }
+    }
+
+    return;
+}
+
+if( rates_interpolation == INTERP_LINEAR )
+{
+    // Linear interpolation between the two temperature values surrounding the desired one
+    j = GetLinearInterval( pTemp, NumTemp, j, flog_10T_clamped, &(w[0]) );
+
+    // The derivatives are the slopes of the linear segments and the rates are held constant
+    // outside of the tabulated temperature range
+    if( flog_10T_clamped != flog_10T )
+        dw[0] = 0.0;
+    else
+        dw[0] = 1.0 / ( pTemp[j+1] - pTemp[j] );
+
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = GetLinearTableValue( ppIonRate[i], j, w[0] );
+        pRecRate[i] = GetLinearTableValue( ppRecRate[i], j, w[0] );
+
+        if( pdIonRatebydlog_10T )
+        {
+            pdIonRatebydlog_10T[i] = dw[0] * ( ppIonRate[i][j+1] - ppIonRate[i][j] );
+            pdRecRatebydlog_10T[i] = dw[0] * ( ppRecRate[i][j+1] - ppRecRate[i][j] );
+        }
+    }
+
+    return;
+}
+
+if( rates_interpolation == INTERP_HERMITE )
+{
+    for( i=0; i<Z; i++ )
+    {
+        if( pdIonRatebydlog_10T )
+        {
+            pIonRate[i] = InterpolateHermite( pTemp + j - 2, ppIonRate[i] + j - 2, flog_10T_clamped, pdIonRatebydlog_10T + i );
+            pRecRate[i] = InterpolateHermite( pTemp + j - 2, ppRecRate[i] + j - 2, flog_10T_clamped, pdRecRatebydlog_10T + i );
+
+            // The rates are held constant outside of the tabulated temperature range
+            if( flog_10T_clamped != flog_10T )
+                pdIonRatebydlog_10T[i] = pdRecRatebydlog_10T[i] = 0.0;
+        }
+        else
+        {
+            pIonRate[i] = InterpolateHermite( pTemp + j - 2, ppIonRate[i] + j - 2, flog_10T_clamped, NULL );
+            pRecRate[i] = InterpolateHermite( pTemp + j - 2, ppRecRate[i] + j - 2, flog_10T_clamped, NULL );
+        }
+    }
+
+    return;
+}
+
+for( l=0; l<4; l++ )
+    x[l] = pTemp[j+l-2];
+
+// Calculate the interpolation weights once for all of the ions
+GetLagrangeWeights( x, 4, flog_10T_clamped, w, dw );
+
+// The rates are held constant outside of the tabulated temperature range
+if( flog_10T_clamped != flog_10T )
+    for( l=0; l<4; l++ )
+        dw[l] = 0.0;
+
+for( i=0; i<Z; i++ )
+{
+    pIonRate[i] = pRecRate[i] = 0.0;
+
+    for( l=0; l<4; l++ )
+    {
+        pIonRate[i] += w[l] * ppIonRate[i][j+l-2];
+        pRecRate[i] += w[l] * ppRecRate[i][j+l-2];
+    }
+
+    // The derivatives are optional
+    if( pdIonRatebydlog_10T )
+    {
+        pdIonRatebydlog_10T[i] = pdRecRatebydlog_10T[i] = 0.0;
+
+        for( l=0; l<4; l++ )
+        {
+            pdIonRatebydlog_10T[i] += dw[l] * ppIonRate[i][j+l-2];
+            pdRecRatebydlog_10T[i] += dw[l] * ppRecRate[i][j+l-2];
+        }
+
+        if( pIonRate[i] < 0.0 ) pdIonRatebydlog_10T[i] = 0.0;
+        if( pRecRate[i] < 0.0 ) pdRecRatebydlog_10T[i] = 0.0;
+    }
+
+    // Check rates are physically realistic
+    if( pIonRate[i] < 0.0 ) pIonRate[i] = 0.0;
+    if( pRecRate[i] < 0.0 ) pRecRate[i] = 0.0;
+}
+}
+
+void CElement::GetAllRates( double flog_10T, double flog_10n, double *pIonRate, double *pRecRate )
+{
+GetAllRates( flog_10T, flog_10n, pIonRate, pRecRate, NULL, NULL );
+}
+
+void CElement::GetAllRates( double flog_10T, double flog_10n, double *pIonRate, double *pRecRate, int *piTempHint, int *piDenHint )
+{
+double x1[4], x2[4], w1[4], w2[4], *pfIonTemp, *pfRecTemp;
+int i, j, k, l, m;
+
+// Select the four temperature and four density values surrounding the desired ones
+j = LocateStencil( pTemp, NumTemp, &flog_10T, piTempHint );
+k = LocateStencil( pDen, NumDen, &flog_10n, piDenHint );
+
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 rates between the two temperature and two density values surrounding the desired ones
+    j = GetLinearInterval( pTemp, NumTemp, j, flog_10T, &(w1[0]) );
+    k = GetLinearInterval( pDen, NumDen, k, flog_10n, &(w2[0]) );
+
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = GetLog10TableValue( ppIonRate[i], NumTemp, j, w1[0], k, w2[0] );
+        pRecRate[i] = GetLog10TableValue( ppRecRate[i], NumTemp, j, w1[0], k, w2[0] );
+    }
+
+    return;
+}
+
+if( rates_interpolation == INTERP_LINEAR )
+{
+    // Bilinear interpolation between the two temperature and two density values surrounding the desired ones
+    j = GetLinearInterval( pTemp, NumTemp, j, flog_10T, &(w1[0]) );
+    k = GetLinearInterval( pDen, NumDen, k, flog_10n, &(w2[0]) );
+
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = GetLinearTableValue( ppIonRate[i], NumTemp, j, w1[0], k, w2[0] );
+        pRecRate[i] = GetLinearTableValue( ppRecRate[i], NumTemp, j, w1[0], k, w2[0] );
+    }
+
+    return;
+}
+
+if( rates_interpolation == INTERP_HERMITE )
+{
+    for( i=0; i<Z; i++ )
+    {
+        pIonRate[i] = InterpolateStencil2D( pRatesKernel, ppIonRate[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+        pRecRate[i] = InterpolateStencil2D( pRatesKernel, ppRecRate[i], NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+    }
+
+    return;
+}
+
+for( l=0; l<4; l++ )
+{
+    x1[l] = pTemp[j+l-2];
+    x2[l] = pDen[k+l-2];
+}
+
+// Calculate the interpolation weights once for all of the ions
+GetLagrangeWeights( x1, 4, flog_10T, w1, NULL );
+GetLagrangeWeights( x2, 4, flog_10n, w2, NULL );
+
+for( i=0; i<Z; i++ )
+{
+    pIonRate[i] = pRecRate[i] = 0.0;
+
+    for( l=0; l<4; l++ )
+    {
+        // Point to the rate sets corresponding to the l'th density value
+        pfIonTemp = ppIonRate[i] + ( k + l - 2 ) * NumTemp;
+        pfRecTemp = ppRecRate[i] + ( k + l - 2 ) * NumTemp;
+
+        for( m=0; m<4; m++ )
+        {
+            pIonRate[i] += w1[m] * w2[l] * pfIonTemp[j+m-2];
+            pRecRate[i] += w1[m] * w2[l] * pfRecTemp[j+m-2];
+        }
+    }
+
+    // Check rates are physically realistic
+    if( pIonRate[i] < 0.0 ) pIonRate[i] = 0.0;
+    if( pRecRate[i] < 0.0 ) pRecRate[i] = 0.0;
+}
+}
+
+void CElement::GetdnibydtJacobian( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pJacLower, double *pJacDiag, double *pJacUpper, double *pdnibydtbydT, double *pdnibydtbydn )
+{
+double *pIonRate, *pRecRate, *pdIonRate, *pdRecRate;
+double ne, dlog_10TbydT, term2, term3, term4, dterm2, dterm3, dterm4;
+int iIndex;
+
+if( flog_10n >= max_optically_thin_density )
+{
+    // The ion populations are held in equilibrium by <Getdnibydt> so they do not evolve
+    for( iIndex=0; iIndex<=Z; iIndex++ )
+    {
+        pdnibydt[iIndex] = 0.0;
+        pJacLower[iIndex] = pJacDiag[iIndex] = pJacUpper[iIndex] = 0.0;
+        pdnibydtbydT[iIndex] = pdnibydtbydn[iIndex] = 0.0;
+    }
+    return;
+}
+
+// Calculate the electron number density
+ne = Exp10( flog_10n );
+
+// d( log_10 T ) / dT
+dlog_10TbydT = 1.0 / ( Exp10( flog_10T ) * log( 10.0 ) );
+
+// Get the rates and their derivatives for every ion from a single stencil
+pIonRate = (double*)alloca( sizeof(double) * Z );
+pRecRate = (double*)alloca( sizeof(double) * Z );
+pdIonRate = (double*)alloca( sizeof(double) * Z );
+pdRecRate = (double*)alloca( sizeof(double) * Z );
+
+GetAllRates( flog_10T, pIonRate, pRecRate, pdIonRate, pdRecRate );
+
+for( iIndex=0; iIndex<=Z; iIndex++ )
+{
+    // Ionisation from the ion below and recombination to the ion below
+    if( iIndex > 0 )
+    {
+        term2 = pni[iIndex-1] * pIonRate[iIndex-1];
+        dterm2 = pni[iIndex-1] * pdIonRate[iIndex-1];
+        term4 = - pni[iIndex] * pRecRate[iIndex-1];
+        dterm4 = - pni[iIndex] * pdRecRate[iIndex-1];
+        pJacLower[iIndex] = ne * pIonRate[iIndex-1];
+        pJacDiag[iIndex] = - ne * pRecRate[iIndex-1];
+    }
+    else
+    {
+        term2 = dterm2 = term4 = dterm4 = 0.0;
+        pJacLower[iIndex] = 0.0;
+        pJacDiag[iIndex] = 0.0;
+    }
+
+    // Recombination from the ion above and ionisation to the ion above
+    if( iIndex < Z )
+    {
+        term3 = pni[iIndex+1] * pRecRate[iIndex];
+        dterm3 = pni[iIndex+1] * pdRecRate[iIndex];
+        term4 -= pni[iIndex] * pIonRate[iIndex];
+        dterm4 -= pni[iIndex] * pdIonRate[iIndex];
+        pJacUpper[iIndex] = ne * pRecRate[iIndex];
+        pJacDiag[iIndex] -= ne * pIonRate[iIndex];
+    }
+    else
+    {
+        term3 = dterm3 = 0.0;
+        pJacUpper[iIndex] = 0.0;
+    }
+
+    pdnibydt[iIndex] = ne * ( term2 + term3 + term4 );
+
+    // The rates used by <Getdnibydt> depend on temperature only
+    pdnibydtbydT[iIndex] = ne * ( dterm2 + dterm3 + dterm4 ) * dlog_10TbydT;
+    pdnibydtbydn[iIndex] = term2 + term3 + term4;
+}
+}
+
+double CElement::GetEmissivityDerivatives( double flog_10T, double flog_10n, double *pni, double *pdEmissbydni, double *pdEmissbydlog_10T, double *pdEmissbydlog_10n )
+{
+double x1[4], x2[4], w1[4], w2[4], dw1[4], dw2[4], *pfTemp, flog_10T_clamped, flog_10n_clamped;
+double fIonEmiss, dIonEmissbydlog_10T, dIonEmissbydlog_10n, Emiss = 0.0;
+int i, iIndex, j, k, l, m;
+
+for( iIndex=0; iIndex<=Z; iIndex++ )
+    pdEmissbydni[iIndex] = 0.0;
+
+*pdEmissbydlog_10T = 0.0;
+*pdEmissbydlog_10n = 0.0;
+
+if( bLogTables )
+{
+    // Bilinear interpolation of log_10 emissivity between the two temperature and two density values surrounding the desired ones
+    flog_10T_clamped = flog_10T;
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T_clamped, &(w1[0]) );
+    flog_10n_clamped = flog_10n;
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n_clamped, &(w2[0]) );
+
+    // d( emissivity ) / d( log_10 T ) = ln( 10 ) * emissivity * d( log_10 emissivity ) / d( log_10 T ), and similarly for
+    // log_10 n, with the emissivities held constant outside of the tabulated ranges
+    dw1[0] = flog_10T_clamped != flog_10T ? 0.0 : LN_10 / ( pTemp[j+1] - pTemp[j] );
+    dw2[0] = flog_10n_clamped != flog_10n ? 0.0 : LN_10 / ( pDen[k+1] - pDen[k] );
+
+    for( i=0; i<NumIons; i++ )
+    {
+        fIonEmiss = GetLog10TableValue( ppEmiss[i], NumTemp, j, w1[0], k, w2[0] );
+
+        // Point to the log_10 emissivities at the lower corner of the interval
+        pfTemp = ppEmiss[i] + k * NumTemp + j;
+
+        dIonEmissbydlog_10T = dw1[0] * fIonEmiss * ( ( 1.0 - w2[0] ) * ( pfTemp[1] - pfTemp[0] ) + w2[0] * ( pfTemp[NumTemp+1] - pfTemp[NumTemp] ) );
+        dIonEmissbydlog_10n = dw2[0] * fIonEmiss * ( ( 1.0 - w1[0] ) * ( pfTemp[NumTemp] - pfTemp[0] ) + w1[0] * ( pfTemp[NumTemp+1] - pfTemp[1] ) );
+
+        iIndex = pSpecNum[i] - 1;
+
+        pdEmissbydni[iIndex] = fIonEmiss;
+        Emiss += fIonEmiss * pni[iIndex];
+        *pdEmissbydlog_10T += dIonEmissbydlog_10T * pni[iIndex];
+        *pdEmissbydlog_10n += dIonEmissbydlog_10n * pni[iIndex];
+    }
+
+    return Emiss;
+}
+
+// Select the four temperature and four density values surrounding the desired ones
+flog_10T_clamped = flog_10T;
+j = LocateStencil( pTemp, NumTemp, &flog_10T_clamped );
+flog_10n_clamped = flog_10n;
+k = LocateStencil( pDen, NumDen, &flog_10n_clamped );
+
+for( l=0; l<4; l++ )
+{
+    x1[l] = pTemp[j+l-2];
+    x2[l] = pDen[k+l-2];
+}
+
+if( emissivities_interpolation != INTERP_CUBIC )
+{
+    for( i=0; i<NumIons; i++ )
+    {
+        fIonEmiss = InterpolateStencil2D( pEmissivitiesKernel, ppEmiss[i], NumTemp, pTemp, j, flog_10T_clamped, pDen, k, flog_10n_clamped, &dIonEmissbydlog_10T, &dIonEmissbydlog_10n );
+
+        // The emissivities are held constant outside of the tabulated ranges
+        if( flog_10T_clamped != flog_10T ) dIonEmissbydlog_10T = 0.0;
+        if( flog_10n_clamped != flog_10n ) dIonEmissbydlog_10n = 0.0;
+
+        iIndex = pSpecNum[i] - 1;
+
+        pdEmissbydni[iIndex] = fIonEmiss;
+        Emiss += fIonEmiss * pni[iIndex];
+        *pdEmissbydlog_10T += dIonEmissbydlog_10T * pni[iIndex];
+        *pdEmissbydlog_10n += dIonEmissbydlog_10n * pni[iIndex];
+    }
+
+    return Emiss;
+}
+
+// Calculate the interpolation weights once for all of the ions
+GetLagrangeWeights( x1, 4, flog_10T_clamped, w1, dw1 );
+GetLagrangeWeights( x2, 4, flog_10n_clamped, w2, dw2 );
+
+// The emissivities are held constant outside of the tabulated ranges
+for( l=0; l<4; l++ )
+{
+    if( flog_10T_clamped != flog_10T ) dw1[l] = 0.0;
+    if( flog_10n_clamped != flog_10n ) dw2[l] = 0.0;
+}
+
+for( i=0; i<NumIons; i++ )
+{
+    fIonEmiss = dIonEmissbydlog_10T = dIonEmissbydlog_10n = 0.0;
+
+    for( l=0; l<4; l++ )
+    {
+        // Point to the emissivity set corresponding to the l'th density value
+        pfTemp = ppEmiss[i] + ( k + l - 2 ) * NumTemp;
+
+        for( m=0; m<4; m++ )
+        {
+            fIonEmiss += w1[m] * w2[l] * pfTemp[j+m-2];
+            dIonEmissbydlog_10T += dw1[m] * w2[l] * pfTemp[j+m-2];
+            dIonEmissbydlog_10n += w1[m] * dw2[l] * pfTemp[j+m-2];
+        }
+    }
+
+    // Check emissivity is physically realistic
+    if( fIonEmiss < 0.0 )
+        fIonEmiss = dIonEmissbydlog_10T = dIonEmissbydlog_10n = 0.0;
+
+    iIndex = pSpecNum[i] - 1;
+
+    pdEmissbydni[iIndex] = fIonEmiss;
+    Emiss += fIonEmiss * pni[iIndex];
+    *pdEmissbydlog_10T += dIonEmissbydlog_10T * pni[iIndex];
+    *pdEmissbydlog_10n += dIonEmissbydlog_10n * pni[iIndex];
+}
+
+return Emiss;
+}
+
+double CElement::GetdnibydtAndEmissivity( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale )
+{
+CELLCONTEXT Context;
+
+SetCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, flog_10T, flog_10n, &Context );
+
+return GetContextdnibydt( &Context, pni, pdnibydt, pTimeScale, true );
+}
+
+double CElement::GetdnibydtAndEmissivity( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale )
+{
+return GetContextdnibydt( pContext, pni, pdnibydt, pTimeScale, true );
+}
+
+void CElement::Getdnibydt( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale )
+{
+GetContextdnibydt( pContext, pni, pdnibydt, pTimeScale, false );
+}
+
+double CElement::GetContextdnibydt( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale, bool bEmissivity )
+{
+double *w1, *w2, *pfTemp;
+double ne, IonRate, RecRate, IonRateBelow, RecRateBelow, TimeScale, SmallestTimeScale;
+double fIonEmiss, Emiss = 0.0, xFine = 0.0, wLinT = 0.0, wLinn = 0.0;
+int i, iIndex, j, k, l, m, jFine = 0, jLin = 0, kLin = 0;
+
+// The electron number density, stencils and interpolation weights are taken from the context
+// The temperature stencil is shared by the rates and the emissivities
+ne = pContext->ne;
+j = pContext->j;
+k = pContext->k;
+w1 = pContext->wT;
+w2 = pContext->wn;
+
+// The rates are interpolated linearly from the fine uniform tables if they are used
+if( bFineTables )
+    jFine = LocateFineTemp( pContext->flog_10T_clamped, &xFine );
+
+// The log_10 tables and the tables interpolated linearly are interpolated between the two middle values of each stencil
+if( bLogTables || rates_interpolation == INTERP_LINEAR || emissivities_interpolation == INTERP_LINEAR )
+{
+    jLin = GetLinearInterval( pTemp, NumTemp, j, pContext->flog_10T_clamped, &wLinT );
+    kLin = GetLinearInterval( pDen, NumDen, k, pContext->flog_10n_clamped, &wLinn );
+}
+
+// Initialise the characteristic time-scales
+TimeScale = SmallestTimeScale = LARGEST_DOUBLE;
+
+// There is no ionisation to or recombination from below the first ion
+IonRate = RecRate = 0.0;
+
+for( iIndex=0; iIndex<=Z; iIndex++ )
+{
+    // Above the optically thin limit the ion populations are held in equilibrium (as <Getdnibydt>)
+    if( pContext->bEquilibrium )
+    {
+        pni[iIndex] = GetEquilIonFrac( iIndex+1, pContext->flog_10T );
+        pdnibydt[iIndex] = 0.0;
+    }
+    else
+    {
+        // The rates between this ion and the ion below were calculated on the previous pass
+        IonRateBelow = IonRate;
+        RecRateBelow = RecRate;
+
+        // Get the rates between this ion and the ion above
+        if( iIndex < Z )
+        {
+            if( bFineTables )
+            {
+                IonRate = ppFineIonRate[iIndex][jFine] + xFine * ( ppFineIonRate[iIndex][jFine+1] - ppFineIonRate[iIndex][jFine] );
+                RecRate = ppFineRecRate[iIndex][jFine] + xFine * ( ppFineRecRate[iIndex][jFine+1] - ppFineRecRate[iIndex][jFine] );
+            }
+            else if( bLogTables )
+            {
+                IonRate = GetLog10TableValue( ppIonRate[iIndex], jLin, wLinT );
+                RecRate = GetLog10TableValue( ppRecRate[iIndex], jLin, wLinT );
+            }
+            else if( rates_interpolation == INTERP_LINEAR )
+            {
+                IonRate = GetLinearTableValue( ppIonRate[iIndex], jLin, wLinT );
+                RecRate = GetLinearTableValue( ppRecRate[iIndex], jLin, wLinT );
+            }
+            else if( rates_interpolation == INTERP_HERMITE )
+            {
+                IonRate = InterpolateHermite( pTemp + j - 2, ppIonRate[iIndex] + j - 2, pContext->flog_10T_clamped, NULL );
+                RecRate = InterpolateHermite( pTemp + j - 2, ppRecRate[iIndex] + j - 2, pContext->flog_10T_clamped, NULL );
+            }
+            else
+            {
+                IonRate = RecRate = 0.0;
+
+                for( l=0; l<4; l++ )
+                {
+                    IonRate += w1[l] * ppIonRate[iIndex][j+l-2];
+                    RecRate += w1[l] * ppRecRate[iIndex][j+l-2];
+                }
+            }
+
+            // Check rates are physically realistic
+            if( IonRate < 0.0 ) IonRate = 0.0;
+            if( RecRate < 0.0 ) RecRate = 0.0;
+        }
+        else
+            IonRate = RecRate = 0.0;
+
+        TimeScale = GetIondnibydt( ne, iIndex > 0 ? pni[iIndex-1] : 0.0, pni[iIndex], iIndex < Z ? pni[iIndex+1] : 0.0, IonRateBelow, RecRateBelow, IonRate, RecRate, LOCAL_EPSILON_D, LOCAL_EPSILON_R, &pdnibydt[iIndex] );
+
+        if( TimeScale < SmallestTimeScale )
+            SmallestTimeScale = TimeScale;
+    }
+
+    // Add the emission from this ion
+    if( bEmissivity && ( i = pEmissIndex[iIndex] ) != -1 )
+    {
+        if( bLogTables )
+            fIonEmiss = GetLog10TableValue( ppEmiss[i], NumTemp, jLin, wLinT, kLin, wLinn );
+        else if( emissivities_interpolation == INTERP_LINEAR )
+            fIonEmiss = GetLinearTableValue( ppEmiss[i], NumTemp, jLin, wLinT, kLin, wLinn );
+        else if( emissivities_interpolation == INTERP_HERMITE )
+            fIonEmiss = InterpolateStencil2D( pEmissivitiesKernel, ppEmiss[i], NumTemp, pTemp, j, pContext->flog_10T_clamped, pDen, k, pContext->flog_10n_clamped, NULL, NULL );
+        else
+        {
+            fIonEmiss = 0.0;
+
+            for( l=0; l<4; l++ )
+            {
+                // Point to the emissivity set corresponding to the l'th density value
+                pfTemp = ppEmiss[i] + ( k + l - 2 ) * NumTemp;
+
+                for( m=0; m<4; m++ )
+                    fIonEmiss += w1[m] * w2[l] * pfTemp[j+m-2];
+            }
+        }
+
+        // Check emissivity is physically realistic
+        if( fIonEmiss > 0.0 )
+            Emiss += fIonEmiss * pni[iIndex];
+    }
+}
+
+*pTimeScale = SmallestTimeScale;
+
 return Emiss;
 }
@@ -3,6 +3,11 @@
 
 #include "../../rsp_toolkit/source/xmlreader.h"
 
+#include "interp.h"
+
+// Largest number of temperature values of the fine uniform tables chosen to meet <fine_table_tolerance>
+#define MAX_FINE_TABLE_TEMP 65537
+
 // Element class
 //
 // This class definition holds, sets, and gets all of the radiative emission
@@ -26,6 +31,9 @@ class CElement {
     /* Pointer to the spectroscopic numbers of the ions */
     int *pSpecNum;
 
+    /* Index in <ppEmiss> of the emissivities of each ion (by spectroscopic number - 1), or -1 if it has none */
+    int *pEmissIndex;
+
     /* Number of temperature values */
     int NumTemp;
 
@@ -62,6 +70,50 @@ class CElement {
   	/* Option for skipping emissivity calculation */
   	bool do_emiss_calc;
 
+    /* Option to calculate the equilibrium ion population fractions from the rates instead of reading them */
+    bool equilibrium_from_rates;
+
+    /* Spacing in log_10 T of the equilibrium ion population fractions calculated from the rates */
+    double equilibrium_resolution;
+
+    /* Number of temperature values of the equilibrium ion population fractions calculated from the rates */
+    int NumEquilTemp;
+
+    /* Option to look up the equilibrium ion population fractions by linear interpolation on a uniform log_10 T grid of <NumEquilTemp> values */
+    bool uniform_equilibrium;
+
+    /* Spacing in log_10 T of the fine uniform tables of the temperature only rates (0 if not requested) */
+    double fine_table_resolution;
+
+    /* Largest error of linear interpolation in the fine uniform tables relative to the polynomial interpolation (0 if not requested) */
+    double fine_table_tolerance;
+
+    /* Option to interpolate the temperature only rates linearly from the fine uniform tables */
+    bool bFineTables;
+
+    /* Number of temperature values of the fine uniform tables */
+    int NumFineTemp;
+
+    /* Reciprocal of the spacing in log_10 T of the fine uniform tables */
+    double fInvFineSpacing;
+
+    /* Total ionisation and recombination rate of each ion on the fine uniform temperature grid */
+    double **ppFineIonRate;
+    double **ppFineRecRate;
+
+    /* Option to hold the rate, emissivity and phi( n, T ) tables as log_10 values and interpolate them linearly in log space */
+    bool log_space_tables;
+
+    /* Option to interpolate the tables linearly in log space (set once the tables hold log_10 values) */
+    bool bLogTables;
+
+    /* Interpolation orders of the rate, ionisation balance, emissivity and phi( n, T ) tables (see <GetInterpolationKernel>), used
+       unless the tables are interpolated in log space or from the fine uniform tables */
+    int rates_interpolation, balances_interpolation, emissivities_interpolation, total_phi_interpolation;
+
+    /* Interpolation kernels of the orders above, selected once when the configuration is read */
+    INTERPKERNEL pRatesKernel, pBalancesKernel, pEmissivitiesKernel, pTotalPhiKernel;
+
     /* Emissivity data for an individual ion held in a <NumTemp>*<NumDen> size array */
     double **ppEmiss;
 
@@ -71,7 +123,7 @@ class CElement {
     /* Recombination rate of each ion at a specified temperature */
     double **ppRecRate;
 
-    /* Fractional population of an individual ion at a specified temperature */
+    /* Fractional population of an individual ion at a specified temperature (read or calculated from the rates) */
     double **ppIonFrac;
 
     /* Radiative loss function Phi at every temperature and density for each ion for the given element */
@@ -95,6 +147,59 @@ class CElement {
     // Function to open and read the ionisation balance file
     void OpenIonFracFile( char *szIonFracFilename );
 
+    // Function to calculate the equilibrium fractional population of the ions from the ionisation and recombination
+    // rates on a uniform log_10 T grid, used in place of the ionisation balance file
+    void CalculateEquilIonFrac( void );
+
+    // Function to interpolate the temperature only tables ppTable[0] to ppTable[iNumTables-1] at a specified temperature
+    // with a cubic polynomial, as the rates, setting negative values to zero
+    void InterpolateTables( double **ppTable, int iNumTables, double flog_10T, double *pValue );
+
+    // Function to resample the temperature only rates (and the ionisation balance, if it was read from file) onto a fine
+    // uniform log_10 T grid with the spacing <fine_table_resolution>, or with the spacing halved from the average tabulated
+    // spacing until linear interpolation between the fine values is within <fine_table_tolerance> of the polynomial
+    void ResampleFineTables( void );
+
+    // Function to select the two fine uniform temperature values surrounding a specified temperature and return the
+    // linear interpolation weight of the upper one in <px>
+    int LocateFineTemp( double flog_10T, double *px );
+
+    // Function to replace the rate tables (and the emissivity and phi( n, T ) tables, if calculated) by their log_10
+    // values, which are then interpolated linearly in log space (see <GetLog10TableValue>)
+    void ConvertTablesToLog10( void );
+
+    // Function to return the equilibrium fractional population of a particular ion from the uniform log_10 T grid
+    // (calculated from the rates or resampled onto the fine uniform grid)
+    double GetRatesEquilIonFrac( int iIon, double flog_10T );
+    double GetRatesEquilIonFrac( int iIon, double flog_10T, double flog_10n );
+
+    // Function to calculate the normalised equilibrium fractional population of every ion at a specified temperature
+    // (and density, if <pflog_10n> is not NULL) from a single stencil. Ion i is held at pni[ i * iIonStride ]. The stencils
+    // are hunted for from <piTempHint> and <piDenHint> (see <LocateStencil>) if they are not NULL
+    void GetStridedEquilIonFrac( double flog_10T, double *pflog_10n, double *pni, int iIonStride, int *piTempHint, int *piDenHint );
+
+    // Function to select the two uniformly spaced temperature values of the equilibrium ion population fractions calculated
+    // from the rates surrounding a specified temperature and calculate their linear interpolation weights
+    int LocateEquilTemp( double flog_10T, double *pw );
+
+    // Function to interpolate the equilibrium fractional population of every ion from the iNumT temperature values starting
+    // at j and the iNumn density values starting at k with the given weights, applying the cut-off and normalising to 1
+    void InterpolateEquilIonFrac( int j, int iNumT, double *wT, int iRowLength, int k, int iNumn, double *wn, double *pni, int iIonStride );
+
+    // Function to interpolate the equilibrium fractional population of every ion from the tabulated ionisation balance with
+    // the order <balances_interpolation> from the temperature stencil j and, if <pflog_10n> is not NULL, the density stencil k
+    // (otherwise the first set of values is used), applying the cut-off and normalising to 1
+    void InterpolateEquilIonFrac( int j, double flog_10T, int k, double *pflog_10n, double *pni, int iIonStride );
+
+    // Function to calculate the rate of change with respect to time of the fractional population of the ions and the
+    // characteristic time-scale, and the emissivity away from equilibrium if <bEmissivity> is True, from a cell context
+    double GetContextdnibydt( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale, bool bEmissivity );
+
+    // Function to calculate the rate of change with respect to time of the fractional population ni of an ion due to
+    // ionisation and recombination, from the populations of the ions either side of it (zero if there are none) and the
+    // rates between them, and to return its characteristic time-scale for the accuracies <fEpsilon_d> and <fEpsilon_r>
+    double GetIondnibydt( double ne, double niBelow, double ni, double niAbove, double IonRateBelow, double RecRateBelow, double IonRate, double RecRate, double fEpsilon_d, double fEpsilon_r, double *pdnibydt );
+
     // Calculate radiative loss function Phi at every temperature and density for a given ion
     void CalculatePhi( void );
 
@@ -107,6 +212,10 @@ class CElement {
     // Function to return the required emissivity values
     double GetIonEmissivity( int iIon, double flog_10T, double flog_10n );
 
+    // Function to calculate the fractional population of the ions at the face between cells iFace-1 and iFace
+    // using Barton's method
+    void GetFaceIonFrac( int iFace, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pFaceni );
+
   public:
 
     // Default constructor
@@ -134,16 +243,40 @@ class CElement {
     // Function to return the element abundance
     double GetAbundance( void );
 
+    // Function to return the memory (in bytes) held by the fine uniform tables (0 if they are not used)
+    long GetFineTableSize( void );
+
     // Function to return the total ionisation and total recombination rate
     // for a particular ion at a specified temperature and density
     void GetRates( int iIon, double flog_10T, double *pfIonRate, double *pfRecRate );
     void GetRates( int iIon, double flog_10T, double flog_10n, double *pfIonRate, double *pfRecRate );
 
+    // Function to return the total ionisation and recombination rates of every ion at a specified
+    // temperature (and density), together with their derivatives with respect to log_10 T (may be NULL)
+    void GetAllRates( double flog_10T, double *pIonRate, double *pRecRate, double *pdIonRatebydlog_10T, double *pdRecRatebydlog_10T );
+    void GetAllRates( double flog_10T, double flog_10n, double *pIonRate, double *pRecRate );
+
+    // Functions as above which hunt for the temperature (and density) stencils from the stencil indices of the previous
+    // call held by <piTempHint> (and <piDenHint>), for use when sweeping through smoothly varying values (see <LocateStencil>)
+    void GetAllRates( double flog_10T, double *pIonRate, double *pRecRate, double *pdIonRatebydlog_10T, double *pdRecRatebydlog_10T, int *piTempHint );
+    void GetAllRates( double flog_10T, double flog_10n, double *pIonRate, double *pRecRate, int *piTempHint, int *piDenHint );
+
     // Function to return the fractional population of a particular ion at a
     // specified temperature and density in equilibrium
     double GetEquilIonFrac( int iIon, double flog_10T );
     double GetEquilIonFrac( int iIon, double flog_10T, double flog_10n );
 
+    // Functions to return the fractional population of every ion at a specified temperature and density in equilibrium,
+    // normalised to 1, locating the stencil and calculating the interpolation weights once for all of the ions
+    void GetAllEquilIonFrac( double flog_10T, double *pni );
+    void GetAllEquilIonFrac( double flog_10T, double flog_10n, double *pni );
+
+    // Function to set the fractional population of the ions to their equilibrium values (as <GetAllEquilIonFrac>) in
+    // every cell of a grid. The fractional population of ion i in cell c is held at pni[ c * iCellStride + i * iIonStride ].
+    // If <pflog_10n> is NULL the temperature only equilibrium is used. The stencil of each cell is hunted for from that of
+    // the previous cell. The cells are shared between threads when compiled with OPENMP
+    void GetGridEquilIonFrac( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride );
+
     // Functions to calculate the emissivity in equilibrium (this number includes multiplication by the ion fraction)
     // Multiply by the number density squared to obtain the energy radiatied in units of erg cm^-3 s^-1
     double GetEmissivity( int iIon, double flog_10T, double flog_10n );
@@ -154,11 +287,59 @@ class CElement {
     void Getdnibydt( double flog_10T, double flog_10n, double *pni0, double *pni1, double *pni2, double *pni3, double *pni4, double *s, double *s_pos, double *pv, double delta_s, double *pdnibydt, double *pTimeScale );
 	void Getdnibydt( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale );
 
+    // Function to calculate the rate of change with respect to time of the fractional population of the ions and the
+    // characteristic time-scale (as the simple overload of <Getdnibydt>) from the total ionisation and recombination
+    // rates of every ion already interpolated (see <GetAllRates>) and the electron number density <ne>, so that the
+    // rates can be re-used (see <CRadiation::GetAlldnibydt>). If <bEquilibrium> is True the ion populations are reset
+    // to equilibrium at <flog_10T> instead
+    void GetdnibydtFromRates( double flog_10T, double ne, bool bEquilibrium, double *pIonRate, double *pRecRate, double *pni, double *pdnibydt, double *pTimeScale );
+
+    // Function to calculate the rate of change with respect to time of the fractional population of the ions and the
+    // characteristic time-scale in every cell of a 1D grid slice using Barton's method, as the IonPopSolver overload
+    // of <Getdnibydt>. The fractional population of ion i in cell c is held at pni[ c * iCellStride + i * iIonStride ],
+    // so the slice may be stored as [cell][ion] or [ion][cell]; <pdnibydt> uses the same layout. <s> and <pdelta_s>
+    // hold the position and width of each cell and <s_face> and <pv_face> (iNumCells+1 values) the position and
+    // velocity of the face between cells c-1 and c. The rates of change and time-scales are calculated for every cell;
+    // the fluxes need two cells either side, so cells 0, 1, iNumCells-2 and iNumCells-1 (and every cell of a grid of
+    // fewer than 5 cells) change by ionisation and recombination alone. The face values are calculated once per face and shared by the cells either side of it, so an
+    // ion reset to equilibrium in a cell does not change the fluxes already calculated at that cell's faces. The rate
+    // stencil of each cell is hunted for from that of the previous cell
+    void GetGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale );
+
+    // Function to calculate the rates of change as above, replacing the time-scale held for each cell only by a smaller
+    // one if <bSmallest> is True, so that the smallest time-scale of several elements can be found without scratch space
+    void GetGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale, bool bSmallest );
+
     // Functions to calculate the emissivity away from equilibrium (this number includes multiplication by the ion fraction)
     // Multiply by the number density squared to obtain the energy radiatied in units of erg cm^-3 s^-1
     double GetEmissivity( int iIon, double flog_10T, double flog_10n, double ni );
     double GetEmissivity( double flog_10T, double flog_10n, double *pni );
 
+    // Function to calculate the rate of change with respect to time of the fractional population of the ions
+    // (as the simple overload of <Getdnibydt>) together with its analytic Jacobian. The Jacobian with respect to
+    // the fractional populations is tridiagonal and is returned as its lower, main and upper diagonals; the
+    // derivatives with respect to temperature (K) and electron number density (cm^-3) are returned for each ion
+    void GetdnibydtJacobian( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pJacLower, double *pJacDiag, double *pJacUpper, double *pdnibydtbydT, double *pdnibydtbydn );
+
+    // Function to calculate the emissivity away from equilibrium together with its derivatives with respect to the
+    // fractional population of each ion and to log_10 T and log_10 n
+    double GetEmissivityDerivatives( double flog_10T, double flog_10n, double *pni, double *pdEmissbydni, double *pdEmissbydlog_10T, double *pdEmissbydlog_10n );
+
+    // Function to calculate the rate of change with respect to time of the fractional population of the ions and the
+    // characteristic time-scale (as the simple overload of <Getdnibydt>) and the emissivity away from equilibrium of the
+    // resulting ion populations (as <GetEmissivity>) in a single pass over the ions, sharing the temperature stencil and
+    // interpolation weights between the rates and the emissivities
+    double GetdnibydtAndEmissivity( double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale );
+
+    // Functions equivalent to those above which take a cell context (see <SetCellContext>) in place of the temperature
+    // and density, re-using its clamped coordinates, stencils, interpolation weights and electron number density rather
+    // than calculating them again for each element. The context must have been set up on this element's ranges
+    double GetEmissivity( CELLCONTEXT *pContext );
+    double GetEmissivity( CELLCONTEXT *pContext, double *pni );
+    void Getdnibydt( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale );
+    double GetdnibydtAndEmissivity( CELLCONTEXT *pContext, double *pni, double *pdnibydt, double *pTimeScale );
+    void GetAllEquilIonFrac( CELLCONTEXT *pContext, double *pni );
+
 };
 
 typedef CElement* PELEMENT;
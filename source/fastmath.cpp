@@ -0,0 +1,226 @@
+// ****
+// *
+// * Fast Exp10 and Log10 Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "fastmath.h"
+
+// The loops of the array versions only vectorise if the comparisons selecting the special cases may be evaluated for
+// every element, which GCC does not assume while floating point exceptions are trapped
+#if defined( FASTMATH ) && defined( __GNUC__ ) && !defined( __clang__ )
+#pragma GCC optimize ( "tree-vectorize", "no-trapping-math" )
+#endif // FASTMATH
+
+
+// log_10 2 split so that the product of the leading part with any exponent is exact
+#define LOG10_2_HI 0.3010299955494702
+#define LOG10_2_LO 1.1451100898021838e-10
+
+// ln 10 split so that the product of the leading part with a 26 bit value is exact
+#define LN_10_FAST 2.302585092994046
+#define LN_10_HI 2.3025850653648376
+#define LN_10_LO 2.7629208037533617e-08
+
+// log_10 e split so that the product of the leading part with a 21 bit value is exact
+#define LOG10_E_HI 0.4342944818781689
+#define LOG10_E_LO 2.5082946711645275e-11
+
+#define LOG2_10 3.321928094887362
+
+// Multiplying by 2^27 + 1 splits a double into two halves of 26 bits (Dekker)
+#define SPLIT_FACTOR 134217729.0
+
+// Adding 1.5 x 2^52 rounds a double to an integer held in the low bits of the sum
+#define ROUND_MAGIC 6755399441055744.0
+#define ROUND_MAGIC_BITS 0x4338000000000000ULL
+
+// Bits of 2^52, to the low bits of which an integer below 2^52 is added to convert it to a double
+#define CONVERT_MAGIC 4503599627370496.0
+#define CONVERT_MAGIC_BITS 0x4330000000000000ULL
+
+// Bits of sqrt( 2 ) / 2, the lower limit of the reduced argument of log_10 x
+#define SQRT_HALF_BITS 0x3fe6a09e667f3bcdULL
+
+#define EXPONENT_MASK 0xfff0000000000000ULL
+
+// Smallest normal double
+#define SMALLEST_NORMAL 2.2250738585072014e-308
+
+
+static inline uint64_t AsBits( double x )
+{
+uint64_t u;
+
+memcpy( &u, &x, sizeof(u) );
+
+return u;
+}
+
+static inline double AsDouble( uint64_t u )
+{
+double x;
+
+memcpy( &x, &u, sizeof(x) );
+
+return x;
+}
+
+static inline double Exp10Kernel( double x )
+{
+double fk, fa, fb, fx, fxlo, fc, fxhi, r, rlo, r2, r4, p, y;
+uint64_t u, u1, u2;
+
+// 10^x = 2^k e^r, with k the nearest integer to x log_2 10 and r = ( x - k log_10 2 ) ln 10, | r | <= ln( 2 ) / 2
+fk = x * LOG2_10 + ROUND_MAGIC;
+u = AsBits( fk ) - ROUND_MAGIC_BITS + 2048;
+fk -= ROUND_MAGIC;
+
+// x - k log_10 2 is held as the sum fx + fxlo and r as the sum r + rlo, so that the rounding errors of the
+// reduction remain well below an ulp of the result
+fa = x - fk * LOG10_2_HI;
+fb = -fk * LOG10_2_LO;
+fx = fa + fb;
+fxlo = ( fa - fx ) + fb;
+
+fc = fx * SPLIT_FACTOR;
+fxhi = fc - ( fc - fx );
+
+r = fx * LN_10_FAST;
+rlo = ( ( fxhi * LN_10_HI - r ) + fxhi * LN_10_LO + ( fx - fxhi ) * LN_10_HI ) + ( fx - fxhi ) * LN_10_LO + fxlo * LN_10_FAST;
+
+// Taylor series of ( e^r - 1 - r ) / r^2, the first neglected term being below 5E-18 of e^r. The terms from r^4 on are
+// evaluated by Estrin's scheme to shorten the chain of dependent operations
+r2 = r * r;
+r4 = r2 * r2;
+p = ( 0.041666666666666664 + 0.008333333333333333 * r ) + r2 * ( 0.001388888888888889 + 0.0001984126984126984 * r )
+    + r4 * ( ( 2.48015873015873e-05 + 2.7557319223985893e-06 * r ) + r2 * ( 2.755731922398589e-07 + 2.505210838544172e-08 * r ) )
+    + r4 * r4 * ( 2.08767569878681e-09 + 1.6059043836821613e-10 * r );
+p = 0.5 + r * ( 0.16666666666666666 + r * p );
+
+p = 1.0 + ( r + ( rlo + r2 * p ) );
+
+// Scale by 2^k in two steps, 2^k1 and 2^k2 with k1 + k2 = k, so that neither factor overflows and a subnormal
+// result is rounded only once. u holds k + 2048
+u1 = ( u >> 1 ) - 1;
+u2 = u - ( u >> 1 ) - 1;
+
+y = ( p * AsDouble( u1 << 52 ) ) * AsDouble( u2 << 52 );
+
+// Within these limits the scaling remains in range, and beyond them the result is zero or infinite. NaN passes
+// through the calculation and the comparisons unchanged
+y = x < -330.0 ? 0.0 : y;
+y = x > 310.0 ? HUGE_VAL : y;
+
+return y;
+}
+
+static inline double Log10Kernel( double x )
+{
+double xs, fe, m, f, hfsq, s, z, z2, z4, q, fhi, flo, y, fvalhi, fvallo;
+uint64_t u, t;
+
+// Scale subnormal values into the normal range
+xs = x < SMALLEST_NORMAL ? x * 18014398509481984.0 : x;
+fe = x < SMALLEST_NORMAL ? -54.0 : 0.0;
+
+// x = 2^e m with m in [ sqrt( 2 ) / 2, sqrt( 2 ) )
+u = AsBits( xs );
+t = u - SQRT_HALF_BITS;
+m = AsDouble( u - ( t & EXPONENT_MASK ) );
+
+// e is offset by 1024 to keep the shifted value positive and converted to a double through the low bits of 2^52
+fe += AsDouble( CONVERT_MAGIC_BITS | ( ( t + 0x4000000000000000ULL ) >> 52 ) ) - ( CONVERT_MAGIC + 1024.0 );
+
+// With f = m - 1 and s = f / ( 2 + f ), ln m = 2 atanh( s ) = f - f^2 / 2 + s ( f^2 / 2 + R ), where
+// R = 2 ( s^2 / 3 + s^4 / 5 + ... ), | s | < 0.172 and the first neglected term is below 1E-18 of ln m.
+// The series is evaluated by Estrin's scheme
+f = m - 1.0;
+hfsq = 0.5 * f * f;
+s = f / ( 2.0 + f );
+z = s * s;
+
+z2 = z * z;
+z4 = z2 * z2;
+q = ( 0.3333333333333333 + 0.2 * z ) + z2 * ( 0.14285714285714285 + 0.1111111111111111 * z )
+    + z4 * ( ( 0.09090909090909091 + 0.07692307692307693 * z ) + z2 * ( 0.06666666666666667 + 0.058823529411764705 * z ) )
+    + z4 * z4 * ( 0.05263157894736842 + 0.047619047619047616 * z );
+q = 2.0 * z * q;
+
+// ln m is held as the sum fhi + flo, fhi having its low 32 bits cleared so that its product with the leading part
+// of log_10 e is exact, and the parts are summed from the smallest
+fhi = AsDouble( AsBits( f - hfsq ) & 0xffffffff00000000ULL );
+flo = ( f - fhi ) - hfsq + s * ( hfsq + q );
+
+fvalhi = fhi * LOG10_E_HI;
+fvallo = ( flo + fhi ) * LOG10_E_LO + flo * LOG10_E_HI;
+
+y = fe * LOG10_2_HI;
+fvallo += fe * LOG10_2_LO + ( ( y - ( y + fvalhi ) ) + fvalhi );
+y = ( y + fvalhi ) + fvallo;
+
+// Zero, negative values, infinity and NaN
+y = x > 0.0 ? y : ( x == 0.0 ? -HUGE_VAL : NAN );
+y = x == HUGE_VAL ? HUGE_VAL : y;
+
+return y;
+}
+
+double FastExp10( double x )
+{
+return Exp10Kernel( x );
+}
+
+double FastLog10( double x )
+{
+return Log10Kernel( x );
+}
+
+double Exp10( double x )
+{
+#ifdef FASTMATH
+return Exp10Kernel( x );
+#else // FASTMATH
+return pow( 10.0, x );
+#endif // FASTMATH
+}
+
+double Log10( double x )
+{
+#ifdef FASTMATH
+return Log10Kernel( x );
+#else // FASTMATH
+return log10( x );
+#endif // FASTMATH
+}
+
+void Exp10Array( int iNumValues, double *px, double *py )
+{
+int i;
+
+for( i=0; i<iNumValues; i++ )
+#ifdef FASTMATH
+    py[i] = Exp10Kernel( px[i] );
+#else // FASTMATH
+    py[i] = pow( 10.0, px[i] );
+#endif // FASTMATH
+}
+
+void Log10Array( int iNumValues, double *px, double *py )
+{
+int i;
+
+for( i=0; i<iNumValues; i++ )
+#ifdef FASTMATH
+    py[i] = Log10Kernel( px[i] );
+#else // FASTMATH
+    py[i] = log10( px[i] );
+#endif // FASTMATH
+}
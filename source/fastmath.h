@@ -0,0 +1,72 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+// Fast exp10 and log10 kernels
+//
+// Polynomial kernels for 10^x and log_10 x written without branches or tables on plain doubles and
+// integer bit operations, so that the loops of the array versions vectorise (with SSE2 and, if enabled
+// by the compiler flags, AVX2 and FMA). The radiation module calls <Exp10> and <Log10> in place of
+// pow( 10.0, x ) and log10( x ) in its hot paths; these call the kernels when compiled with FASTMATH
+// defined and the C library otherwise, so that results differ between the two builds at the level of
+// rounding.
+//
+// Accuracy, measured against long double over 10^7 random arguments in each range:
+//
+//   <FastExp10>  below 1 ulp for x in [ -300, 300 ] (0.97 ulp largest error found), and below one
+//                smallest subnormal for results in the subnormal range
+//   <FastLog10>  below 1 ulp for x in [ 1E-300, 1E300 ] (0.74 ulp largest error found, near x = 1.4),
+//                including x close to 1 and subnormal x
+//
+// Integer powers of 10 are not guaranteed to be exact. Results below the smallest subnormal are returned
+// as zero, results beyond the largest double as infinity, and NaN as NaN. <FastLog10> returns -infinity
+// for zero, NaN for negative values and infinity for infinity.
+//
+// With the vectorised array versions a loop of 10^x takes about a third (SSE2) to a seventh (AVX2) of the
+// time of pow( 10.0, x ), and a loop of log_10 x about two thirds to a third of that of log10( x ).
+// A single call of <FastExp10> is about a third faster than pow( 10.0, x ), while <FastLog10> is no faster
+// than log10( x ) and is used in scalar paths so that they agree with the array versions.
+//
+
+// Calculate 10^x
+// @x exponent
+//
+// @return 10^x
+//
+double FastExp10( double x );
+
+// Calculate log_10 x
+// @x value
+//
+// @return log_10 x
+//
+double FastLog10( double x );
+
+// Calculate 10^x with <FastExp10> if FASTMATH is defined, or with pow( 10.0, x ) otherwise
+// @x exponent
+//
+// @return 10^x
+//
+double Exp10( double x );
+
+// Calculate log_10 x with <FastLog10> if FASTMATH is defined, or with log10( x ) otherwise
+// @x value
+//
+// @return log_10 x
+//
+double Log10( double x );
+
+// Calculate 10^x for an array of values, as <Exp10>
+// @iNumValues number of values
+// @px exponents
+// @py results (may be the same array as <px>)
+//
+void Exp10Array( int iNumValues, double *px, double *py );
+
+// Calculate log_10 x for an array of values, as <Log10>
+// @iNumValues number of values
+// @px values
+// @py results (may be the same array as <px>)
+//
+void Log10Array( int iNumValues, double *px, double *py );
+
+#endif
@@ -0,0 +1,447 @@
+// ****
+// *
+// * Interpolation Stencil Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "interp.h"
+#include "fastmath.h"
+
+
+int LocateStencil( double *pGrid, int iNumPoints, double *pfx )
+{
+int j;
+
+// If the value is out of range then set it to the appropriate limit
+if( *pfx < pGrid[0] )
+    *pfx = pGrid[0];
+else if( *pfx > pGrid[iNumPoints-1] )
+    *pfx = pGrid[iNumPoints-1];
+
+for( j=0; j<iNumPoints; j++ )
+    if( pGrid[j] >= *pfx ) break;
+
+// Deal with the special cases where there aren't two values either side of the
+// desired one
+if( j < 2 ) j = 2;
+else if( j == iNumPoints-1 ) j = iNumPoints-2;
+
+return j;
+}
+
+int LocateStencil( double *pGrid, int iNumPoints, double *pfx, int *piHint )
+{
+int j;
+
+if( !piHint ) return LocateStencil( pGrid, iNumPoints, pfx );
+
+// If the value is out of range then set it to the appropriate limit
+if( *pfx < pGrid[0] )
+    *pfx = pGrid[0];
+else if( *pfx > pGrid[iNumPoints-1] )
+    *pfx = pGrid[iNumPoints-1];
+
+// Hunt for the interval containing the value from the interval below the previous stencil index
+j = HuntGrid( pGrid, iNumPoints, *pfx, *piHint - 1 );
+
+// Select the first grid value not less than the desired one, as above
+if( pGrid[j] < *pfx ) j++;
+
+// Deal with the special cases where there aren't two values either side of the
+// desired one
+if( j < 2 ) j = 2;
+else if( j == iNumPoints-1 ) j = iNumPoints-2;
+
+*piHint = j;
+
+return j;
+}
+
+void GetLagrangeWeights( double *x, int iNumPoints, double fx, double *pw, double *pdw )
+{
+double fProduct, fTerm;
+int i, k, l;
+
+for( i=0; i<iNumPoints; i++ )
+{
+    // Weight of the i'th point: prod_k( fx - x[k] ) / ( x[i] - x[k] ), k != i
+    fProduct = 1.0;
+    for( k=0; k<iNumPoints; k++ )
+        if( k != i )
+            fProduct *= ( fx - x[k] ) / ( x[i] - x[k] );
+    pw[i] = fProduct;
+
+    if( !pdw ) continue;
+
+    // Derivative of the weight: sum over l of the product with the l'th factor differentiated
+    pdw[i] = 0.0;
+    for( l=0; l<iNumPoints; l++ )
+    {
+        if( l == i ) continue;
+
+        fTerm = 1.0 / ( x[i] - x[l] );
+        for( k=0; k<iNumPoints; k++ )
+            if( k != i && k != l )
+                fTerm *= ( fx - x[k] ) / ( x[i] - x[k] );
+        pdw[i] += fTerm;
+    }
+}
+}
+
+int HuntGrid( double *pGrid, int iNumPoints, double fx, int iGuess )
+{
+int jlo, jhi, jm, iStep;
+
+if( fx <= pGrid[0] ) return 0;
+if( fx >= pGrid[iNumPoints-1] ) return iNumPoints-2;
+
+if( iGuess < 0 || iGuess > iNumPoints-2 )
+{
+    // Search the whole grid
+    jlo = 0;
+    jhi = iNumPoints-1;
+}
+else if( fx >= pGrid[iGuess] )
+{
+    // Hunt upwards
+    jlo = iGuess;
+    jhi = jlo + 1;
+    iStep = 1;
+
+    while( fx >= pGrid[jhi] )
+    {
+        jlo = jhi;
+        iStep += iStep;
+        jhi = jlo + iStep;
+
+        if( jhi > iNumPoints-1 )
+        {
+            jhi = iNumPoints-1;
+            break;
+        }
+    }
+}
+else
+{
+    // Hunt downwards
+    jhi = iGuess;
+    jlo = jhi - 1;
+    iStep = 1;
+
+    while( fx < pGrid[jlo] )
+    {
+        jhi = jlo;
+        iStep += iStep;
+        jlo = jhi - iStep;
+
+        if( jlo < 0 )
+        {
+            jlo = 0;
+            break;
+        }
+    }
+}
+
+// Bisect until pGrid[jlo] <= fx < pGrid[jhi] with jhi = jlo + 1
+while( jhi - jlo > 1 )
+{
+    jm = ( jlo + jhi ) / 2;
+
+    if( fx >= pGrid[jm] )
+        jlo = jm;
+    else
+        jhi = jm;
+}
+
+return jlo;
+}
+
+int GetLinearInterval( double *pGrid, int iNumPoints, int j, double fx, double *pw )
+{
+int i;
+
+// The value lies between the two middle points of the stencil, except near the ends of the grid
+i = j - 1;
+while( i > 0 && fx < pGrid[i] ) i--;
+while( i < iNumPoints-2 && fx > pGrid[i+1] ) i++;
+
+*pw = ( fx - pGrid[i] ) / ( pGrid[i+1] - pGrid[i] );
+
+return i;
+}
+
+int LocateLinearInterval( double *pGrid, int iNumPoints, double *pfx, double *pw )
+{
+int i;
+
+// If the value is out of range then set it to the appropriate limit
+if( *pfx < pGrid[0] )
+    *pfx = pGrid[0];
+else if( *pfx > pGrid[iNumPoints-1] )
+    *pfx = pGrid[iNumPoints-1];
+
+i = HuntGrid( pGrid, iNumPoints, *pfx, -1 );
+
+// A value on a grid point is placed at the top of the interval below it, except on the second point, where the
+// stencil held away from the end of the grid places it at the bottom of the interval above (as <GetLinearInterval>)
+if( i > 1 && *pfx == pGrid[i] ) i--;
+
+*pw = ( *pfx - pGrid[i] ) / ( pGrid[i+1] - pGrid[i] );
+
+return i;
+}
+
+void ConvertToLog10( double *pTable, int iNumValues )
+{
+int i;
+
+for( i=0; i<iNumValues; i++ )
+{
+    if( pTable[i] > 0.0 )
+        pTable[i] = log10( pTable[i] );
+    else
+        pTable[i] = LOG_TABLE_ZERO;
+}
+}
+
+double GetLog10TableValue( double *pTable, int i, double w )
+{
+return exp( LN_10 * ( pTable[i] + w * ( pTable[i+1] - pTable[i] ) ) );
+}
+
+double GetLog10TableValue( double *pTable, int iRowLength, int i, double wT, int k, double wn )
+{
+double *pLower, *pUpper, fLower, fUpper;
+
+pLower = pTable + k * iRowLength + i;
+pUpper = pLower + iRowLength;
+
+fLower = pLower[0] + wT * ( pLower[1] - pLower[0] );
+fUpper = pUpper[0] + wT * ( pUpper[1] - pUpper[0] );
+
+return exp( LN_10 * ( fLower + wn * ( fUpper - fLower ) ) );
+}
+
+double GetLinearTableValue( double *pTable, int i, double w )
+{
+return pTable[i] + w * ( pTable[i+1] - pTable[i] );
+}
+
+double GetLinearTableValue( double *pTable, int iRowLength, int i, double wT, int k, double wn )
+{
+double *pLower, *pUpper, fLower, fUpper;
+
+pLower = pTable + k * iRowLength + i;
+pUpper = pLower + iRowLength;
+
+fLower = pLower[0] + wT * ( pLower[1] - pLower[0] );
+fUpper = pUpper[0] + wT * ( pUpper[1] - pUpper[0] );
+
+return fLower + wn * ( fUpper - fLower );
+}
+
+int GetInterpolationOrder( const char *szOrder )
+{
+if( !strcmp( szOrder, "linear" ) ) return INTERP_LINEAR;
+if( !strcmp( szOrder, "cubic" ) ) return INTERP_CUBIC;
+if( !strcmp( szOrder, "hermite" ) ) return INTERP_HERMITE;
+
+printf( "Warning: unknown interpolation order %s. Using cubic interpolation.\n", szOrder );
+
+return INTERP_CUBIC;
+}
+
+double InterpolateLinear( double *x, double *y, double fx, double *pdy )
+{
+double fSlope;
+int i;
+
+// Select the interval containing the value, which is the middle one except near the ends of the grid
+if( fx < x[1] ) i = 0;
+else if( fx > x[2] ) i = 2;
+else i = 1;
+
+fSlope = ( y[i+1] - y[i] ) / ( x[i+1] - x[i] );
+
+if( pdy ) *pdy = fSlope;
+
+return y[i] + fSlope * ( fx - x[i] );
+}
+
+double InterpolateCubic( double *x, double *y, double fx, double *pdy )
+{
+double d0, d1, d2, d3, w0, w1, w2, w3;
+
+d0 = fx - x[0];
+d1 = fx - x[1];
+d2 = fx - x[2];
+d3 = fx - x[3];
+
+// Lagrange weights of the four points with their denominators folded into the tabulated values
+w0 = y[0] / ( ( x[0] - x[1] ) * ( x[0] - x[2] ) * ( x[0] - x[3] ) );
+w1 = y[1] / ( ( x[1] - x[0] ) * ( x[1] - x[2] ) * ( x[1] - x[3] ) );
+w2 = y[2] / ( ( x[2] - x[0] ) * ( x[2] - x[1] ) * ( x[2] - x[3] ) );
+w3 = y[3] / ( ( x[3] - x[0] ) * ( x[3] - x[1] ) * ( x[3] - x[2] ) );
+
+if( pdy )
+    *pdy = w0 * ( d2 * d3 + d1 * d3 + d1 * d2 ) + w1 * ( d2 * d3 + d0 * d3 + d0 * d2 ) + w2 * ( d1 * d3 + d0 * d3 + d0 * d1 ) + w3 * ( d1 * d2 + d0 * d2 + d0 * d1 );
+
+return w0 * d1 * d2 * d3 + w1 * d0 * d2 * d3 + w2 * d0 * d1 * d3 + w3 * d0 * d1 * d2;
+}
+
+double InterpolateHermite( double *x, double *y, double fx, double *pdy )
+{
+double h[3], d[3], m0, m1, t, t2, t3, fWidth;
+int i, l;
+
+// Select the interval containing the value, which is the middle one except near the ends of the grid
+if( fx < x[1] ) i = 0;
+else if( fx > x[2] ) i = 2;
+else i = 1;
+
+// Widths and slopes of the three intervals of the stencil
+for( l=0; l<3; l++ )
+{
+    h[l] = x[l+1] - x[l];
+    d[l] = ( y[l+1] - y[l] ) / h[l];
+}
+
+// Slopes at the ends of the interval: the weighted harmonic mean of the adjacent interval slopes at an interior
+// point of the stencil (or zero at an extremum) and the slope of the adjacent interval at an end point
+if( i == 0 )
+    m0 = d[0];
+else if( d[i-1] * d[i] > 0.0 )
+    m0 = 3.0 * ( h[i-1] + h[i] ) * d[i-1] * d[i] / ( ( 2.0 * h[i] + h[i-1] ) * d[i] + ( h[i] + 2.0 * h[i-1] ) * d[i-1] );
+else
+    m0 = 0.0;
+
+if( i == 2 )
+    m1 = d[2];
+else if( d[i] * d[i+1] > 0.0 )
+    m1 = 3.0 * ( h[i] + h[i+1] ) * d[i] * d[i+1] / ( ( 2.0 * h[i+1] + h[i] ) * d[i+1] + ( h[i+1] + 2.0 * h[i] ) * d[i] );
+else
+    m1 = 0.0;
+
+fWidth = h[i];
+t = ( fx - x[i] ) / fWidth;
+t2 = t * t;
+t3 = t2 * t;
+
+if( pdy )
+    *pdy = 6.0 * ( t2 - t ) * ( y[i] - y[i+1] ) / fWidth + ( 3.0 * t2 - 4.0 * t + 1.0 ) * m0 + ( 3.0 * t2 - 2.0 * t ) * m1;
+
+// Cubic Hermite basis functions
+return ( 2.0 * t3 - 3.0 * t2 + 1.0 ) * y[i] + ( t3 - 2.0 * t2 + t ) * fWidth * m0 + ( 3.0 * t2 - 2.0 * t3 ) * y[i+1] + ( t3 - t2 ) * fWidth * m1;
+}
+
+INTERPKERNEL GetInterpolationKernel( int iOrder )
+{
+switch( iOrder )
+{
+    case INTERP_LINEAR:
+        return InterpolateLinear;
+    case INTERP_HERMITE:
+        return InterpolateHermite;
+    default:
+        return InterpolateCubic;
+}
+}
+
+double InterpolateStencil2D( INTERPKERNEL pKernel, double *pTable, int iRowLength, double *pTemp, int j, double flog_10T, double *pDen, int k, double flog_10n, double *pdbydlog_10T, double *pdbydlog_10n )
+{
+double y[4], dy[4], *pdy, *pRow, result;
+int l, iFirst, iLast;
+
+// Linear interpolation in density only needs the two density sets either side of the desired value
+iFirst = 0;
+iLast = 4;
+if( pKernel == InterpolateLinear )
+{
+    if( flog_10n < pDen[k-1] ) iFirst = 0;
+    else if( flog_10n > pDen[k] ) iFirst = 2;
+    else iFirst = 1;
+
+    iLast = iFirst + 2;
+}
+
+// The temperature derivatives of the density sets are only needed if the temperature derivative is requested
+pdy = NULL;
+
+// Interpolate each density set in temperature
+for( l=iFirst; l<iLast; l++ )
+{
+    pRow = pTable + ( k + l - 2 ) * iRowLength + j - 2;
+
+    if( pdbydlog_10T ) pdy = dy + l;
+
+    y[l] = pKernel( pTemp + j - 2, pRow, flog_10T, pdy );
+}
+
+// Interpolate the results in density
+result = pKernel( pDen + k - 2, y, flog_10n, pdbydlog_10n );
+
+if( pdbydlog_10T )
+    *pdbydlog_10T = pKernel( pDen + k - 2, dy, flog_10n, NULL );
+
+return result;
+}
+
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, CELLCONTEXT *pContext )
+{
+SetCellContext( pTemp, iNumTemp, pDen, iNumDen, fMaxDensity, flog_10T, flog_10n, pContext, false );
+}
+
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, CELLCONTEXT *pContext, bool bHint )
+{
+SetCellContext( pTemp, iNumTemp, pDen, iNumDen, fMaxDensity, flog_10T, flog_10n, 0.0, 0.0, pContext, bHint );
+}
+
+void SetLinearCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double T, double n, CELLCONTEXT *pContext, bool bHint )
+{
+SetCellContext( pTemp, iNumTemp, pDen, iNumDen, fMaxDensity, Log10( T ), Log10( n ), T, n, pContext, bHint );
+}
+
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, double T, double n, CELLCONTEXT *pContext, bool bHint )
+{
+double x[4];
+int l;
+
+pContext->flog_10T = flog_10T;
+pContext->flog_10n = flog_10n;
+pContext->T = T;
+
+// Select the four temperature and four density values surrounding the desired ones
+pContext->flog_10T_clamped = flog_10T;
+pContext->j = LocateStencil( pTemp, iNumTemp, &(pContext->flog_10T_clamped), bHint ? &(pContext->j) : NULL );
+
+for( l=0; l<4; l++ )
+    x[l] = pTemp[pContext->j+l-2];
+GetLagrangeWeights( x, 4, pContext->flog_10T_clamped, pContext->wT, NULL );
+
+pContext->flog_10n_clamped = flog_10n;
+pContext->k = LocateStencil( pDen, iNumDen, &(pContext->flog_10n_clamped), bHint ? &(pContext->k) : NULL );
+
+for( l=0; l<4; l++ )
+    x[l] = pDen[pContext->k+l-2];
+GetLagrangeWeights( x, 4, pContext->flog_10n_clamped, pContext->wn, NULL );
+
+// Calculate the electron number density, unless it is known, and the number density limited to the optically thin range
+pContext->ne = n > 0.0 ? n : Exp10( flog_10n );
+
+if( flog_10n > fMaxDensity )
+    pContext->n = Exp10( fMaxDensity );
+else
+    pContext->n = pContext->ne;
+
+pContext->n2 = pContext->n * pContext->n;
+
+pContext->bEquilibrium = ( flog_10n >= fMaxDensity );
+}
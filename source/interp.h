@@ -0,0 +1,285 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+// Interpolation stencil functions
+//
+// These functions factor out the stencil search and the polynomial interpolation
+// weights used throughout <CElement> and <CRadiation>, so that callers which need
+// the same stencil for many tables (or the derivatives of the interpolating
+// polynomials) can calculate them once and re-use them.
+//
+
+// Locate the four-point interpolation stencil
+// @pGrid monotonically increasing grid values
+// @iNumPoints number of grid values
+// @pfx value to locate; clamped to the grid range on return
+//
+// Clamp <pfx> to the range of <pGrid> and select the four grid values surrounding it,
+// treating the ends of the grid in the same way as the original interpolation routines.
+//
+// @return index j such that the stencil is made up of the j-2, j-1, j and j+1 'th values
+//
+int LocateStencil( double *pGrid, int iNumPoints, double *pfx );
+
+// Locate the four-point interpolation stencil starting from a hint
+// @pGrid monotonically increasing grid values
+// @iNumPoints number of grid values
+// @pfx value to locate; clamped to the grid range on return
+// @piHint stencil index of the previous call on entry (negative if there is none) and the stencil index found on return
+//
+// As above, but hunting outwards from the previous stencil (see <HuntGrid>) rather than searching from the start of
+// the grid, so that a sweep through smoothly varying values costs O(1) per call. If <piHint> is NULL the grid is
+// searched from the start.
+//
+int LocateStencil( double *pGrid, int iNumPoints, double *pfx, int *piHint );
+
+// Calculate the Lagrange interpolation weights and their derivatives
+// @x stencil coordinates (zero-based)
+// @iNumPoints number of points in the stencil
+// @fx coordinate at which the interpolating polynomial is evaluated
+// @pw the weights multiplying each tabulated value
+// @pdw the weights giving the derivative of the interpolating polynomial with respect to x (may be NULL)
+//
+// The interpolated value is sum( pw[i] * y[i] ) and its derivative is sum( pdw[i] * y[i] ),
+// which is identical to the polynomial constructed by <FitPolynomial>.
+//
+void GetLagrangeWeights( double *x, int iNumPoints, double fx, double *pw, double *pdw );
+
+// Locate a value in a grid starting from a guess
+// @pGrid monotonically increasing grid values
+// @iNumPoints number of grid values
+// @fx value to locate
+// @iGuess index from which to start the search (e.g. the result of the previous call); ignored if out of range
+//
+// Hunt outwards from <iGuess> in steps of increasing size until <fx> is bracketed and then bisect, so that
+// locating a sequence of nearby values costs O(1) each while a poor guess costs no more than O(log iNumPoints).
+//
+// @return index j such that pGrid[j] <= fx < pGrid[j+1], limited to the range 0 to iNumPoints-2
+//
+int HuntGrid( double *pGrid, int iNumPoints, double fx, int iGuess );
+
+// Value stored in a log_10 table in place of the logarithm of zero (or of a negative value)
+#define LOG_TABLE_ZERO -300.0
+
+// Natural logarithm of 10, used to raise 10 to the power of an interpolated logarithm with a single exp
+#define LN_10 2.30258509299404568402
+
+// Select the interval of a grid containing a value from its four-point stencil
+// @pGrid monotonically increasing grid values
+// @iNumPoints number of grid values
+// @j stencil index of the value (see <LocateStencil>)
+// @fx value, clamped to the grid range
+// @pw the linear interpolation weight of the upper end of the interval
+//
+// @return index i such that pGrid[i] <= fx <= pGrid[i+1]
+//
+int GetLinearInterval( double *pGrid, int iNumPoints, int j, double fx, double *pw );
+
+// Locate the interval of a grid containing a value
+// @pGrid monotonically increasing grid values
+// @iNumPoints number of grid values
+// @pfx value to locate; clamped to the grid range on return
+// @pw the linear interpolation weight of the upper end of the interval
+//
+// Clamp <pfx> to the range of <pGrid> and bisect for the interval containing it (see <HuntGrid>), giving the same
+// interval as <LocateStencil> followed by <GetLinearInterval> without the linear search for the stencil.
+//
+// @return index i such that pGrid[i] <= fx <= pGrid[i+1]
+//
+int LocateLinearInterval( double *pGrid, int iNumPoints, double *pfx, double *pw );
+
+// Replace the values of a table by their logarithms
+// @pTable table values
+// @iNumValues number of values
+//
+// Values that are not positive are replaced by <LOG_TABLE_ZERO>.
+//
+void ConvertToLog10( double *pTable, int iNumValues );
+
+// Interpolate a log_10 table linearly
+// @pTable log_10 of the tabulated values
+// @i interval index (see <GetLinearInterval>)
+// @w linear interpolation weight of the upper end of the interval
+//
+// @return 10 to the power of the interpolated logarithm
+//
+double GetLog10TableValue( double *pTable, int i, double w );
+
+// Interpolate a 2D log_10 table bilinearly
+// @pTable log_10 of the tabulated values, the value at the j'th temperature and k'th density held at pTable[ k * iRowLength + j ]
+// @iRowLength number of temperature values
+// @i temperature interval index
+// @wT linear interpolation weight of the upper end of the temperature interval
+// @k density interval index
+// @wn linear interpolation weight of the upper end of the density interval
+//
+// @return 10 to the power of the interpolated logarithm
+//
+double GetLog10TableValue( double *pTable, int iRowLength, int i, double wT, int k, double wn );
+
+// Interpolate a table linearly
+// @pTable tabulated values
+// @i interval index (see <GetLinearInterval>)
+// @w linear interpolation weight of the upper end of the interval
+//
+// @return the interpolated value
+//
+double GetLinearTableValue( double *pTable, int i, double w );
+
+// Interpolate a 2D table bilinearly
+// @pTable tabulated values, the value at the j'th temperature and k'th density held at pTable[ k * iRowLength + j ]
+// @iRowLength number of temperature values
+// @i temperature interval index
+// @wT linear interpolation weight of the upper end of the temperature interval
+// @k density interval index
+// @wn linear interpolation weight of the upper end of the density interval
+//
+// @return the interpolated value
+//
+double GetLinearTableValue( double *pTable, int iRowLength, int i, double wT, int k, double wn );
+
+// Interpolation orders of the tables (see <GetInterpolationKernel>)
+#define INTERP_LINEAR 0
+#define INTERP_CUBIC 1
+#define INTERP_HERMITE 2
+
+// Read an interpolation order
+// @szOrder "linear", "cubic" or "hermite"
+//
+// @return the interpolation order, or <INTERP_CUBIC> (with a warning) if it is not recognised
+//
+int GetInterpolationOrder( const char *szOrder );
+
+// Interpolate linearly within a four-point stencil
+// @x stencil coordinates (zero-based)
+// @y tabulated values at the stencil coordinates
+// @fx coordinate at which to interpolate, within the stencil
+// @pdy the derivative of the interpolant with respect to x (may be NULL)
+//
+// Only the two values either side of <fx> are used.
+//
+// @return the interpolated value
+//
+double InterpolateLinear( double *x, double *y, double fx, double *pdy );
+
+// Interpolate with the cubic Lagrange polynomial through a four-point stencil
+// @x stencil coordinates (zero-based)
+// @y tabulated values at the stencil coordinates
+// @fx coordinate at which to interpolate, within the stencil
+// @pdy the derivative of the interpolant with respect to x (may be NULL)
+//
+// The polynomial is identical to that constructed by <FitPolynomial>.
+//
+// @return the interpolated value
+//
+double InterpolateCubic( double *x, double *y, double fx, double *pdy );
+
+// Interpolate with the monotone cubic Hermite polynomial within a four-point stencil
+// @x stencil coordinates (zero-based)
+// @y tabulated values at the stencil coordinates
+// @fx coordinate at which to interpolate, within the stencil
+// @pdy the derivative of the interpolant with respect to x (may be NULL)
+//
+// The slope at each interior point of the stencil is the weighted harmonic mean of the slopes of the
+// intervals either side (zero if they differ in sign, as Fritsch and Butland) and the slope at each end
+// point is that of the adjacent interval, so the interpolant does not overshoot the tabulated values
+// and is never negative if they are not.
+//
+// @return the interpolated value
+//
+double InterpolateHermite( double *x, double *y, double fx, double *pdy );
+
+// Interpolation kernel within a four-point stencil: <InterpolateLinear>, <InterpolateCubic> or <InterpolateHermite>
+typedef double (*INTERPKERNEL)( double *x, double *y, double fx, double *pdy );
+
+// Select the interpolation kernel of an order
+// @iOrder <INTERP_LINEAR>, <INTERP_CUBIC> or <INTERP_HERMITE>
+//
+// The kernel of each table is selected once, when the configuration is read, and called directly on every look-up.
+//
+// @return <InterpolateLinear>, <InterpolateCubic> or <InterpolateHermite>
+//
+INTERPKERNEL GetInterpolationKernel( int iOrder );
+
+// Interpolate a 2D table within a 4x4 stencil with a given kernel
+// @pKernel <InterpolateLinear>, <InterpolateCubic> or <InterpolateHermite> (see <GetInterpolationKernel>)
+// @pTable tabulated values, the value at the j'th temperature and k'th density held at pTable[ k * iRowLength + j ]
+// @iRowLength number of temperature values
+// @pTemp log_10 T values of the table
+// @j temperature stencil index (see <LocateStencil>)
+// @flog_10T log_10 T, clamped to the tabulated range
+// @pDen log_10 n values of the table
+// @k density stencil index
+// @flog_10n log_10 n, clamped to the tabulated range
+// @pdbydlog_10T the derivative with respect to log_10 T (may be NULL)
+// @pdbydlog_10n the derivative with respect to log_10 n (may be NULL)
+//
+// Each density set of the stencil is interpolated in temperature and the results are then interpolated in
+// density. Only the two density sets either side of <flog_10n> are used by <InterpolateLinear>. The temperature
+// derivatives of the density sets are combined in the same way, which is exact for the linear and cubic
+// orders but ignores the dependence of the monotone slopes in density on temperature.
+//
+// @return the interpolated value
+//
+double InterpolateStencil2D( INTERPKERNEL pKernel, double *pTable, int iRowLength, double *pTemp, int j, double flog_10T, double *pDen, int k, double flog_10n, double *pdbydlog_10T, double *pdbydlog_10n );
+
+// Cell evaluation context
+//
+// The quantities shared by every table look-up made for one cell at one temperature and density. All of the
+// elements are tabulated on the same temperature and density ranges, so the clamped coordinates, stencils and
+// interpolation weights are the same for every element and need only be calculated once (see <SetCellContext>).
+//
+typedef struct {
+    /* log_10 T and log_10 n as requested */
+    double flog_10T, flog_10n;
+    /* log_10 T and log_10 n clamped to the tabulated ranges */
+    double flog_10T_clamped, flog_10n_clamped;
+    /* Temperature and density stencils (the j-2 to j+1 'th and k-2 to k+1 'th values, see <LocateStencil>) */
+    int j, k;
+    /* Interpolation weights of the temperature and density stencils */
+    double wT[4], wn[4];
+    /* Temperature (K), or 0 if the context was set up from log_10 T alone */
+    double T;
+    /* Electron number density (cm^-3) */
+    double ne;
+    /* Number density limited to the maximum optically thin density (cm^-3) and its square */
+    double n, n2;
+    /* True if the density is at or above the maximum optically thin density */
+    bool bEquilibrium;
+} CELLCONTEXT;
+
+// Set up a cell evaluation context
+// @pTemp log_10 T values of the tables
+// @iNumTemp number of temperature values
+// @pDen log_10 n values of the tables
+// @iNumDen number of density values
+// @fMaxDensity log_10 of the maximum optically thin density
+// @flog_10T log_10 T of the cell
+// @flog_10n log_10 n of the cell
+// @pContext context to set up
+//
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, CELLCONTEXT *pContext );
+
+// Set up a cell evaluation context starting from the stencils it already holds
+// @bHint if True, hunt for the stencils from those of the previous cell held by <pContext> (see <LocateStencil>)
+//
+// As above. Re-use one context for each cell of a sweep through smoothly varying values.
+//
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, CELLCONTEXT *pContext, bool bHint );
+
+// Set up a cell evaluation context from the temperature and density in both log_10 and linear form
+// @T temperature of the cell (K), or 0 if not known
+// @n number density of the cell (cm^-3), or 0 if not known
+//
+// As above, taking the number density and its square from <n> rather than from 10^log_10 n, and holding
+// <T> for the functions that need the temperature itself.
+//
+void SetCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double flog_10T, double flog_10n, double T, double n, CELLCONTEXT *pContext, bool bHint );
+
+// Set up a cell evaluation context from the temperature (K) and density (cm^-3) in linear form
+//
+// As above, calculating log_10 T and log_10 n once for the cell.
+//
+void SetLinearCellContext( double *pTemp, int iNumTemp, double *pDen, int iNumDen, double fMaxDensity, double T, double n, CELLCONTEXT *pContext, bool bHint );
+
+#endif
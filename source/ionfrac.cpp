@@ -12,8 +12,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
+#include <math.h>
 
 #include "ionfrac.h"
+#include "ionfracgrid.h"
+#include "interp.h"
 #include "../../rsp_toolkit/source/file.h"
 #include "../../rsp_toolkit/source/fitpoly.h"
 #include "../../rsp_toolkit/source/xmlreader.h"
@@ -24,6 +28,36 @@ CIonFrac::CIonFrac( CIonFrac *pIonFrac, char *szFilename, PRADIATION pRadiationO
 Initialise( pIonFrac, szFilename, pRadiationObj );
 }
 
+CIonFrac::CIonFrac( CIonFracGrid *pIonFracGrid, int iCell, PRADIATION pRadiationObj )
+{
+int i;
+
+// Set the radiation object pointer
+pRadiation = pRadiationObj;
+
+// The ion population fractions belong to the grid
+bOwnsIonFrac = false;
+
+NumStages = 0;
+pppStageIonFrac = NULL;
+pppStagednibydt = NULL;
+
+NumElements = pIonFracGrid->NumElements;
+cutoff_ion_fraction = pIonFracGrid->GetCutoffIonFraction();
+
+// Allocate sufficient memory to hold the pointers to the ionisation fractions and their
+// rates of change with respect to time for each element
+ppIonFrac = (double**)malloc( sizeof(double*) * NumElements );
+ppdnibydt = (double**)malloc( sizeof(double*) * NumElements );
+
+pZ = (int*)malloc( sizeof(int) * NumElements );
+
+for( i=0; i<NumElements; i++ )
+    pZ[i] = pIonFracGrid->pZ[i];
+
+ViewGrid( pIonFracGrid, iCell );
+}
+
 CIonFrac::~CIonFrac( void )
 {
 FreeAll();
@@ -37,6 +71,12 @@ double **ppInitIonFrac, **ppInitdnibydt;
 // Set the radiation object pointer
 pRadiation = pRadiationObj;
 
+bOwnsIonFrac = true;
+
+NumStages = 0;
+pppStageIonFrac = NULL;
+pppStagednibydt = NULL;
+
 // If pIonFrac is NULL then initialise the ion fractional populations using the configuration file
 if( !pIonFrac )
 {
@@ -146,17 +186,31 @@ void CIonFrac::FreeAll( void )
 {
 int i;
 
-for( i=0; i<NumElements; i++ )
-{
-    free( ppIonFrac[i] );
-    free( ppdnibydt[i] );
-}
+FreeStages();
+
+if( bOwnsIonFrac )
+    for( i=0; i<NumElements; i++ )
+    {
+        free( ppIonFrac[i] );
+        free( ppdnibydt[i] );
+    }
 
 free( ppIonFrac );
 free( ppdnibydt );
 free( pZ );
 }
 
+void CIonFrac::ViewGrid( CIonFracGrid *pIonFracGrid, int iCell )
+{
+int i;
+
+for( i=0; i<NumElements; i++ )
+{
+    ppIonFrac[i] = pIonFracGrid->pGetIonFrac( iCell, pZ[i] );
+    ppdnibydt[i] = pIonFracGrid->pGetdnibydt( iCell, pZ[i] );
+}
+}
+
 double** CIonFrac::ppGetIonFrac( void )
 {
 return ppIonFrac;
@@ -280,6 +334,313 @@ for( i=0; i<NumElements; i++ )
 }
 }
 
+void CIonFrac::FreeStages( void )
+{
+int i, j;
+
+for( i=0; i<NumStages; i++ )
+{
+    for( j=0; j<NumElements; j++ )
+    {
+        free( pppStageIonFrac[i][j] );
+        free( pppStagednibydt[i][j] );
+    }
+
+    free( pppStageIonFrac[i] );
+    free( pppStagednibydt[i] );
+}
+
+free( pppStageIonFrac );
+free( pppStagednibydt );
+
+NumStages = 0;
+pppStageIonFrac = NULL;
+pppStagednibydt = NULL;
+}
+
+bool CIonFrac::AllocateStages( int iNumStages )
+{
+int i, j, iBytes;
+
+FreeStages();
+
+// The current values of a grid view belong to the grid and cannot be exchanged
+if( !bOwnsIonFrac )
+{
+    printf( "Stage slots cannot be allocated for a view of an ion population grid.\n" );
+    return false;
+}
+
+NumStages = iNumStages;
+
+pppStageIonFrac = (double***)malloc( sizeof(double**) * NumStages );
+pppStagednibydt = (double***)malloc( sizeof(double**) * NumStages );
+
+for( i=0; i<NumStages; i++ )
+{
+    pppStageIonFrac[i] = (double**)malloc( sizeof(double*) * NumElements );
+    pppStagednibydt[i] = (double**)malloc( sizeof(double*) * NumElements );
+
+    // Each element is allocated separately, as the current values are, so that the
+    // current and stage values can be exchanged
+    for( j=0; j<NumElements; j++ )
+    {
+        iBytes = sizeof(double) * ( pZ[j] + 1 );
+        pppStageIonFrac[i][j] = (double*)malloc( iBytes );
+        pppStagednibydt[i][j] = (double*)malloc( iBytes );
+
+        memcpy( pppStageIonFrac[i][j], ppIonFrac[j], iBytes );
+        memset( pppStagednibydt[i][j], 0, iBytes );
+    }
+}
+
+return true;
+}
+
+bool CIonFrac::IsStage( int iStage )
+{
+if( iStage < 0 || iStage >= NumStages )
+{
+    printf( "Stage slot %i has not been allocated.\n", iStage );
+    return false;
+}
+
+return true;
+}
+
+double** CIonFrac::ppGetStageIonFrac( int iStage )
+{
+if( !IsStage( iStage ) ) return NULL;
+
+return pppStageIonFrac[iStage];
+}
+
+double** CIonFrac::ppGetStagednibydt( int iStage )
+{
+if( !IsStage( iStage ) ) return NULL;
+
+return pppStagednibydt[iStage];
+}
+
+void CIonFrac::IntegrateAllIonFracToStage( int iStage, double **ppRate, double delta_t )
+{
+double *pStageni, fTotal;
+int i, j;
+
+if( !IsStage( iStage ) ) return;
+
+for( i=0; i<NumElements; i++ )
+{
+    pStageni = pppStageIonFrac[iStage][i];
+
+    fTotal = 0.0;
+
+    for( j=0; j<=pZ[i]; j++ )
+    {
+        pStageni[j] = ppIonFrac[i][j] + ppRate[i][j] * delta_t;
+
+        // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+        if( pStageni[j] < cutoff_ion_fraction )
+            pStageni[j] = 0.0;
+
+        fTotal += pStageni[j];
+    }
+
+    // Normalise the sum total of the ion fractional populations to 1
+    pRadiation->Normalise( pZ[i], pStageni, fTotal );
+}
+}
+
+void CIonFrac::AcceptStage( int iStage )
+{
+double *pTemp;
+int i;
+
+if( !IsStage( iStage ) ) return;
+
+for( i=0; i<NumElements; i++ )
+{
+    pTemp = ppIonFrac[i];
+    ppIonFrac[i] = pppStageIonFrac[iStage][i];
+    pppStageIonFrac[iStage][i] = pTemp;
+
+    pTemp = ppdnibydt[i];
+    ppdnibydt[i] = pppStagednibydt[iStage][i];
+    pppStagednibydt[iStage][i] = pTemp;
+}
+}
+
+void CIonFrac::RollbackStage( int iStage )
+{
+// Exchanging the pointers again restores the previous values
+AcceptStage( iStage );
+}
+
+bool CIonFrac::WriteBinaryFileHeader( void *pFile, int iNumCells, int iNumElements, int *pZ, int iCellStride, int iFlags )
+{
+IONFRACFILEHEADER Header;
+
+memset( &Header, 0, sizeof(IONFRACFILEHEADER) );
+strcpy( Header.szMagic, IONFRAC_FILE_MAGIC );
+Header.iByteOrder = IONFRAC_FILE_BYTE_ORDER;
+Header.iVersion = IONFRAC_FILE_VERSION;
+Header.iNumCells = iNumCells;
+Header.iNumElements = iNumElements;
+Header.iCellStride = iCellStride;
+Header.iFlags = iFlags;
+
+if( fwrite( &Header, sizeof(IONFRACFILEHEADER), 1, (FILE*)pFile ) != 1 ) return false;
+if( fwrite( pZ, sizeof(int), iNumElements, (FILE*)pFile ) != (size_t)iNumElements ) return false;
+
+return true;
+}
+
+bool CIonFrac::ReadBinaryFileHeader( void *pFile, IONFRACFILEHEADER *pHeader, int iNumCells, int iNumElements, int *pZ )
+{
+int i, iZ, iTotalNumIons = 0;
+
+if( fread( pHeader, sizeof(IONFRACFILEHEADER), 1, (FILE*)pFile ) != 1 || strncmp( pHeader->szMagic, IONFRAC_FILE_MAGIC, 8 ) )
+{
+    printf( "Not a binary ion population file.\n" );
+    return false;
+}
+
+if( pHeader->iByteOrder != IONFRAC_FILE_BYTE_ORDER )
+{
+    printf( "Binary ion population file was written with a different byte order.\n" );
+    return false;
+}
+
+if( pHeader->iVersion > IONFRAC_FILE_VERSION )
+{
+    printf( "Binary ion population file version %i is not supported.\n", pHeader->iVersion );
+    return false;
+}
+
+if( pHeader->iNumCells != iNumCells || pHeader->iNumElements != iNumElements )
+{
+    printf( "Binary ion population file holds %i cells and %i elements; expected %i cells and %i elements.\n", pHeader->iNumCells, pHeader->iNumElements, iNumCells, iNumElements );
+    return false;
+}
+
+// Check the elements are the same and in the same order
+for( i=0; i<iNumElements; i++ )
+{
+    if( fread( &iZ, sizeof(int), 1, (FILE*)pFile ) != 1 || iZ != pZ[i] )
+    {
+        printf( "Binary ion population file holds different elements.\n" );
+        return false;
+    }
+
+    iTotalNumIons += iZ + 1;
+}
+
+if( pHeader->iCellStride < iTotalNumIons )
+{
+    printf( "Binary ion population file is corrupt.\n" );
+    return false;
+}
+
+return true;
+}
+
+bool CIonFrac::WriteGridToBinaryFile( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj, bool bWritednibydt )
+{
+FILE *pFile;
+double *pBuffer, *pValue;
+int c, i, j, k, iNumBlocks, iTotalNumIons = 0;
+bool bSuccess;
+
+for( i=0; i<ppIonFracObj[0]->NumElements; i++ )
+    iTotalNumIons += ppIonFracObj[0]->pZ[i] + 1;
+
+iNumBlocks = bWritednibydt ? 2 : 1;
+
+// Gather the ion population fractions (and the rates of change) of every cell
+pBuffer = (double*)malloc( sizeof(double) * iNumBlocks * iNumCells * iTotalNumIons );
+
+pValue = pBuffer;
+for( k=0; k<iNumBlocks; k++ )
+    for( c=0; c<iNumCells; c++ )
+        for( i=0; i<ppIonFracObj[c]->NumElements; i++ )
+            for( j=0; j<=ppIonFracObj[c]->pZ[i]; j++ )
+                *(pValue++) = k ? ppIonFracObj[c]->ppdnibydt[i][j] : ppIonFracObj[c]->ppIonFrac[i][j];
+
+pFile = fopen( szFilename, "wb" );
+if( !pFile )
+{
+    printf( "Failed to open binary ion population file %s.\n", szFilename );
+    free( pBuffer );
+    return false;
+}
+
+bSuccess = WriteBinaryFileHeader( pFile, iNumCells, ppIonFracObj[0]->NumElements, ppIonFracObj[0]->pZ, iTotalNumIons, bWritednibydt ? IONFRAC_FILE_DNIBYDT : 0 );
+bSuccess = bSuccess && fwrite( pBuffer, sizeof(double) * iTotalNumIons, iNumBlocks * iNumCells, pFile ) == (size_t)( iNumBlocks * iNumCells );
+
+if( fclose( pFile ) ) bSuccess = false;
+free( pBuffer );
+
+if( !bSuccess ) printf( "Failed to write binary ion population file %s.\n", szFilename );
+
+return bSuccess;
+}
+
+bool CIonFrac::ReadGridFromBinaryFile( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj )
+{
+FILE *pFile;
+IONFRACFILEHEADER Header;
+double *pBuffer, *pValue;
+int c, i, j, k, iNumBlocks;
+
+pFile = fopen( szFilename, "rb" );
+if( !pFile )
+{
+    printf( "Failed to open binary ion population file %s.\n", szFilename );
+    return false;
+}
+
+if( !ReadBinaryFileHeader( pFile, &Header, iNumCells, ppIonFracObj[0]->NumElements, ppIonFracObj[0]->pZ ) )
+{
+    fclose( pFile );
+    return false;
+}
+
+iNumBlocks = ( Header.iFlags & IONFRAC_FILE_DNIBYDT ) ? 2 : 1;
+
+// Read every value with a single call
+pBuffer = (double*)malloc( sizeof(double) * iNumBlocks * iNumCells * Header.iCellStride );
+
+if( fread( pBuffer, sizeof(double) * Header.iCellStride, iNumBlocks * iNumCells, pFile ) != (size_t)( iNumBlocks * iNumCells ) )
+{
+    printf( "Failed to read binary ion population file %s.\n", szFilename );
+    fclose( pFile );
+    free( pBuffer );
+    return false;
+}
+
+fclose( pFile );
+
+// Scatter the ion population fractions (and the rates of change) to the cells
+for( k=0; k<iNumBlocks; k++ )
+    for( c=0; c<iNumCells; c++ )
+    {
+        pValue = pBuffer + ( (size_t)k * iNumCells + c ) * Header.iCellStride;
+
+        for( i=0; i<ppIonFracObj[c]->NumElements; i++ )
+            for( j=0; j<=ppIonFracObj[c]->pZ[i]; j++ )
+            {
+                if( k )
+                    ppIonFracObj[c]->ppdnibydt[i][j] = *(pValue++);
+                else
+                    ppIonFracObj[c]->ppIonFrac[i][j] = *(pValue++);
+            }
+    }
+
+free( pBuffer );
+
+return true;
+}
+
 void CIonFrac::IntegrateIonFrac( int iZ, double delta_t )
 {
 double fTotal = 0.0;
@@ -306,6 +667,205 @@ for( j=0; j<=pZ[i]; j++ )
 pRadiation->Normalise( pZ[i], ppIonFrac[i], fTotal );
 }
 
+void CIonFrac::IntegrateAdaptive( int i, double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats )
+{
+double *pY0, *pYjm1, *pYjm2, *pYj, *pF0, *pFjm1, *pFNew, *pSwap;
+double *pJacLower, *pJacDiag, *pJacUpper, *pdnibydtbydT, *pdnibydtbydn;
+double T[RKC_MAX_STAGES+1], dT[RKC_MAX_STAGES+1], d2T[RKC_MAX_STAGES+1], b[RKC_MAX_STAGES+1];
+double t = 0.0, h, fMinStep, fSpectralRadius, fError, fScale, fTotal, TimeScale;
+double w0, w1, mu, nu, mu_tilde, gamma_tilde;
+int j, k, iNumIons, iStages;
+bool bClipped;
+
+iNumIons = pZ[i] + 1;
+
+pY0 = ppIonFrac[i];
+pF0 = ppdnibydt[i];
+pYjm1 = (double*)alloca( sizeof(double) * iNumIons );
+pYjm2 = (double*)alloca( sizeof(double) * iNumIons );
+pYj = (double*)alloca( sizeof(double) * iNumIons );
+pFjm1 = (double*)alloca( sizeof(double) * iNumIons );
+pFNew = (double*)alloca( sizeof(double) * iNumIons );
+pJacLower = (double*)alloca( sizeof(double) * iNumIons );
+pJacDiag = (double*)alloca( sizeof(double) * iNumIons );
+pJacUpper = (double*)alloca( sizeof(double) * iNumIons );
+pdnibydtbydT = (double*)alloca( sizeof(double) * iNumIons );
+pdnibydtbydn = (double*)alloca( sizeof(double) * iNumIons );
+
+// The equations are linear in the ion populations at fixed temperature and density, so the
+// Jacobian is constant over the interval and bounds the spectral radius (Gershgorin)
+pRadiation->GetdnibydtJacobian( pZ[i], flog_10T, flog_10n, pY0, pFNew, pJacLower, pJacDiag, pJacUpper, pdnibydtbydT, pdnibydtbydn );
+
+fSpectralRadius = 0.0;
+for( j=0; j<iNumIons; j++ )
+    fSpectralRadius = fmax( fSpectralRadius, fabs( pJacLower[j] ) + fabs( pJacDiag[j] ) + fabs( pJacUpper[j] ) );
+fSpectralRadius *= 1.2;
+
+// Use the characteristic time-scale of the rates of change as the first step
+pRadiation->Getdnibydt( pZ[i], flog_10T, flog_10n, pY0, pF0, &TimeScale );
+if( pStats ) pStats->iEvaluations++;
+
+h = fmin( delta_t, TimeScale );
+fMinStep = 1E-10 * delta_t;
+
+while( t < delta_t )
+{
+    // Do not step beyond the end of the interval
+    if( h > delta_t - t )
+        h = delta_t - t;
+
+    // Choose the number of stages so that the step lies within the stability region,
+    // which extends to approximately 0.653 * s^2 along the negative real axis
+    iStages = 1 + (int)sqrt( 1.0 + 1.54 * h * fSpectralRadius );
+    if( iStages < 2 ) iStages = 2;
+    if( iStages > RKC_MAX_STAGES )
+    {
+        iStages = RKC_MAX_STAGES;
+        h = ( (double)( iStages * iStages ) - 1.0 ) / ( 1.54 * fSpectralRadius );
+    }
+
+    // Calculate the Chebyshev polynomials T_j( w0 ) and their first and second derivatives
+    w0 = 1.0 + RKC_DAMPING / (double)( iStages * iStages );
+    T[0] = 1.0; dT[0] = 0.0; d2T[0] = 0.0;
+    T[1] = w0; dT[1] = 1.0; d2T[1] = 0.0;
+    for( k=2; k<=iStages; k++ )
+    {
+        T[k] = 2.0 * w0 * T[k-1] - T[k-2];
+        dT[k] = 2.0 * T[k-1] + 2.0 * w0 * dT[k-1] - dT[k-2];
+        d2T[k] = 4.0 * dT[k-1] + 2.0 * w0 * d2T[k-1] - d2T[k-2];
+    }
+    w1 = dT[iStages] / d2T[iStages];
+    for( k=2; k<=iStages; k++ )
+        b[k] = d2T[k] / ( dT[k] * dT[k] );
+    b[0] = b[1] = b[2];
+
+    // First stage
+    for( j=0; j<iNumIons; j++ )
+    {
+        pYjm2[j] = pY0[j];
+        pYjm1[j] = pY0[j] + b[1] * w1 * h * pF0[j];
+    }
+
+    // Remaining stages of the Runge-Kutta-Chebyshev method
+    for( k=2; k<=iStages; k++ )
+    {
+        for( j=0; j<iNumIons; j++ )
+            pYj[j] = pYjm1[j];
+        pRadiation->Getdnibydt( pZ[i], flog_10T, flog_10n, pYj, pFjm1, &TimeScale );
+
+        mu = 2.0 * w0 * b[k] / b[k-1];
+        nu = - b[k] / b[k-2];
+        mu_tilde = 2.0 * w1 * b[k] / b[k-1];
+        gamma_tilde = - ( 1.0 - b[k-1] * T[k-1] ) * mu_tilde;
+
+        for( j=0; j<iNumIons; j++ )
+            pYj[j] = ( 1.0 - mu - nu ) * pY0[j] + mu * pYjm1[j] + nu * pYjm2[j] + h * ( mu_tilde * pFjm1[j] + gamma_tilde * pF0[j] );
+
+        pSwap = pYjm2;
+        pYjm2 = pYjm1;
+        pYjm1 = pYj;
+        pYj = pSwap;
+    }
+
+    // The solution at the end of the step is held in pYjm1; calculate its rate of change
+    for( j=0; j<iNumIons; j++ )
+        pYj[j] = pYjm1[j];
+    pRadiation->Getdnibydt( pZ[i], flog_10T, flog_10n, pYj, pFNew, &TimeScale );
+
+    if( pStats ) pStats->iEvaluations += iStages;
+
+    // Estimate the local error
+    fError = 0.0;
+    for( j=0; j<iNumIons; j++ )
+        fError = fmax( fError, fabs( 12.0 * ( pY0[j] - pYjm1[j] ) + 6.0 * h * ( pF0[j] + pFNew[j] ) ) / 15.0 );
+    fError /= fTolerance;
+
+    // Choose the next step size from the error estimate, limiting the change to a factor of ten
+    if( fError > 0.0 )
+        fScale = fmin( 10.0, fmax( 0.1, 0.8 * pow( fError, -1.0 / 3.0 ) ) );
+    else
+        fScale = 10.0;
+
+    if( fError > 1.0 && h > fMinStep )
+    {
+        if( pStats ) pStats->iRejectedSteps++;
+        h = fmax( h * fScale, fMinStep );
+        continue;
+    }
+
+    // Accept the step
+    t += h;
+    if( pStats ) pStats->iAcceptedSteps++;
+
+    fTotal = 0.0;
+    bClipped = false;
+    for( j=0; j<iNumIons; j++ )
+    {
+        pY0[j] = pYjm1[j];
+
+        // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+        if( pY0[j] < cutoff_ion_fraction )
+        {
+            if( pY0[j] != 0.0 ) bClipped = true;
+            pY0[j] = 0.0;
+        }
+
+        fTotal += pY0[j];
+    }
+
+    // Normalise the sum total of the ion fractional populations to 1
+    pRadiation->Normalise( pZ[i], pY0, fTotal );
+
+    h *= fScale;
+
+    // The rate of change at the start of the next step is the one at the end of this step, unless
+    // the cut-off has changed the ion populations
+    if( bClipped && t < delta_t )
+    {
+        pRadiation->Getdnibydt( pZ[i], flog_10T, flog_10n, pY0, pF0, &TimeScale );
+        if( pStats ) pStats->iEvaluations++;
+    }
+    else
+        for( j=0; j<iNumIons; j++ )
+            pF0[j] = pFNew[j];
+}
+}
+
+void CIonFrac::IntegrateAllIonFracAdaptive( double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats )
+{
+int i;
+
+// A tolerance that is not positive cannot be met
+if( !( fTolerance > 0.0 ) )
+{
+    printf( "The tolerance of the adaptive integration must be positive.\n" );
+    return;
+}
+
+for( i=0; i<NumElements; i++ )
+    IntegrateAdaptive( i, flog_10T, flog_10n, delta_t, fTolerance, pStats );
+}
+
+void CIonFrac::IntegrateIonFracAdaptive( int iZ, double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats )
+{
+int i;
+
+// A tolerance that is not positive cannot be met
+if( !( fTolerance > 0.0 ) )
+{
+    printf( "The tolerance of the adaptive integration must be positive.\n" );
+    return;
+}
+
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
+
+if( i == NumElements ) return;
+
+IntegrateAdaptive( i, flog_10T, flog_10n, delta_t, fTolerance, pStats );
+}
+
 int* CIonFrac::pGetElementInfo( int *pNumElements )
 {
 *pNumElements = NumElements;
@@ -313,6 +873,11 @@ int* CIonFrac::pGetElementInfo( int *pNumElements )
 return pZ;
 }
 
+double CIonFrac::GetCutoffIonFraction( void )
+{
+return cutoff_ion_fraction;
+}
+
 void CIonFrac::CopyAllIonFrac( CIonFrac *pIonFrac )
 {
 double **ppNewIonFrac;
@@ -374,7 +939,10 @@ for( j=0; j<=pZ[i]; j++ )
 void CIonFrac::InterpolateAllIonFrac( double *x, double ***pppIonFrac, int iPoints, double s )
 {
 double y[5], error;
-int i, j, n;
+int i, j, n, iNumPoints;
+
+// At most four points are used; three points give a quadratic
+iNumPoints = iPoints < 4 ? iPoints : 4;
 
 if( iPoints < 3 )
 {
@@ -395,15 +963,67 @@ else
     {
         for( j=0; j<=pZ[i]; j++ )
 	{
-            for( n=1; n<=iPoints; n++ )
+            for( n=1; n<=iNumPoints; n++ )
                 y[n] = pppIonFrac[n][i][j];
 
-            FitPolynomial4( x, y, s, &(ppIonFrac[i][j]), &error );
+            FitPolynomial( x, y, iNumPoints, s, &(ppIonFrac[i][j]), &error );
 	}
     }
 }
 }
 
+void CIonFrac::RemapGridIonFrac( int iNumOldCells, double *pOldx, CIonFrac **ppOldIonFrac, int iNumNewCells, double *pNewx, CIonFrac **ppNewIonFrac, int iPoints )
+{
+double w[4], *pni[4], *pNewni;
+int c, i, j, k, l, m, iNumPoints, iHint = -1;
+
+if( iPoints >= 3 && iNumOldCells >= 4 )
+    iNumPoints = 4;
+else
+    iNumPoints = 2;
+
+#ifdef OPENMP
+#pragma omp parallel for private( w, pni, pNewni, i, j, k, l, m ) firstprivate( iHint )
+#endif // OPENMP
+for( c=0; c<iNumNewCells; c++ )
+{
+    // Find the old cells either side of the new one
+    j = iHint = HuntGrid( pOldx, iNumOldCells, pNewx[c], iHint );
+
+    // Calculate the interpolation weights once for all of the ions
+    if( iNumPoints == 4 )
+    {
+        // Use the two old cells either side of the new one where possible
+        m = j - 1;
+        if( m < 0 ) m = 0;
+        else if( m > iNumOldCells-4 ) m = iNumOldCells-4;
+
+        GetLagrangeWeights( pOldx + m, 4, pNewx[c], w, NULL );
+    }
+    else
+    {
+        m = j;
+        w[0] = ( pOldx[m+1] - pNewx[c] ) / ( pOldx[m+1] - pOldx[m] );
+        w[1] = 1.0 - w[0];
+    }
+
+    for( i=0; i<ppNewIonFrac[c]->NumElements; i++ )
+    {
+        for( l=0; l<iNumPoints; l++ )
+            pni[l] = ppOldIonFrac[m+l]->ppIonFrac[i];
+
+        pNewni = ppNewIonFrac[c]->ppIonFrac[i];
+
+        for( k=0; k<=ppNewIonFrac[c]->pZ[i]; k++ )
+        {
+            pNewni[k] = w[0] * pni[0][k];
+            for( l=1; l<iNumPoints; l++ )
+                pNewni[k] += w[l] * pni[l][k];
+        }
+    }
+}
+}
+
 void CIonFrac::InterpolateIonFrac( int iZ, double *x, double ***pppIonFrac, int iPoints, double s )
 {
 double y[5], error;
@@ -467,22 +1087,34 @@ pRadiation->GetEquilIonFrac( iZ, ppIonFrac[i], flog_10T, flog_10n );
 
 void CIonFrac::ResetAllIonFrac( double flog_10T )
 {
-int i;
+// Get the equilibrium ionisation fractions
+pRadiation->GetAllEquilIonFrac( flog_10T, ppIonFrac );
+}
 
-for( i=0; i<NumElements; i++ )
+void CIonFrac::ResetAllIonFrac( double flog_10T, double flog_10n )
 {
-    // Get the equilibrium ionisation fractions
-    pRadiation->GetEquilIonFrac( pZ[i], ppIonFrac[i], flog_10T );
+// Get the equilibrium ionisation fractions
+pRadiation->GetAllEquilIonFrac( flog_10T, flog_10n, ppIonFrac );
 }
+
+void CIonFrac::ResetAllIonFrac( CELLCONTEXT *pContext )
+{
+// Get the equilibrium ionisation fractions
+pRadiation->GetAllEquilIonFrac( pContext, ppIonFrac );
 }
 
-void CIonFrac::ResetAllIonFrac( double flog_10T, double flog_10n )
+void CIonFrac::ResetGridIonFrac( int iNumCells, CIonFrac **ppIonFracObj, double *pflog_10T, double *pflog_10n )
 {
-int i;
+int c;
 
-for( i=0; i<NumElements; i++ )
+#ifdef OPENMP
+#pragma omp parallel for
+#endif // OPENMP
+for( c=0; c<iNumCells; c++ )
 {
-    // Get the equilibrium ionisation fractions
-    pRadiation->GetEquilIonFrac( pZ[i], ppIonFrac[i], flog_10T, flog_10n );
+    if( pflog_10n )
+        ppIonFracObj[c]->ResetAllIonFrac( pflog_10T[c], pflog_10n[c] );
+    else
+        ppIonFracObj[c]->ResetAllIonFrac( pflog_10T[c] );
 }
 }
\ No newline at end of file
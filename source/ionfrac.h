@@ -1,6 +1,63 @@
+#ifndef IONFRAC_H
+#define IONFRAC_H
 
 #include "radiation.h"
 
+// Maximum number of stages and damping parameter of the Runge-Kutta-Chebyshev integrator
+#define RKC_MAX_STAGES 64
+#define RKC_DAMPING ( 2.0 / 13.0 )
+
+// Adaptive ion population integrator statistics
+//
+// Holds the number of accepted and rejected steps and the number of evaluations of
+// the rates of change made by <CIonFrac::IntegrateAllIonFracAdaptive>. The counts are
+// accumulated, so the structure should be zeroed by the caller.
+//
+typedef struct {
+    /* Number of accepted steps */
+    int iAcceptedSteps;
+    /* Number of rejected steps */
+    int iRejectedSteps;
+    /* Number of evaluations of the rates of change */
+    int iEvaluations;
+} IONFRACSTATS;
+
+// Binary ion population file identification, version and byte order marker
+#define IONFRAC_FILE_MAGIC "IONFRAC"
+#define IONFRAC_FILE_VERSION 1
+#define IONFRAC_FILE_BYTE_ORDER 0x01020304
+
+// Binary ion population file flags
+#define IONFRAC_FILE_DNIBYDT 1
+
+// Binary ion population file header
+//
+// A binary ion population (checkpoint) file consists of this header, followed by the
+// atomic numbers of the <iNumElements> elements (int), the ion population fractions of
+// every cell and then, if the <IONFRAC_FILE_DNIBYDT> flag is set, their rates of change
+// (double). The ions of cell c begin at c * <iCellStride> and the ions of each element
+// follow those of the previous element, in the order of the atomic numbers. Values are
+// written in the byte order of the machine that wrote the file.
+//
+typedef struct {
+    /* File identifier, <IONFRAC_FILE_MAGIC> */
+    char szMagic[8];
+    /* <IONFRAC_FILE_BYTE_ORDER> as written */
+    int iByteOrder;
+    /* File format version */
+    int iVersion;
+    /* Number of cells */
+    int iNumCells;
+    /* Number of elements */
+    int iNumElements;
+    /* Number of values between the start of consecutive cells */
+    int iCellStride;
+    /* Combination of IONFRAC_FILE flags */
+    int iFlags;
+} IONFRACFILEHEADER;
+
+class CIonFracGrid;
+
 // Ionization fraction class
 //
 // Class for handling ionization fraction information. Methods include writing, reading,
@@ -15,6 +72,9 @@ class CIonFrac {
   	/* Pointer to a radiation object*/
     PRADIATION pRadiation;
 
+    /*- True if the ion population fractions are owned by the object, false if it views a <CIonFracGrid> */
+    bool bOwnsIonFrac;
+
   	/*- Threshold below which ion populations are set to zero. Set in radation configuration file.*/
   	double cutoff_ion_fraction;
 
@@ -25,12 +85,30 @@ class CIonFrac {
   	/*- Pointer to an array of pointers containing the rate of change with respect to time of the fractional population of the ions for each element at the current temperature */
     double **ppdnibydt;
 
+    /*- Number of preallocated stage slots */
+    int NumStages;
+
+    /*- Fractional populations of the ions of each element held in each stage slot, indexed [stage][element] */
+    double ***pppStageIonFrac;
+
+    /*- Rates of change of the fractional populations of the ions of each element held in each stage slot, indexed [stage][element] */
+    double ***pppStagednibydt;
+
+    /*- Free the stage slots */
+    void FreeStages( void );
+
+    /*- Check that a stage slot has been allocated, printing an error if not */
+    bool IsStage( int iStage );
+
     /*- Initialize object */
     void Initialise( CIonFrac *pIonFrac, char *szFilename, PRADIATION pRadiationObj );
 
     /*- Free all memory allocated by object */
     void FreeAll( void );
 
+    /*- Integrate the ion population fractions of the i'th element with error control */
+    void IntegrateAdaptive( int i, double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats );
+
   public:
 
   	// Default constructor
@@ -41,12 +119,32 @@ class CIonFrac {
   	//
     CIonFrac( CIonFrac *pIonFrac, char *szFilename, PRADIATION pRadiationObj );
 
+    // Grid view constructor
+    // @pIonFracGrid instance of <CIonFracGrid> class
+    // @iCell index of the cell to view
+    // @pRadiationObj instance of <PRADIATION>
+    //
+    // The object holds no ion population fractions of its own: every operation
+    // reads and writes the ion population fractions and rates of change of
+    // cell <iCell> of <pIonFracGrid>.
+    //
+    CIonFrac( CIonFracGrid *pIonFracGrid, int iCell, PRADIATION pRadiationObj );
+
     /* Destructor */
     ~CIonFrac( void );
 
     /* Number of elements for which ion population fractions are available */
     int NumElements;
 
+    // Point a grid view at a cell
+    // @pIonFracGrid instance of <CIonFracGrid> class holding the same elements
+    // @iCell index of the cell to view
+    //
+    // Only valid for objects created with the grid view constructor. Used to
+    // move the view to another cell, or to follow <CIonFracGrid::Swap>.
+    //
+    void ViewGrid( CIonFracGrid *pIonFracGrid, int iCell );
+
 	  /* Pointer to an array containing each element's atomic number.*/
     int *pZ;
 
@@ -144,6 +242,147 @@ class CIonFrac {
   	//
     void IntegrateIonFrac( int iZ, double delta_t );
 
+  	// Integrate ion population fractions for all elements with error control
+  	// @flog_10T log base 10 of temperature (in K)
+  	// @flog_10n log base 10 of density (in cm^-3)
+  	// @delta_t time interval to integrate over
+  	// @fTolerance target local error per step in any ion population fraction
+  	// @pStats accumulated step statistics (may be NULL)
+  	//
+  	// Integrate the time-dependent ionisation equations at fixed temperature and
+  	// density over <delta_t> using the second-order Runge-Kutta-Chebyshev method,
+  	// whose number of stages grows with the stiffness of the rates so that mildly
+  	// stiff (near-equilibrium) populations can take long explicit steps. Each element
+  	// takes its own steps, adapted so that the estimated local error stays below
+  	// <fTolerance>. After each accepted step the ion population fractions below the
+  	// cut-off are set to zero and the sum is normalised to one. The rates of change
+  	// at the end of the interval are left in ppdnibydt. If <fTolerance> is not positive
+  	// an error is printed and the populations are left unchanged.
+  	//
+    void IntegrateAllIonFracAdaptive( double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats );
+
+  	// Integrate ion population fractions for element <iZ> with error control
+  	// @iZ atomic number of element
+  	// @flog_10T log base 10 of temperature (in K)
+  	// @flog_10n log base 10 of density (in cm^-3)
+  	// @delta_t time interval to integrate over
+  	// @fTolerance target local error per step in any ion population fraction
+  	// @pStats accumulated step statistics (may be NULL)
+  	//
+  	// As <IntegrateAllIonFracAdaptive> for element <iZ> only.
+  	//
+    void IntegrateIonFracAdaptive( int iZ, double flog_10T, double flog_10n, double delta_t, double fTolerance, IONFRACSTATS *pStats );
+
+    // Allocate stage slots for multi-stage time integration
+    // @iNumStages number of stage slots
+    //
+    // Preallocate <iNumStages> slots, each holding a set of ion population
+    // fractions and rates of change for all elements, so that the intermediate
+    // states of a multi-stage (e.g. predictor-corrector) scheme do not need to
+    // be held in new <CIonFrac> objects. Any existing slots are freed. Stage
+    // slots are not available to objects viewing a <CIonFracGrid>: for these an
+    // error is printed and no slots are allocated.
+    //
+    // @return true if the stage slots were allocated
+    //
+    bool AllocateStages( int iNumStages );
+
+    // Return the ion population fractions held in a stage slot
+    // @iStage index of stage slot
+    //
+    // @return pointer to array of pointers of ion population fractions, as <ppGetIonFrac>
+    // (NULL, with an error printed, if the stage slot has not been allocated)
+    //
+    double** ppGetStageIonFrac( int iStage );
+
+    // Return the ion population fraction rates of change held in a stage slot
+    // @iStage index of stage slot
+    //
+    // @return pointer to array of pointers of rates of change, as <ppGetdnibydt>
+    // (NULL, with an error printed, if the stage slot has not been allocated)
+    //
+    double** ppGetStagednibydt( int iStage );
+
+    // Integrate ion fraction rates of change for all elements into a stage slot
+    // @iStage index of stage slot to hold the result
+    // @ppRate rates of change to integrate (e.g. <ppGetdnibydt> or <ppGetStagednibydt>)
+    // @delta_t time step
+    //
+    // Set the ion population fractions of stage <iStage> to the current ion
+    // population fractions advanced by <ppRate> over <delta_t>, with the cut-off
+    // and normalisation of <IntegrateAllIonFrac>. The current ion population
+    // fractions are not changed, so a rejected step needs no rollback.
+    //
+    void IntegrateAllIonFracToStage( int iStage, double **ppRate, double delta_t );
+
+    // Accept a stage
+    // @iStage index of stage slot
+    //
+    // Make the ion population fractions and rates of change of stage <iStage>
+    // the current ones by exchanging pointers, without copying. The previous
+    // current values are left in stage <iStage> until it is next written.
+    //
+    void AcceptStage( int iStage );
+
+    // Roll back an accepted stage
+    // @iStage index of stage slot passed to <AcceptStage>
+    //
+    // Restore the ion population fractions and rates of change that were current
+    // before <AcceptStage>( <iStage> ) by exchanging pointers again.
+    //
+    void RollbackStage( int iStage );
+
+    // Write the header of a binary ion population file
+    // @pFile file stream object opened for binary writing
+    // @iNumCells number of cells
+    // @iNumElements number of elements
+    // @pZ atomic numbers of the elements
+    // @iCellStride number of values between the start of consecutive cells
+    // @iFlags combination of IONFRAC_FILE flags
+    //
+    // @return True if the header was written
+    //
+    static bool WriteBinaryFileHeader( void *pFile, int iNumCells, int iNumElements, int *pZ, int iCellStride, int iFlags );
+
+    // Read and check the header of a binary ion population file
+    // @pFile file stream object opened for binary reading
+    // @pHeader header read from the file
+    // @iNumCells expected number of cells
+    // @iNumElements expected number of elements
+    // @pZ expected atomic numbers of the elements
+    //
+    // @return True if the header is valid and the file holds the expected cells and elements
+    //
+    static bool ReadBinaryFileHeader( void *pFile, IONFRACFILEHEADER *pHeader, int iNumCells, int iNumElements, int *pZ );
+
+    // Write the ion population fractions of a set of cells to a binary file
+    // @szFilename binary ion population filename
+    // @iNumCells number of cells
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    // @bWritednibydt if True, also write the rates of change
+    //
+    // Write the ion population fractions of all elements in every cell to a
+    // binary file (see <IONFRACFILEHEADER>), gathering them into a single
+    // buffer so that the values are written exactly with one call.
+    //
+    // @return True if the file was written
+    //
+    static bool WriteGridToBinaryFile( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj, bool bWritednibydt );
+
+    // Read the ion population fractions of a set of cells from a binary file
+    // @szFilename binary ion population filename
+    // @iNumCells number of cells
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    //
+    // Read the ion population fractions (and the rates of change, if the file
+    // holds them) written by <WriteGridToBinaryFile> or
+    // <CIonFracGrid::WriteBinaryFile> with one call and without parsing. The
+    // file must hold the same number of cells and the same elements.
+    //
+    // @return True if the file was read
+    //
+    static bool ReadGridFromBinaryFile( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj );
+
   	// Return pointer to array of atomic numbers <pZ>
   	// @pNumElements pointer to number of elements
   	//
@@ -155,6 +394,15 @@ class CIonFrac {
   	//
     int* pGetElementInfo( int *pNumElements );
 
+  	// Return the ion population fraction cut-off
+  	//
+  	// Function to return the threshold below which ion population
+  	// fractions are set to zero.
+  	//
+  	// @return cut-off ion population fraction
+  	//
+    double GetCutoffIonFraction( void );
+
   	// Overwrite ion population fractions for all elements
     // @pIonFrac pointer to instance of <CIonFrac> class
   	//
@@ -201,10 +449,30 @@ class CIonFrac {
   	//
   	// Interpolate the ion population fractions over <s> for all
   	// elements using a given number of points <iPoints> from the
-  	// coordinates <x>.
+  	// coordinates <x>. At most four points are used; three points
+  	// give a quadratic.
   	//
     void InterpolateAllIonFrac( double *x, double ***pppIonFrac, int iPoints, double s );
 
+    // Remap ion population fractions for all elements from one grid to another
+    // @iNumOldCells number of cells in the old grid
+    // @pOldx monotonically increasing coordinates of the old cells (at least two)
+    // @ppOldIonFrac pointer to array of <CIonFrac> objects of the old cells
+    // @iNumNewCells number of cells in the new grid
+    // @pNewx coordinates of the new cells
+    // @ppNewIonFrac pointer to array of <CIonFrac> objects of the new cells
+    // @iPoints number of points to perform interpolation over
+    //
+    // Interpolate the ion population fractions of all elements onto every new
+    // cell, as <InterpolateAllIonFrac> with linear (<iPoints> < 3) or cubic
+    // interpolation over the old cells surrounding each new one. The old cells
+    // are located by hunting from the previous new cell, so the new coordinates
+    // should also be increasing, and the interpolation weights are calculated
+    // once per new cell and applied to every ion. The new cells are shared
+    // between threads when compiled with OPENMP.
+    //
+    static void RemapGridIonFrac( int iNumOldCells, double *pOldx, CIonFrac **ppOldIonFrac, int iNumNewCells, double *pNewx, CIonFrac **ppNewIonFrac, int iPoints );
+
   	// Interpolate ion population fractions for element <iZ>
   	// @iZ atomic number of element
   	// @x coordinates at wich ion population fractions are evaluated
@@ -254,6 +522,29 @@ class CIonFrac {
     //
     void ResetAllIonFrac( double flog_10T, double flog_10n );
 
+    // Reset fractional population of all elements for a cell context
+    // @pContext cell context (see <CRadiation::GetCellContext>)
+    //
+    // As <ResetAllIonFrac> at the temperature and density of the context,
+    // re-using its stencils and interpolation weights.
+    //
+    void ResetAllIonFrac( CELLCONTEXT *pContext );
+
+    // Reset fractional population of all elements in every cell of a grid
+    // @iNumCells number of cells
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    // @pflog_10T log base 10 of temperature (in K) in each cell
+    // @pflog_10n log base 10 of density (in cm^-3) in each cell (may be NULL)
+    //
+    // Reset fractional population of all elements in every cell to their
+    // equilibrium values, as <ResetAllIonFrac>. If <pflog_10n> is NULL the
+    // temperature only equilibrium is used. The cells are shared between
+    // threads when compiled with OPENMP.
+    //
+    static void ResetGridIonFrac( int iNumCells, CIonFrac **ppIonFracObj, double *pflog_10T, double *pflog_10n );
+
 };
 
 typedef CIonFrac* PIONFRAC;
+
+#endif
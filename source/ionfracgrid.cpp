@@ -0,0 +1,366 @@
+// ****
+// *
+// * Grid-Wide Ionisation Fraction Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ionfracgrid.h"
+
+
+CIonFracGrid::CIonFracGrid( int iNumCells, CIonFrac *pInitIonFrac, PRADIATION pRadiationObj )
+{
+double **ppInitIonFrac, **ppInitdnibydt;
+int c, i, j, iValuesPerLine, *pAtomicNumber;
+
+// Set the radiation object pointer
+pRadiation = pRadiationObj;
+
+NumCells = iNumCells;
+
+// Get the element info from the ionfrac object being used to initialise the grid
+pAtomicNumber = pInitIonFrac->pGetElementInfo( &NumElements );
+cutoff_ion_fraction = pInitIonFrac->GetCutoffIonFraction();
+
+pZ = (int*)malloc( sizeof(int) * NumElements );
+pOffset = (int*)malloc( sizeof(int) * NumElements );
+
+TotalNumIons = 0;
+for( i=0; i<NumElements; i++ )
+{
+    pZ[i] = pAtomicNumber[i];
+    pOffset[i] = TotalNumIons;
+    TotalNumIons += pZ[i] + 1;
+}
+
+// Pad each cell so that every cell starts on an aligned boundary
+iValuesPerLine = IONFRACGRID_ALIGNMENT / sizeof(double);
+CellStride = ( ( TotalNumIons + iValuesPerLine - 1 ) / iValuesPerLine ) * iValuesPerLine;
+
+pRateCache = NULL;
+
+// The sizes and the cell offsets below are calculated as size_t, since NumCells * CellStride overflows an int for grids of a few million cells
+if( posix_memalign( (void**)&pIonFrac, IONFRACGRID_ALIGNMENT, sizeof(double) * NumCells * CellStride ) ) pIonFrac = NULL;
+if( posix_memalign( (void**)&pdnibydt, IONFRACGRID_ALIGNMENT, sizeof(double) * NumCells * CellStride ) ) pdnibydt = NULL;
+
+// The padding is zeroed and remains zero
+memset( pIonFrac, 0, sizeof(double) * NumCells * CellStride );
+memset( pdnibydt, 0, sizeof(double) * NumCells * CellStride );
+
+// Initialise every cell with the ion population fractions and rates of change of pInitIonFrac
+ppInitIonFrac = pInitIonFrac->ppGetIonFrac();
+ppInitdnibydt = pInitIonFrac->ppGetdnibydt();
+
+for( c=0; c<NumCells; c++ )
+    for( i=0; i<NumElements; i++ )
+        for( j=0; j<=pZ[i]; j++ )
+        {
+            pIonFrac[(size_t)c*CellStride+pOffset[i]+j] = ppInitIonFrac[i][j];
+            pdnibydt[(size_t)c*CellStride+pOffset[i]+j] = ppInitdnibydt[i][j];
+        }
+}
+
+CIonFracGrid::~CIonFracGrid( void )
+{
+FreeAll();
+}
+
+void CIonFracGrid::FreeAll( void )
+{
+if( pRateCache )
+{
+    pRadiation->FreeRateCache( pRateCache );
+    free( pRateCache );
+}
+
+free( pIonFrac );
+free( pdnibydt );
+free( pOffset );
+free( pZ );
+}
+
+double* CIonFracGrid::pGetIonFrac( void )
+{
+return pIonFrac;
+}
+
+double* CIonFracGrid::pGetdnibydt( void )
+{
+return pdnibydt;
+}
+
+double* CIonFracGrid::pGetIonFrac( int iCell, int iZ )
+{
+int iOffset;
+
+iOffset = GetElementOffset( iZ );
+
+if( iOffset < 0 ) return NULL;
+
+return pIonFrac + (size_t)iCell * CellStride + iOffset;
+}
+
+double* CIonFracGrid::pGetdnibydt( int iCell, int iZ )
+{
+int iOffset;
+
+iOffset = GetElementOffset( iZ );
+
+if( iOffset < 0 ) return NULL;
+
+return pdnibydt + (size_t)iCell * CellStride + iOffset;
+}
+
+double CIonFracGrid::GetCutoffIonFraction( void )
+{
+return cutoff_ion_fraction;
+}
+
+int CIonFracGrid::GetCellStride( void )
+{
+return CellStride;
+}
+
+int CIonFracGrid::GetElementOffset( int iZ )
+{
+int i;
+
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
+
+if( i == NumElements ) return -1;
+
+return pOffset[i];
+}
+
+void CIonFracGrid::CopyAllIonFrac( CIonFracGrid *pIonFracGrid )
+{
+memcpy( pIonFrac, pIonFracGrid->pGetIonFrac(), sizeof(double) * NumCells * CellStride );
+}
+
+void CIonFracGrid::CopyAlldnibydt( CIonFracGrid *pIonFracGrid )
+{
+memcpy( pdnibydt, pIonFracGrid->pGetdnibydt(), sizeof(double) * NumCells * CellStride );
+}
+
+void CIonFracGrid::Swap( CIonFracGrid *pIonFracGrid )
+{
+double *pTemp;
+
+pTemp = pIonFrac;
+pIonFrac = pIonFracGrid->pIonFrac;
+pIonFracGrid->pIonFrac = pTemp;
+
+pTemp = pdnibydt;
+pdnibydt = pIonFracGrid->pdnibydt;
+pIonFracGrid->pdnibydt = pTemp;
+}
+
+void CIonFracGrid::IntegrateAllIonFrac( double delta_t )
+{
+double *pni, *pdni;
+long long k, llNumValues;
+
+pni = pIonFrac;
+pdni = pdnibydt;
+llNumValues = (long long)NumCells * CellStride;
+
+// Integrate every ion of every cell in a single loop
+#ifdef OPENMP
+#pragma omp parallel for
+#endif // OPENMP
+for( k=0; k<llNumValues; k++ )
+{
+    pni[k] += pdni[k] * delta_t;
+
+    // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+    if( pni[k] < cutoff_ion_fraction )
+        pni[k] = 0.0;
+}
+
+NormaliseAllIonFrac();
+}
+
+void CIonFracGrid::NormaliseAllIonFrac( void )
+{
+double *pni, fTotal;
+int c, i, j;
+
+#ifdef OPENMP
+#pragma omp parallel for private( pni, fTotal, i, j )
+#endif // OPENMP
+for( c=0; c<NumCells; c++ )
+    for( i=0; i<NumElements; i++ )
+    {
+        pni = pIonFrac + (size_t)c * CellStride + pOffset[i];
+
+        fTotal = 0.0;
+        for( j=0; j<=pZ[i]; j++ )
+            fTotal += pni[j];
+
+        // Normalise the sum total of the ion fractional populations to 1
+        for( j=0; j<=pZ[i]; j++ )
+            pni[j] = pni[j] / fTotal;
+    }
+}
+
+void CIonFracGrid::GetAlldnibydt( double *pflog_10T, double *pflog_10n, double *pTimeScale )
+{
+#ifdef OPENMP
+#pragma omp parallel
+#endif // OPENMP
+{
+CELLCONTEXT Context;
+double **ppni, **ppdnibydt, TimeScale;
+int c, i;
+bool bHint = false;
+
+// Point to the ions of each element in the current cell
+ppni = (double**)alloca( sizeof(double*) * NumElements );
+ppdnibydt = (double**)alloca( sizeof(double*) * NumElements );
+
+#ifdef OPENMP
+#pragma omp for
+#endif // OPENMP
+for( c=0; c<NumCells; c++ )
+{
+    for( i=0; i<NumElements; i++ )
+    {
+        ppni[i] = pIonFrac + (size_t)c * CellStride + pOffset[i];
+        ppdnibydt[i] = pdnibydt + (size_t)c * CellStride + pOffset[i];
+    }
+
+    if( pRateCache )
+        pRadiation->GetAlldnibydt( pflog_10T[c], pflog_10n[c], ppni, ppdnibydt, &TimeScale, pRateCache + c );
+    else
+    {
+        // The stencils of each cell are hunted for from those of the previous cell handled by the same thread
+        pRadiation->GetCellContext( pflog_10T[c], pflog_10n[c], &Context, bHint );
+        pRadiation->GetAlldnibydt( &Context, ppni, ppdnibydt, &TimeScale );
+        bHint = true;
+    }
+
+    if( pTimeScale )
+        pTimeScale[c] = TimeScale;
+}
+}
+}
+
+void CIonFracGrid::EnableRateCache( void )
+{
+if( pRateCache ) return;
+
+pRateCache = (RATECACHE*)malloc( sizeof(RATECACHE) * NumCells );
+pRadiation->InitialiseRateCache( pRateCache, NumCells );
+}
+
+void CIonFracGrid::GetRateCacheCounts( int *piHits, int *piMisses )
+{
+int c;
+
+*piHits = *piMisses = 0;
+
+if( !pRateCache ) return;
+
+for( c=0; c<NumCells; c++ )
+{
+    *piHits += pRateCache[c].iHits;
+    *piMisses += pRateCache[c].iMisses;
+    pRateCache[c].iHits = pRateCache[c].iMisses = 0;
+}
+}
+
+void CIonFracGrid::ResetAllIonFrac( double *pflog_10T, double *pflog_10n )
+{
+int i;
+
+for( i=0; i<NumElements; i++ )
+    pRadiation->GetGridEquilIonFrac( pZ[i], NumCells, pflog_10T, pflog_10n, pIonFrac + pOffset[i], CellStride, 1 );
+}
+
+bool CIonFracGrid::WriteBinaryFile( char *szFilename, bool bWritednibydt )
+{
+FILE *pFile;
+bool bSuccess;
+
+pFile = fopen( szFilename, "wb" );
+if( !pFile )
+{
+    printf( "Failed to open binary ion population file %s.\n", szFilename );
+    return false;
+}
+
+bSuccess = CIonFrac::WriteBinaryFileHeader( pFile, NumCells, NumElements, pZ, CellStride, bWritednibydt ? IONFRAC_FILE_DNIBYDT : 0 );
+bSuccess = bSuccess && fwrite( pIonFrac, sizeof(double) * CellStride, NumCells, pFile ) == (size_t)NumCells;
+if( bWritednibydt )
+    bSuccess = bSuccess && fwrite( pdnibydt, sizeof(double) * CellStride, NumCells, pFile ) == (size_t)NumCells;
+
+if( fclose( pFile ) ) bSuccess = false;
+
+if( !bSuccess ) printf( "Failed to write binary ion population file %s.\n", szFilename );
+
+return bSuccess;
+}
+
+bool CIonFracGrid::ReadBinaryFile( char *szFilename )
+{
+FILE *pFile;
+IONFRACFILEHEADER Header;
+double *pBlock[2], *pBuffer;
+int c, k, iNumBlocks;
+bool bSuccess = true;
+
+pFile = fopen( szFilename, "rb" );
+if( !pFile )
+{
+    printf( "Failed to open binary ion population file %s.\n", szFilename );
+    return false;
+}
+
+if( !CIonFrac::ReadBinaryFileHeader( pFile, &Header, NumCells, NumElements, pZ ) )
+{
+    fclose( pFile );
+    return false;
+}
+
+iNumBlocks = ( Header.iFlags & IONFRAC_FILE_DNIBYDT ) ? 2 : 1;
+pBlock[0] = pIonFrac;
+pBlock[1] = pdnibydt;
+
+if( Header.iCellStride == CellStride )
+{
+    // Read each block directly into the grid
+    for( k=0; k<iNumBlocks && bSuccess; k++ )
+        bSuccess = fread( pBlock[k], sizeof(double) * CellStride, NumCells, pFile ) == (size_t)NumCells;
+}
+else
+{
+    // Read each block with one call and copy the ions of each cell into place
+    pBuffer = (double*)malloc( sizeof(double) * NumCells * Header.iCellStride );
+
+    for( k=0; k<iNumBlocks && bSuccess; k++ )
+    {
+        bSuccess = fread( pBuffer, sizeof(double) * Header.iCellStride, NumCells, pFile ) == (size_t)NumCells;
+
+        if( bSuccess )
+            for( c=0; c<NumCells; c++ )
+                memcpy( pBlock[k] + (size_t)c * CellStride, pBuffer + (size_t)c * Header.iCellStride, sizeof(double) * TotalNumIons );
+    }
+
+    free( pBuffer );
+}
+
+fclose( pFile );
+
+if( !bSuccess ) printf( "Failed to read binary ion population file %s.\n", szFilename );
+
+return bSuccess;
+}
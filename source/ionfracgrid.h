@@ -0,0 +1,217 @@
+#ifndef IONFRACGRID_H
+#define IONFRACGRID_H
+
+#include "ionfrac.h"
+
+// Alignment (in bytes) of the ion population blocks and of the start of each cell's ions
+#define IONFRACGRID_ALIGNMENT 64
+
+// Grid-wide ionization fraction class
+//
+// Class for holding the ion population fractions and their rates of change for every cell
+// of a grid in two contiguous, aligned blocks (one for the fractions and one for the rates
+// of change) rather than one <CIonFrac> per cell with one allocation per element. The ions
+// of cell c begin at c * <GetCellStride> and the ions of each element begin at a fixed offset
+// from the start of the cell (see <GetElementOffset>), so the blocks can be passed directly to
+// the strided grid functions of <CRadiation> and whole-grid operations become single loops.
+//
+// A <CIonFrac> object can view a cell of the grid (see <CIonFrac::ViewGrid>), so existing code
+// working on <CIonFrac> objects can operate on the grid's storage without copying.
+//
+class CIonFracGrid {
+
+  private:
+
+  	/* Pointer to a radiation object */
+    PRADIATION pRadiation;
+
+  	/*- Threshold below which ion populations are set to zero */
+  	double cutoff_ion_fraction;
+
+    /*- Fractional populations of the ions of every element in every cell */
+    double *pIonFrac;
+
+    /*- Rates of change with respect to time of the fractional populations of the ions of every element in every cell */
+    double *pdnibydt;
+
+    /*- Offset of the first ion of each element from the start of a cell */
+    int *pOffset;
+
+    /*- Total number of ions of all elements */
+    int TotalNumIons;
+
+    /*- Number of values between the start of consecutive cells (padded for alignment) */
+    int CellStride;
+
+    /*- Rate cache of each cell (NULL unless enabled) */
+    RATECACHE *pRateCache;
+
+    /*- Free all memory allocated by object */
+    void FreeAll( void );
+
+  public:
+
+  	// Default constructor
+    // @iNumCells number of cells in the grid
+    // @pInitIonFrac instance of <CIonFrac> class used to initialise every cell
+    // @pRadiationObj instance of <PRADIATION>
+    //
+    CIonFracGrid( int iNumCells, CIonFrac *pInitIonFrac, PRADIATION pRadiationObj );
+
+    /* Destructor */
+    ~CIonFracGrid( void );
+
+    /* Number of cells in the grid */
+    int NumCells;
+
+    /* Number of elements for which ion population fractions are available */
+    int NumElements;
+
+	  /* Pointer to an array containing each element's atomic number.*/
+    int *pZ;
+
+    // Return the block of ion population fractions
+    //
+    // @return pointer to the ion population fractions of the first cell
+    //
+    double* pGetIonFrac( void );
+
+    // Return the block of ion population fraction rates of change
+    //
+    // @return pointer to the rates of change of the first cell
+    //
+    double* pGetdnibydt( void );
+
+    // Return ion population fractions for element <iZ> in cell <iCell>
+    // @iCell index of cell
+    // @iZ atomic number of element
+    //
+    // @return pointer to the ion population fractions, or NULL if the element is not present
+    //
+    double* pGetIonFrac( int iCell, int iZ );
+
+    // Return ion population fraction rates of change for element <iZ> in cell <iCell>
+    // @iCell index of cell
+    // @iZ atomic number of element
+    //
+    // @return pointer to the rates of change, or NULL if the element is not present
+    //
+    double* pGetdnibydt( int iCell, int iZ );
+
+    // Return the cut-off ion population fraction
+    //
+    // @return threshold below which ion population fractions are set to zero
+    //
+    double GetCutoffIonFraction( void );
+
+    // Return the cell stride
+    //
+    // @return number of values between the start of consecutive cells
+    //
+    int GetCellStride( void );
+
+    // Return the element offset
+    // @iZ atomic number of element
+    //
+    // @return offset of the first ion of element <iZ> from the start of a cell, or -1 if the element is not present
+    //
+    int GetElementOffset( int iZ );
+
+  	// Overwrite ion population fractions for all elements in every cell
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class of the same size
+  	//
+    void CopyAllIonFrac( CIonFracGrid *pIonFracGrid );
+
+  	// Overwrite rate of change for all elements in every cell
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class of the same size
+  	//
+    void CopyAlldnibydt( CIonFracGrid *pIonFracGrid );
+
+    // Exchange the ion population fractions and rates of change with another grid
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class of the same size
+    //
+    // The blocks are exchanged rather than copied. <CIonFrac> objects viewing
+    // either grid continue to view the same storage, so they should be pointed
+    // at their grid again with <CIonFrac::ViewGrid>.
+    //
+    void Swap( CIonFracGrid *pIonFracGrid );
+
+  	// Integrate ion fraction rates of change for all elements in every cell
+  	// @delta_t current time step
+  	//
+  	// Integrate the dnibydt term over the whole grid, setting the ion
+  	// population fractions below the cut-off to zero and normalising the sum
+  	// of each element's ion population fractions to one in every cell, as
+  	// <CIonFrac::IntegrateAllIonFrac>.
+  	//
+    void IntegrateAllIonFrac( double delta_t );
+
+    // Normalise the ion population fractions of all elements in every cell
+    //
+    void NormaliseAllIonFrac( void );
+
+    // Calculate the ion population fraction rates of change for all elements in every cell
+    // @pflog_10T log base 10 of temperature (in K) in each cell
+    // @pflog_10n log base 10 of density (in cm^-3) in each cell
+    // @pTimeScale smallest characteristic time-scale of all elements in each cell (may be NULL)
+    //
+    // As <CRadiation::GetAlldnibydt> applied to every cell, re-using each
+    // cell's rates if the rate cache is enabled (see <EnableRateCache>). The
+    // stencils of each cell are hunted for from those of the previous cell.
+    //
+    void GetAlldnibydt( double *pflog_10T, double *pflog_10n, double *pTimeScale );
+
+    // Enable the rate cache
+    //
+    // Hold the interpolated rates of every cell so that <GetAlldnibydt> re-uses
+    // them while the cell's log_10 T changes by no more than the rate cache
+    // tolerance (see <CRadiation::GetAlldnibydt>).
+    //
+    void EnableRateCache( void );
+
+    // Return the rate cache counters
+    // @piHits number of cell evaluations that re-used the cached rates
+    // @piMisses number of cell evaluations that interpolated the rates
+    //
+    // The counters are summed over every cell and reset to zero.
+    //
+    void GetRateCacheCounts( int *piHits, int *piMisses );
+
+    // Reset fractional population of all elements in every cell
+    // @pflog_10T log base 10 of temperature (in K) in each cell
+    // @pflog_10n log base 10 of density (in cm^-3) in each cell (may be NULL)
+    //
+    // Reset fractional population of all elements in every cell to their
+    // equilibrium values (see <CRadiation::GetGridEquilIonFrac>).
+    //
+    void ResetAllIonFrac( double *pflog_10T, double *pflog_10n );
+
+    // Write the grid to a binary file
+    // @szFilename binary ion population filename
+    // @bWritednibydt if True, also write the rates of change
+    //
+    // Write the ion population fractions of every cell to a binary file (see
+    // <IONFRACFILEHEADER>) in the layout of the grid, with one call for each block.
+    //
+    // @return True if the file was written
+    //
+    bool WriteBinaryFile( char *szFilename, bool bWritednibydt );
+
+    // Read the grid from a binary file
+    // @szFilename binary ion population filename
+    //
+    // Read the ion population fractions (and the rates of change, if the file
+    // holds them) of every cell from a binary file written by <WriteBinaryFile>
+    // or <CIonFrac::WriteGridToBinaryFile>. The file must hold the same number
+    // of cells and the same elements. If the file was written with the cell
+    // stride of the grid each block is read directly with one call.
+    //
+    // @return True if the file was read
+    //
+    bool ReadBinaryFile( char *szFilename );
+
+};
+
+typedef CIonFracGrid* PIONFRACGRID;
+
+#endif
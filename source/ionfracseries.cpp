@@ -0,0 +1,425 @@
+// ****
+// *
+// * Ion Population Time-Series Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "ionfracseries.h"
+
+
+// Number of bytes needed to hold the non-zero low-order bytes of a value
+static int GetNumBytes( unsigned long long x )
+{
+int n = 0;
+
+while( x )
+{
+    x >>= 8;
+    n++;
+}
+
+return n;
+}
+
+CIonFracSeriesWriter::CIonFracSeriesWriter( char *szFilename, int iNumCells, int iNumElements, int *pAtomicNumber, int iKeyframeInterval )
+{
+IONFRACSERIESHEADER Header;
+int i;
+
+NumCells = iNumCells;
+NumElements = iNumElements;
+KeyframeInterval = iKeyframeInterval > 0 ? iKeyframeInterval : 1;
+
+pZ = (int*)malloc( sizeof(int) * NumElements );
+
+TotalNumIons = 0;
+for( i=0; i<NumElements; i++ )
+{
+    pZ[i] = pAtomicNumber[i];
+    TotalNumIons += pZ[i] + 1;
+}
+
+pCurrent = (double*)malloc( sizeof(double) * NumCells * TotalNumIons );
+pPrevious = (double*)malloc( sizeof(double) * NumCells * TotalNumIons );
+
+// Largest compressed frame: the window, the byte counts and every byte of every ion
+pFrameBuffer = (unsigned char*)malloc( NumCells * ( NumElements * 3 + TotalNumIons * ( sizeof(double) + 1 ) ) );
+
+NumFrames = 0;
+MaxNumFrames = 256;
+pFrame = (IONFRACSERIESFRAME*)malloc( sizeof(IONFRACSERIESFRAME) * MaxNumFrames );
+
+pFile = fopen( szFilename, "wb" );
+if( !pFile )
+{
+    printf( "Failed to open ion population time-series file %s.\n", szFilename );
+    return;
+}
+
+// The index offset and the number of frames are completed when the file is closed
+memset( &Header, 0, sizeof(IONFRACSERIESHEADER) );
+strcpy( Header.szMagic, IONFRACSERIES_MAGIC );
+Header.iByteOrder = IONFRAC_FILE_BYTE_ORDER;
+Header.iVersion = IONFRACSERIES_VERSION;
+Header.iNumCells = NumCells;
+Header.iNumElements = NumElements;
+Header.iKeyframeInterval = KeyframeInterval;
+
+fwrite( &Header, sizeof(IONFRACSERIESHEADER), 1, (FILE*)pFile );
+fwrite( pZ, sizeof(int), NumElements, (FILE*)pFile );
+}
+
+CIonFracSeriesWriter::~CIonFracSeriesWriter( void )
+{
+Close();
+
+free( pFrame );
+free( pFrameBuffer );
+free( pPrevious );
+free( pCurrent );
+free( pZ );
+}
+
+bool CIonFracSeriesWriter::WriteCurrentFrame( double fTime )
+{
+unsigned long long x, y;
+unsigned char *pByte, *pCount;
+double *pni, *pPrevni, *pTemp, fZero = 0.0;
+int c, i, j, k, lo, hi, n;
+bool bKeyframe;
+
+if( !pFile ) return false;
+
+bKeyframe = !( NumFrames % KeyframeInterval );
+
+pByte = pFrameBuffer;
+
+for( c=0; c<NumCells; c++ )
+    for( i=0, k=0; i<NumElements; k+=pZ[i]+1, i++ )
+    {
+        pni = pCurrent + (size_t)c * TotalNumIons + k;
+        pPrevni = pPrevious + (size_t)c * TotalNumIons + k;
+
+        // Find the window of non-zero ions
+        for( lo=0; lo<=pZ[i] && pni[lo] == 0.0; lo++ );
+        for( hi=pZ[i]; hi>=lo && pni[hi] == 0.0; hi-- );
+
+        *(pByte++) = (unsigned char)lo;
+        *(pByte++) = (unsigned char)( hi + 1 );
+
+        // Two 4-bit byte counts per byte, followed by the low-order bytes of each value
+        pCount = pByte;
+        pByte += ( hi - lo + 2 ) / 2;
+        memset( pCount, 0, ( hi - lo + 2 ) / 2 );
+
+        for( j=lo; j<=hi; j++ )
+        {
+            memcpy( &x, pni + j, sizeof(double) );
+            memcpy( &y, bKeyframe ? &fZero : pPrevni + j, sizeof(double) );
+            x ^= y;
+
+            n = GetNumBytes( x );
+            pCount[(j-lo)/2] |= (unsigned char)( n << ( 4 * ( ( j - lo ) & 1 ) ) );
+
+            for( ; n; n--, x >>= 8 )
+                *(pByte++) = (unsigned char)( x & 0xff );
+        }
+    }
+
+if( NumFrames == MaxNumFrames )
+{
+    MaxNumFrames *= 2;
+    pFrame = (IONFRACSERIESFRAME*)realloc( pFrame, sizeof(IONFRACSERIESFRAME) * MaxNumFrames );
+}
+
+// The padding of the index entry is cleared so that the file is reproducible
+memset( pFrame + NumFrames, 0, sizeof(IONFRACSERIESFRAME) );
+pFrame[NumFrames].llOffset = (long long)ftello( (FILE*)pFile );
+pFrame[NumFrames].fTime = fTime;
+pFrame[NumFrames].llSize = (long long)( pByte - pFrameBuffer );
+pFrame[NumFrames].bKeyframe = bKeyframe;
+
+if( fwrite( pFrameBuffer, 1, (size_t)pFrame[NumFrames].llSize, (FILE*)pFile ) != (size_t)pFrame[NumFrames].llSize )
+{
+    printf( "Failed to write ion population time-series frame.\n" );
+    return false;
+}
+
+NumFrames++;
+
+// The current frame becomes the reference for the next
+pTemp = pPrevious;
+pPrevious = pCurrent;
+pCurrent = pTemp;
+
+return true;
+}
+
+bool CIonFracSeriesWriter::WriteFrame( double fTime, CIonFrac **ppIonFracObj )
+{
+double *pValue, **ppni;
+int c, i;
+
+pValue = pCurrent;
+for( c=0; c<NumCells; c++ )
+{
+    ppni = ppIonFracObj[c]->ppGetIonFrac();
+
+    for( i=0; i<NumElements; i++ )
+    {
+        memcpy( pValue, ppni[i], sizeof(double) * ( pZ[i] + 1 ) );
+        pValue += pZ[i] + 1;
+    }
+}
+
+return WriteCurrentFrame( fTime );
+}
+
+bool CIonFracSeriesWriter::WriteFrame( double fTime, CIonFracGrid *pIonFracGrid )
+{
+double *pBlock;
+int c, iCellStride;
+
+pBlock = pIonFracGrid->pGetIonFrac();
+iCellStride = pIonFracGrid->GetCellStride();
+
+// The elements are held in the same order and contiguously within each cell of the grid
+for( c=0; c<NumCells; c++ )
+    memcpy( pCurrent + (size_t)c * TotalNumIons, pBlock + (size_t)c * iCellStride, sizeof(double) * TotalNumIons );
+
+return WriteCurrentFrame( fTime );
+}
+
+bool CIonFracSeriesWriter::Close( void )
+{
+IONFRACSERIESHEADER Header;
+bool bSuccess;
+
+if( !pFile ) return false;
+
+memset( &Header, 0, sizeof(IONFRACSERIESHEADER) );
+strcpy( Header.szMagic, IONFRACSERIES_MAGIC );
+Header.iByteOrder = IONFRAC_FILE_BYTE_ORDER;
+Header.iVersion = IONFRACSERIES_VERSION;
+Header.iNumCells = NumCells;
+Header.iNumElements = NumElements;
+Header.iKeyframeInterval = KeyframeInterval;
+Header.iNumFrames = NumFrames;
+Header.llIndexOffset = (long long)ftello( (FILE*)pFile );
+
+// Write the frame index and complete the header
+bSuccess = fwrite( pFrame, sizeof(IONFRACSERIESFRAME), NumFrames, (FILE*)pFile ) == (size_t)NumFrames;
+bSuccess = bSuccess && !fseeko( (FILE*)pFile, 0, SEEK_SET );
+bSuccess = bSuccess && fwrite( &Header, sizeof(IONFRACSERIESHEADER), 1, (FILE*)pFile ) == 1;
+
+if( fclose( (FILE*)pFile ) ) bSuccess = false;
+pFile = NULL;
+
+if( !bSuccess ) printf( "Failed to complete ion population time-series file.\n" );
+
+return bSuccess;
+}
+
+CIonFracSeriesReader::CIonFracSeriesReader( char *szFilename )
+{
+IONFRACSERIESHEADER Header;
+long long llMaxSize;
+int i;
+
+NumCells = 0;
+NumFrames = 0;
+NumElements = 0;
+TotalNumIons = 0;
+CurrentFrame = -1;
+pZ = NULL;
+pCurrent = NULL;
+pFrameBuffer = NULL;
+pFrame = NULL;
+
+pFile = fopen( szFilename, "rb" );
+if( !pFile )
+{
+    printf( "Failed to open ion population time-series file %s.\n", szFilename );
+    return;
+}
+
+if( fread( &Header, sizeof(IONFRACSERIESHEADER), 1, (FILE*)pFile ) != 1 || strncmp( Header.szMagic, IONFRACSERIES_MAGIC, 8 ) || Header.iByteOrder != IONFRAC_FILE_BYTE_ORDER || Header.iVersion > IONFRACSERIES_VERSION || !Header.llIndexOffset )
+{
+    printf( "%s is not a complete ion population time-series file.\n", szFilename );
+    fclose( (FILE*)pFile );
+    pFile = NULL;
+    return;
+}
+
+NumElements = Header.iNumElements;
+pZ = (int*)malloc( sizeof(int) * NumElements );
+fread( pZ, sizeof(int), NumElements, (FILE*)pFile );
+
+for( i=0; i<NumElements; i++ )
+    TotalNumIons += pZ[i] + 1;
+
+// Read the frame index
+pFrame = (IONFRACSERIESFRAME*)malloc( sizeof(IONFRACSERIESFRAME) * ( Header.iNumFrames + 1 ) );
+fseeko( (FILE*)pFile, (off_t)Header.llIndexOffset, SEEK_SET );
+if( fread( pFrame, sizeof(IONFRACSERIESFRAME), Header.iNumFrames, (FILE*)pFile ) != (size_t)Header.iNumFrames )
+{
+    printf( "Failed to read the frame index of ion population time-series file %s.\n", szFilename );
+    fclose( (FILE*)pFile );
+    pFile = NULL;
+    return;
+}
+
+llMaxSize = 0;
+for( i=0; i<Header.iNumFrames; i++ )
+    if( pFrame[i].llSize > llMaxSize )
+        llMaxSize = pFrame[i].llSize;
+
+pFrameBuffer = (unsigned char*)malloc( (size_t)llMaxSize + 1 );
+pCurrent = (double*)malloc( sizeof(double) * Header.iNumCells * TotalNumIons );
+
+NumCells = Header.iNumCells;
+NumFrames = Header.iNumFrames;
+}
+
+CIonFracSeriesReader::~CIonFracSeriesReader( void )
+{
+if( pFile )
+    fclose( (FILE*)pFile );
+
+free( pFrame );
+free( pFrameBuffer );
+free( pCurrent );
+free( pZ );
+}
+
+double CIonFracSeriesReader::GetTime( int iFrame )
+{
+return pFrame[iFrame].fTime;
+}
+
+bool CIonFracSeriesReader::DecodeFrame( int iFrame )
+{
+unsigned long long x, y;
+unsigned char *pByte, *pCount;
+double *pni;
+int c, i, j, k, lo, hi, n, b;
+
+if( fseeko( (FILE*)pFile, (off_t)pFrame[iFrame].llOffset, SEEK_SET ) || fread( pFrameBuffer, 1, (size_t)pFrame[iFrame].llSize, (FILE*)pFile ) != (size_t)pFrame[iFrame].llSize )
+{
+    printf( "Failed to read ion population time-series frame %i.\n", iFrame );
+    CurrentFrame = -1;
+    return false;
+}
+
+pByte = pFrameBuffer;
+
+for( c=0; c<NumCells; c++ )
+    for( i=0, k=0; i<NumElements; k+=pZ[i]+1, i++ )
+    {
+        pni = pCurrent + (size_t)c * TotalNumIons + k;
+
+        lo = *(pByte++);
+        hi = *(pByte++) - 1;
+
+        pCount = pByte;
+        pByte += ( hi - lo + 2 ) / 2;
+
+        // The ions outside the window are zero
+        for( j=0; j<lo; j++ )
+            pni[j] = 0.0;
+        for( j=hi+1; j<=pZ[i]; j++ )
+            pni[j] = 0.0;
+
+        for( j=lo; j<=hi; j++ )
+        {
+            n = ( pCount[(j-lo)/2] >> ( 4 * ( ( j - lo ) & 1 ) ) ) & 0xf;
+
+            x = 0;
+            for( b=0; b<n; b++ )
+                x |= (unsigned long long)*(pByte++) << ( 8 * b );
+
+            // Keyframes are XORed with zero
+            y = 0;
+            if( !pFrame[iFrame].bKeyframe )
+                memcpy( &y, pni + j, sizeof(double) );
+
+            x ^= y;
+            memcpy( pni + j, &x, sizeof(double) );
+        }
+    }
+
+CurrentFrame = iFrame;
+
+return true;
+}
+
+bool CIonFracSeriesReader::SeekFrame( int iFrame )
+{
+int iStart;
+
+if( !pFile || iFrame < 0 || iFrame >= NumFrames ) return false;
+
+// Find the keyframe the requested frame depends on
+for( iStart=iFrame; !pFrame[iStart].bKeyframe; iStart-- );
+
+// Decode forwards from the last frame read if it is on the way
+if( CurrentFrame >= iStart && CurrentFrame <= iFrame )
+    iStart = CurrentFrame + 1;
+
+for( ; iStart<=iFrame; iStart++ )
+    if( !DecodeFrame( iStart ) ) return false;
+
+return true;
+}
+
+bool CIonFracSeriesReader::ReadFrame( int iFrame, CIonFrac **ppIonFracObj )
+{
+double *pValue, **ppni;
+int c, i;
+
+if( !SeekFrame( iFrame ) ) return false;
+
+pValue = pCurrent;
+for( c=0; c<NumCells; c++ )
+{
+    ppni = ppIonFracObj[c]->ppGetIonFrac();
+
+    for( i=0; i<NumElements; i++ )
+    {
+        memcpy( ppni[i], pValue, sizeof(double) * ( pZ[i] + 1 ) );
+        pValue += pZ[i] + 1;
+    }
+}
+
+return true;
+}
+
+bool CIonFracSeriesReader::ReadFrame( int iFrame, CIonFracGrid *pIonFracGrid )
+{
+double *pBlock;
+int c, iCellStride;
+
+if( pIonFracGrid->NumCells != NumCells || pIonFracGrid->NumElements != NumElements )
+{
+    printf( "Ion population time-series holds %i cells and %i elements; expected %i cells and %i elements.\n", NumCells, NumElements, pIonFracGrid->NumCells, pIonFracGrid->NumElements );
+    return false;
+}
+
+if( !SeekFrame( iFrame ) ) return false;
+
+pBlock = pIonFracGrid->pGetIonFrac();
+iCellStride = pIonFracGrid->GetCellStride();
+
+for( c=0; c<NumCells; c++ )
+    memcpy( pBlock + (size_t)c * iCellStride, pCurrent + (size_t)c * TotalNumIons, sizeof(double) * TotalNumIons );
+
+return true;
+}
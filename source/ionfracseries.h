@@ -0,0 +1,228 @@
+#ifndef IONFRACSERIES_H
+#define IONFRACSERIES_H
+
+#include "ionfracgrid.h"
+
+// Ion population time-series file identification, version and default keyframe interval
+#define IONFRACSERIES_MAGIC "IONFSER"
+#define IONFRACSERIES_VERSION 1
+#define IONFRACSERIES_KEYFRAME_INTERVAL 16
+
+// Ion population time-series file header
+//
+// A time-series file consists of this header, followed by the atomic numbers of the
+// <iNumElements> elements (int), the compressed frames and, once the file has been closed,
+// an index of <iNumFrames> <IONFRACSERIESFRAME> entries starting at <llIndexOffset>.
+//
+// In each frame the ions of every element in every cell are stored as a window: the
+// indices of the first and last non-zero ions (one byte each), then one 4-bit byte count
+// for each ion in the window (two counts per byte) and then that many low-order bytes of
+// each ion's value XORed with its value in the previous frame. Ions outside the window are
+// exactly zero. Slowly changing values share their sign, exponent and leading mantissa bits
+// with the previous frame, so only a few bytes of each are stored, and unchanged values
+// cost half a byte. Keyframes are XORed with zero so that they can be decoded on their own.
+// Values are written in the byte order of the machine that wrote the file.
+//
+typedef struct {
+    /* File identifier, <IONFRACSERIES_MAGIC> */
+    char szMagic[8];
+    /* File offset of the frame index */
+    long long llIndexOffset;
+    /* <IONFRAC_FILE_BYTE_ORDER> as written */
+    int iByteOrder;
+    /* File format version */
+    int iVersion;
+    /* Number of cells in each frame */
+    int iNumCells;
+    /* Number of elements */
+    int iNumElements;
+    /* Number of frames between keyframes */
+    int iKeyframeInterval;
+    /* Number of frames */
+    int iNumFrames;
+} IONFRACSERIESHEADER;
+
+// Ion population time-series frame index entry
+typedef struct {
+    /* File offset of the compressed frame */
+    long long llOffset;
+    /* Time of the frame */
+    double fTime;
+    /* Size of the compressed frame (in bytes) */
+    long long llSize;
+    /* True if the frame is a keyframe */
+    int bKeyframe;
+} IONFRACSERIESFRAME;
+
+// Ion population time-series writer class
+//
+// Class for writing the ion population fractions of every cell at a high cadence to a
+// single compressed, lossless time-series file (see <IONFRACSERIESHEADER>), which can be
+// read frame by frame in any order with <CIonFracSeriesReader>.
+//
+class CIonFracSeriesWriter {
+
+  private:
+
+    /*- Output file stream */
+    void *pFile;
+
+    /*- Number of cells in each frame */
+    int NumCells;
+
+    /*- Total number of ions of all elements */
+    int TotalNumIons;
+
+    /*- Number of frames between keyframes */
+    int KeyframeInterval;
+
+    /*- Ion population fractions of the current and previous frames */
+    double *pCurrent, *pPrevious;
+
+    /*- Buffer holding the compressed frame */
+    unsigned char *pFrameBuffer;
+
+    /*- Frame index */
+    IONFRACSERIESFRAME *pFrame;
+
+    /*- Number of frames written and number of index entries allocated */
+    int NumFrames, MaxNumFrames;
+
+    /*- Compress and write the current frame */
+    bool WriteCurrentFrame( double fTime );
+
+  public:
+
+  	// Default constructor
+    // @szFilename time-series filename
+    // @iNumCells number of cells in each frame
+    // @iNumElements number of elements
+    // @pAtomicNumber atomic numbers of the elements
+    // @iKeyframeInterval number of frames between keyframes (e.g. <IONFRACSERIES_KEYFRAME_INTERVAL>)
+    //
+    CIonFracSeriesWriter( char *szFilename, int iNumCells, int iNumElements, int *pAtomicNumber, int iKeyframeInterval );
+
+    /* Destructor */
+    ~CIonFracSeriesWriter( void );
+
+    /* Number of elements */
+    int NumElements;
+
+	  /* Pointer to an array containing each element's atomic number.*/
+    int *pZ;
+
+    // Write a frame
+    // @fTime time of the frame
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    //
+    // @return True if the frame was written
+    //
+    bool WriteFrame( double fTime, CIonFrac **ppIonFracObj );
+
+    // Write a frame
+    // @fTime time of the frame
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class
+    //
+    // @return True if the frame was written
+    //
+    bool WriteFrame( double fTime, CIonFracGrid *pIonFracGrid );
+
+    // Close the file
+    //
+    // Write the frame index and complete the header. The file cannot be read
+    // until it has been closed. Called by the destructor if necessary.
+    //
+    // @return True if the file was completed
+    //
+    bool Close( void );
+
+};
+
+typedef CIonFracSeriesWriter* PIONFRACSERIESWRITER;
+
+// Ion population time-series reader class
+//
+// Class for reading any frame of a time-series file written by <CIonFracSeriesWriter>.
+// A frame is decoded from the nearest preceding keyframe, or from the last frame read
+// when reading forwards.
+//
+class CIonFracSeriesReader {
+
+  private:
+
+    /*- Input file stream */
+    void *pFile;
+
+    /*- Total number of ions of all elements */
+    int TotalNumIons;
+
+    /*- Ion population fractions of the last frame decoded */
+    double *pCurrent;
+
+    /*- Index of the last frame decoded (-1 if none) */
+    int CurrentFrame;
+
+    /*- Buffer holding a compressed frame */
+    unsigned char *pFrameBuffer;
+
+    /*- Frame index */
+    IONFRACSERIESFRAME *pFrame;
+
+    /*- Read and decode a frame into pCurrent */
+    bool DecodeFrame( int iFrame );
+
+    /*- Decode frames until the requested frame is current */
+    bool SeekFrame( int iFrame );
+
+  public:
+
+  	// Default constructor
+    // @szFilename time-series filename
+    //
+    CIonFracSeriesReader( char *szFilename );
+
+    /* Destructor */
+    ~CIonFracSeriesReader( void );
+
+    /* Number of cells in each frame (zero if the file could not be opened) */
+    int NumCells;
+
+    /* Number of frames */
+    int NumFrames;
+
+    /* Number of elements */
+    int NumElements;
+
+	  /* Pointer to an array containing each element's atomic number.*/
+    int *pZ;
+
+    // Return the time of a frame
+    // @iFrame index of frame
+    //
+    // @return time of the frame
+    //
+    double GetTime( int iFrame );
+
+    // Read a frame
+    // @iFrame index of frame
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    //
+    // The objects must hold the same elements as the file.
+    //
+    // @return True if the frame was read
+    //
+    bool ReadFrame( int iFrame, CIonFrac **ppIonFracObj );
+
+    // Read a frame
+    // @iFrame index of frame
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class with the same cells and elements as the file
+    //
+    // @return True if the frame was read
+    //
+    bool ReadFrame( int iFrame, CIonFracGrid *pIonFracGrid );
+
+};
+
+typedef CIonFracSeriesReader* PIONFRACSERIESREADER;
+
+#endif
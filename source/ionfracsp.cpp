@@ -0,0 +1,404 @@
+// ****
+// *
+// * Single-Precision Ionisation Fraction Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <math.h>
+
+#include "ionfracsp.h"
+#include "interp.h"
+#include "../../rsp_toolkit/source/file.h"
+#include "../../rsp_toolkit/source/constants.h"
+
+
+CIonFracSP::CIonFracSP( CIonFrac *pIonFrac, PRADIATION pRadiationObj, bool bValidate )
+{
+int i, *pAtomicNumber;
+
+// Set the radiation object pointer
+pRadiation = pRadiationObj;
+
+// Get the element info from the ionfrac object being used to initialise the new object
+pAtomicNumber = pIonFrac->pGetElementInfo( &NumElements );
+cutoff_ion_fraction = pIonFrac->GetCutoffIonFraction();
+
+pZ = (int*)malloc( sizeof(int) * NumElements );
+
+TotalNumIons = 0;
+for( i=0; i<NumElements; i++ )
+{
+    pZ[i] = pAtomicNumber[i];
+    TotalNumIons += pZ[i] + 1;
+}
+
+// Allocate a single block to hold the ion population fractions and their rates of change for
+// all of the elements, and point to the start of each element's ions
+ppIonFrac = (float**)malloc( sizeof(float*) * NumElements );
+ppdnibydt = (float**)malloc( sizeof(float*) * NumElements );
+ppIonFrac[0] = (float*)malloc( sizeof(float) * TotalNumIons );
+ppdnibydt[0] = (float*)malloc( sizeof(float) * TotalNumIons );
+
+for( i=1; i<NumElements; i++ )
+{
+    ppIonFrac[i] = ppIonFrac[i-1] + pZ[i-1] + 1;
+    ppdnibydt[i] = ppdnibydt[i-1] + pZ[i-1] + 1;
+}
+
+pShadow = NULL;
+
+Store( pIonFrac );
+
+// In validation mode carry a double-precision copy of the initial state
+if( bValidate )
+    pShadow = new CIonFrac( pIonFrac, NULL, pRadiationObj );
+}
+
+CIonFracSP::~CIonFracSP( void )
+{
+FreeAll();
+}
+
+void CIonFracSP::FreeAll( void )
+{
+free( ppIonFrac[0] );
+free( ppdnibydt[0] );
+free( ppIonFrac );
+free( ppdnibydt );
+free( pZ );
+
+if( pShadow )
+    delete pShadow;
+}
+
+void CIonFracSP::Expand( int i, double *pni )
+{
+double fTotal = 0.0;
+int j;
+
+for( j=0; j<=pZ[i]; j++ )
+{
+    pni[j] = (double)ppIonFrac[i][j];
+    fTotal += pni[j];
+}
+
+// Normalise the sum total of the ion fractional populations to 1
+pRadiation->Normalise( pZ[i], pni, fTotal );
+}
+
+void CIonFracSP::StoreElement( int i, double *pni )
+{
+int j;
+
+for( j=0; j<=pZ[i]; j++ )
+{
+    // Ensure the ion fractions below the cut-off are stored as exact zeros
+    if( pni[j] < cutoff_ion_fraction )
+        ppIonFrac[i][j] = 0.0f;
+    else
+        ppIonFrac[i][j] = (float)pni[j];
+}
+}
+
+float** CIonFracSP::ppGetIonFrac( void )
+{
+return ppIonFrac;
+}
+
+float** CIonFracSP::ppGetdnibydt( void )
+{
+return ppdnibydt;
+}
+
+void CIonFracSP::Store( CIonFrac *pIonFrac )
+{
+double **ppNewIonFrac, **ppNewdnibydt;
+int i, j;
+
+ppNewIonFrac = pIonFrac->ppGetIonFrac();
+ppNewdnibydt = pIonFrac->ppGetdnibydt();
+
+for( i=0; i<NumElements; i++ )
+{
+    StoreElement( i, ppNewIonFrac[i] );
+
+    for( j=0; j<=pZ[i]; j++ )
+        ppdnibydt[i][j] = (float)ppNewdnibydt[i][j];
+}
+
+if( pShadow )
+{
+    pShadow->CopyAllIonFrac( pIonFrac );
+    pShadow->CopyAlldnibydt( pIonFrac );
+}
+}
+
+void CIonFracSP::Load( CIonFrac *pIonFrac )
+{
+double **ppNewIonFrac, **ppNewdnibydt;
+int i, j;
+
+ppNewIonFrac = pIonFrac->ppGetIonFrac();
+ppNewdnibydt = pIonFrac->ppGetdnibydt();
+
+for( i=0; i<NumElements; i++ )
+{
+    Expand( i, ppNewIonFrac[i] );
+
+    for( j=0; j<=pZ[i]; j++ )
+        ppNewdnibydt[i][j] = (double)ppdnibydt[i][j];
+}
+}
+
+void CIonFracSP::GetAlldnibydt( double flog_10T, double flog_10n, double *pTimeScale )
+{
+double *pni, *pdnibydt, TimeScale, SmallestTimeScale;
+int i, j;
+
+// The scratch space is allocated once and used for each element in turn
+pni = (double*)alloca( sizeof(double) * TotalNumIons );
+pdnibydt = (double*)alloca( sizeof(double) * TotalNumIons );
+
+SmallestTimeScale = LARGEST_DOUBLE;
+
+for( i=0; i<NumElements; i++ )
+{
+    Expand( i, pni );
+
+    pRadiation->Getdnibydt( pZ[i], flog_10T, flog_10n, pni, pdnibydt, &TimeScale );
+
+    // The ion populations may have been reset to equilibrium
+    StoreElement( i, pni );
+
+    for( j=0; j<=pZ[i]; j++ )
+        ppdnibydt[i][j] = (float)pdnibydt[j];
+
+    if( TimeScale < SmallestTimeScale )
+        SmallestTimeScale = TimeScale;
+}
+
+*pTimeScale = SmallestTimeScale;
+
+if( pShadow )
+    pRadiation->GetAlldnibydt( flog_10T, flog_10n, pShadow->ppGetIonFrac(), pShadow->ppGetdnibydt(), &TimeScale );
+}
+
+void CIonFracSP::IntegrateAllIonFrac( double delta_t )
+{
+double *pni, fTotal;
+int i, j;
+
+// The scratch space is allocated once and used for each element in turn
+pni = (double*)alloca( sizeof(double) * TotalNumIons );
+
+for( i=0; i<NumElements; i++ )
+{
+    Expand( i, pni );
+
+    fTotal = 0.0;
+
+    for( j=0; j<=pZ[i]; j++ )
+    {
+        pni[j] += (double)ppdnibydt[i][j] * delta_t;
+
+        // Ensure the minimum ion fraction remains above the cut-off and is physically realistic
+        if( pni[j] < cutoff_ion_fraction )
+            pni[j] = 0.0;
+
+        fTotal += pni[j];
+    }
+
+    // Normalise the sum total of the ion fractional populations to 1
+    pRadiation->Normalise( pZ[i], pni, fTotal );
+
+    StoreElement( i, pni );
+}
+
+if( pShadow )
+    pShadow->IntegrateAllIonFrac( delta_t );
+}
+
+void CIonFracSP::CopyAllIonFrac( CIonFracSP *pIonFrac )
+{
+// Both objects hold the same elements in a single block
+memcpy( ppIonFrac[0], pIonFrac->ppGetIonFrac()[0], sizeof(float) * TotalNumIons );
+
+if( pShadow && pIonFrac->pShadow )
+    pShadow->CopyAllIonFrac( pIonFrac->pShadow );
+}
+
+void CIonFracSP::CopyAlldnibydt( CIonFracSP *pIonFrac )
+{
+memcpy( ppdnibydt[0], pIonFrac->ppGetdnibydt()[0], sizeof(float) * TotalNumIons );
+
+if( pShadow && pIonFrac->pShadow )
+    pShadow->CopyAlldnibydt( pIonFrac->pShadow );
+}
+
+void CIonFracSP::InterpolateAllIonFrac( double *x, CIonFracSP **ppIonFracSP, int iPoints, double s )
+{
+double w[5], fValue, ***pppShadowIonFrac;
+float *pfIonFrac;
+int j, n, iNumPoints;
+
+// The shadow can only be interpolated if every point carries one, which is checked before anything is changed. Otherwise
+// validation mode is dropped, rather than leaving the shadow behind the single-precision state
+if( pShadow )
+{
+    for( n=1; n<=iPoints; n++ )
+        if( !ppIonFracSP[n]->pShadow ) break;
+
+    if( n <= iPoints )
+    {
+        printf( "Warning: interpolating from a point without a double-precision shadow. Validation mode dropped.\n" );
+
+        delete pShadow;
+        pShadow = NULL;
+    }
+}
+
+// Calculate the interpolation weights once for all of the ions
+if( iPoints < 3 )
+{
+    iNumPoints = 2;
+    w[1] = ( x[2] - s ) / ( x[2] - x[1] );
+    w[2] = ( s - x[1] ) / ( x[2] - x[1] );
+}
+else
+{
+    // The stencil is bounded by the number of points given, so that three points give a quadratic
+    iNumPoints = iPoints < 4 ? iPoints : 4;
+    GetLagrangeWeights( x + 1, iNumPoints, s, w + 1, NULL );
+}
+
+pfIonFrac = ppIonFrac[0];
+
+for( j=0; j<TotalNumIons; j++ )
+{
+    fValue = 0.0;
+    for( n=1; n<=iNumPoints; n++ )
+        fValue += w[n] * (double)ppIonFracSP[n]->ppGetIonFrac()[0][j];
+    pfIonFrac[j] = (float)fValue;
+}
+
+if( pShadow )
+{
+    pppShadowIonFrac = (double***)alloca( sizeof(double**) * ( iPoints + 1 ) );
+
+    for( n=1; n<=iPoints; n++ )
+        pppShadowIonFrac[n] = ppIonFracSP[n]->pShadow->ppGetIonFrac();
+
+    pShadow->InterpolateAllIonFrac( x, pppShadowIonFrac, iPoints, s );
+}
+}
+
+void CIonFracSP::ResetAllIonFrac( double flog_10T )
+{
+double *pni;
+int i;
+
+// The scratch space is allocated once and used for each element in turn
+pni = (double*)alloca( sizeof(double) * TotalNumIons );
+
+for( i=0; i<NumElements; i++ )
+{
+    // Get the equilibrium ionisation fractions
+    pRadiation->GetEquilIonFrac( pZ[i], pni, flog_10T );
+
+    StoreElement( i, pni );
+}
+
+if( pShadow )
+    pShadow->ResetAllIonFrac( flog_10T );
+}
+
+void CIonFracSP::ResetAllIonFrac( double flog_10T, double flog_10n )
+{
+double *pni;
+int i;
+
+// The scratch space is allocated once and used for each element in turn
+pni = (double*)alloca( sizeof(double) * TotalNumIons );
+
+for( i=0; i<NumElements; i++ )
+{
+    // Get the equilibrium ionisation fractions
+    pRadiation->GetEquilIonFrac( pZ[i], pni, flog_10T, flog_10n );
+
+    StoreElement( i, pni );
+}
+
+if( pShadow )
+    pShadow->ResetAllIonFrac( flog_10T, flog_10n );
+}
+
+void CIonFracSP::WriteAllIonFracToFile( void *pFile )
+{
+int i, j;
+
+for( i=0; i<NumElements; i++ )
+{
+    fprintf( (FILE*)pFile, "\n%i", pZ[i] );
+
+    for( j=0; j<=pZ[i]; j++ )
+        fprintf( (FILE*)pFile, "\t%.8e", (double)ppIonFrac[i][j] );
+}
+
+fprintf( (FILE*)pFile, "\n" );
+}
+
+void CIonFracSP::ReadAllIonFracFromFile( void *pFile )
+{
+double fTemp, **ppShadowIonFrac = NULL;
+int i, j;
+
+if( pShadow )
+    ppShadowIonFrac = pShadow->ppGetIonFrac();
+
+for( i=0; i<NumElements; i++ )
+{
+    fscanf( (FILE*)pFile, "%i", &(pZ[i]) );
+
+    for( j=0; j<=pZ[i]; j++ )
+    {
+        ReadDouble( (FILE*)pFile, &fTemp );
+        ppIonFrac[i][j] = (float)fTemp;
+
+        // The shadow restarts from the values read
+        if( ppShadowIonFrac )
+            ppShadowIonFrac[i][j] = fTemp;
+    }
+}
+}
+
+void CIonFracSP::GetDrift( double *pfMaxAbsDrift, double *pfMaxRelDrift )
+{
+double **ppShadowIonFrac, fDrift;
+int i, j;
+
+*pfMaxAbsDrift = 0.0;
+*pfMaxRelDrift = 0.0;
+
+if( !pShadow ) return;
+
+ppShadowIonFrac = pShadow->ppGetIonFrac();
+
+for( i=0; i<NumElements; i++ )
+    for( j=0; j<=pZ[i]; j++ )
+    {
+        fDrift = fabs( (double)ppIonFrac[i][j] - ppShadowIonFrac[i][j] );
+
+        if( fDrift > *pfMaxAbsDrift )
+            *pfMaxAbsDrift = fDrift;
+
+        if( ppShadowIonFrac[i][j] > 0.0 && fDrift / ppShadowIonFrac[i][j] > *pfMaxRelDrift )
+            *pfMaxRelDrift = fDrift / ppShadowIonFrac[i][j];
+    }
+}
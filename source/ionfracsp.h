@@ -0,0 +1,176 @@
+#ifndef IONFRACSP_H
+#define IONFRACSP_H
+
+#include "ionfrac.h"
+
+// Single-precision ionization fraction class
+//
+// Class for holding the transported non-equilibrium ionization state of a cell in single
+// precision, halving the memory (and the memory traffic of copying, remapping and writing
+// it) compared with <CIonFrac>. Only the stored ion population fractions and their rates of
+// change are single precision: the rates of change, integration and normalisation are all
+// calculated in double precision and the result is rounded once when it is stored. Ion
+// population fractions below the cut-off are stored as exact zeros, as in <CIonFrac>.
+//
+// In validation mode a double-precision <CIonFrac> shadow is carried through every operation
+// alongside the single-precision state, so that the drift between the two can be measured.
+//
+class CIonFracSP {
+
+  private:
+
+  	/* Pointer to a radiation object */
+    PRADIATION pRadiation;
+
+  	/*- Threshold below which ion populations are set to zero */
+  	double cutoff_ion_fraction;
+
+    /*- Pointer to an array of pointers containing the fractional populations of the ions for each element */
+    float **ppIonFrac;
+
+  	/*- Pointer to an array of pointers containing the rate of change with respect to time of the fractional population of the ions for each element */
+    float **ppdnibydt;
+
+    /*- Total number of ions of all elements */
+    int TotalNumIons;
+
+    /*- Double-precision shadow of the ion populations used in validation mode (NULL otherwise) */
+    PIONFRAC pShadow;
+
+    /*- Free all memory allocated by object */
+    void FreeAll( void );
+
+    /*- Expand the ion populations of the i'th element into double precision and normalise them */
+    void Expand( int i, double *pni );
+
+    /*- Store double-precision ion populations of the i'th element, applying the cut-off */
+    void StoreElement( int i, double *pni );
+
+  public:
+
+  	// Default constructor
+    // @pIonFrac instance of <CIonFrac> class used to initialise the object
+    // @pRadiationObj instance of <PRADIATION>
+    // @bValidate if True, carry a double-precision shadow to measure the drift
+    //
+    CIonFracSP( CIonFrac *pIonFrac, PRADIATION pRadiationObj, bool bValidate );
+
+    /* Destructor */
+    ~CIonFracSP( void );
+
+    /* Number of elements for which ion population fractions are available */
+    int NumElements;
+
+	  /* Pointer to an array containing each element's atomic number.*/
+    int *pZ;
+
+    // Return pointer to arrays of all ion population fractions
+    //
+    // @return pointer to array of pointers of single-precision ion population fractions
+    //
+    float** ppGetIonFrac( void );
+
+    // Return pointer to arrays of all ion population fraction rates of change
+    //
+    // @return pointer to array of pointers of single-precision rates of change
+    //
+    float** ppGetdnibydt( void );
+
+    // Store the ion population fractions in single precision
+    // @pIonFrac pointer to instance of <CIonFrac> class
+    //
+    // Round the ion population fractions and their rates of change held by
+    // <pIonFrac> to single precision and store them.
+    //
+    void Store( CIonFrac *pIonFrac );
+
+    // Load the ion population fractions into double precision
+    // @pIonFrac pointer to instance of <CIonFrac> class
+    //
+    // Expand the stored ion population fractions and rates of change into
+    // <pIonFrac> and normalise the sum total of the ion population fractions
+    // of each element to 1 in double precision.
+    //
+    void Load( CIonFrac *pIonFrac );
+
+    // Calculate the ion population fraction rates of change for all elements
+    // @flog_10T log base 10 of temperature (in K)
+    // @flog_10n log base 10 of density (in cm^-3)
+    // @pTimeScale smallest characteristic time-scale of all elements
+    //
+    // Calculate the rates of change in double precision from the stored ion
+    // population fractions (see <CRadiation::GetAlldnibydt>) and store them.
+    //
+    void GetAlldnibydt( double flog_10T, double flog_10n, double *pTimeScale );
+
+  	// Integrate ion fraction rates of change for all elements
+  	// @delta_t current time step
+  	//
+  	// Integrate the dnibydt term in double precision, set the ion population
+  	// fractions below the cut-off to zero and normalise the sum to one before
+  	// storing the result.
+  	//
+    void IntegrateAllIonFrac( double delta_t );
+
+  	// Overwrite ion population fractions for all elements
+    // @pIonFrac pointer to instance of <CIonFracSP> class
+  	//
+    void CopyAllIonFrac( CIonFracSP *pIonFrac );
+
+  	// Overwrite rate of change for all elements
+  	// @pIonFrac pointer to instance of <CIonFracSP> class
+  	//
+    void CopyAlldnibydt( CIonFracSP *pIonFrac );
+
+  	// Interpolate ion population fractions for all elements
+  	// @x coordinates at which ion population fractions are evaluated
+  	// @ppIonFracSP pointer to array of <CIonFracSP> objects at <x> (one-based, as <x>)
+  	// @iPoints number of points to perform interpolation over
+  	// @s coordinate to interpolate to
+  	//
+  	// As <CIonFrac::InterpolateAllIonFrac>, with the interpolation weights
+  	// calculated once for all of the ions and the blend made in double precision.
+  	// At most four points are used; three points give a quadratic.
+  	// In validation mode the shadow is interpolated from the shadows of the points;
+  	// if any point has none, a warning is printed and validation mode is dropped.
+  	//
+    void InterpolateAllIonFrac( double *x, CIonFracSP **ppIonFracSP, int iPoints, double s );
+
+    // Reset fractional population of all elements
+    // @flog_10T log base 10 of temperature (in K)
+    // @flog_10n log base 10 of density (in cm^-3)
+    //
+    // Reset fractional population of all elements to their equilibrium
+    // values for a given temperature <flog_10T> (and density <flog_10n>).
+    //
+    void ResetAllIonFrac( double flog_10T );
+    void ResetAllIonFrac( double flog_10T, double flog_10n );
+
+    // Write all ion fractions to file
+    // @pFile file stream object for writing ion fractions
+	  //
+    // Same format as <CIonFrac::WriteAllIonFracToFile>.
+    //
+    void WriteAllIonFracToFile( void *pFile );
+
+  	// Read all ion population fractions
+  	// @pFile filestream object for reading ion population fractions
+  	//
+  	// Same format as <CIonFrac::ReadAllIonFracFromFile>.
+  	//
+    void ReadAllIonFracFromFile( void *pFile );
+
+    // Measure the drift from the double-precision path
+    // @pfMaxAbsDrift largest absolute difference of any ion population fraction
+    // @pfMaxRelDrift largest difference relative to the double-precision ion population fraction
+    //
+    // In validation mode, compare the stored ion population fractions with the
+    // double-precision shadow. Both drifts are zero if validation is not enabled.
+    //
+    void GetDrift( double *pfMaxAbsDrift, double *pfMaxRelDrift );
+
+};
+
+typedef CIonFracSP* PIONFRACSP;
+
+#endif
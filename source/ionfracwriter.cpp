@@ -0,0 +1,329 @@
+// ****
+// *
+// * Asynchronous Ion Population Output Writer Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "ionfracwriter.h"
+
+
+CIonFracWriter::CIonFracWriter( int iMaxNumCells, int iNumElements, int *pAtomicNumber )
+{
+int i;
+
+MaxNumCells = iMaxNumCells;
+NumElements = iNumElements;
+
+pZ = (int*)malloc( sizeof(int) * NumElements );
+
+TotalNumIons = 0;
+for( i=0; i<NumElements; i++ )
+{
+    pZ[i] = pAtomicNumber[i];
+    TotalNumIons += pZ[i] + 1;
+}
+
+// Each buffer can hold the ion population fractions and their rates of change for every cell
+for( i=0; i<IONFRACWRITER_NUM_BUFFERS; i++ )
+{
+    Buffer[i].px = (double*)malloc( sizeof(double) * MaxNumCells );
+    Buffer[i].pValues = (double*)malloc( sizeof(double) * 2 * MaxNumCells * TotalNumIons );
+    Buffer[i].bFull = false;
+}
+
+iNextFill = 0;
+iNextWrite = 0;
+NumFailed = 0;
+bFinish = false;
+
+pthread_mutex_init( &Mutex, NULL );
+pthread_cond_init( &BufferFull, NULL );
+pthread_cond_init( &BufferFree, NULL );
+
+// If the writer thread cannot be started then each snapshot is written as it is queued
+bThread = !pthread_create( &Thread, NULL, WriterThread, this );
+if( !bThread )
+    printf( "Warning: failed to start the ion population writer thread. Snapshots will be written synchronously.\n" );
+}
+
+CIonFracWriter::~CIonFracWriter( void )
+{
+int i;
+
+// Write any queued snapshots and stop the writer thread
+Flush();
+
+if( bThread )
+{
+    pthread_mutex_lock( &Mutex );
+    bFinish = true;
+    pthread_cond_signal( &BufferFull );
+    pthread_mutex_unlock( &Mutex );
+
+    pthread_join( Thread, NULL );
+}
+
+pthread_cond_destroy( &BufferFree );
+pthread_cond_destroy( &BufferFull );
+pthread_mutex_destroy( &Mutex );
+
+for( i=0; i<IONFRACWRITER_NUM_BUFFERS; i++ )
+{
+    free( Buffer[i].pValues );
+    free( Buffer[i].px );
+}
+
+free( pZ );
+}
+
+void* CIonFracWriter::WriterThread( void *pWriter )
+{
+CIonFracWriter *pThis = (CIonFracWriter*)pWriter;
+IONFRACWRITERBUFFER *pBuffer;
+bool bSuccess;
+
+for( ;; )
+{
+    pthread_mutex_lock( &pThis->Mutex );
+
+    // Wait for the next buffer to be filled
+    while( !pThis->Buffer[pThis->iNextWrite].bFull && !pThis->bFinish )
+        pthread_cond_wait( &pThis->BufferFull, &pThis->Mutex );
+
+    if( !pThis->Buffer[pThis->iNextWrite].bFull )
+    {
+        pthread_mutex_unlock( &pThis->Mutex );
+        break;
+    }
+
+    pBuffer = &(pThis->Buffer[pThis->iNextWrite]);
+
+    pthread_mutex_unlock( &pThis->Mutex );
+
+    // Write the snapshot without holding the lock
+    bSuccess = pThis->WriteBuffer( pBuffer );
+
+    pthread_mutex_lock( &pThis->Mutex );
+
+    if( !bSuccess ) pThis->NumFailed++;
+
+    pBuffer->bFull = false;
+    pThis->iNextWrite = ( pThis->iNextWrite + 1 ) % IONFRACWRITER_NUM_BUFFERS;
+    pthread_cond_broadcast( &pThis->BufferFree );
+
+    pthread_mutex_unlock( &pThis->Mutex );
+}
+
+return NULL;
+}
+
+bool CIonFracWriter::WriteBuffer( IONFRACWRITERBUFFER *pBuffer )
+{
+FILE *pFile;
+double *pValue;
+int c, i, j, iNumBlocks;
+bool bSuccess = true;
+
+if( pBuffer->iFormat == IONFRACWRITER_BINARY )
+{
+    pFile = fopen( pBuffer->szFilename, "wb" );
+    if( !pFile )
+    {
+        printf( "Failed to open ion population file %s.\n", pBuffer->szFilename );
+        return false;
+    }
+
+    iNumBlocks = ( pBuffer->iFlags & IONFRAC_FILE_DNIBYDT ) ? 2 : 1;
+
+    bSuccess = CIonFrac::WriteBinaryFileHeader( pFile, pBuffer->iNumCells, NumElements, pZ, TotalNumIons, pBuffer->iFlags );
+    bSuccess = bSuccess && fwrite( pBuffer->pValues, sizeof(double) * TotalNumIons, iNumBlocks * pBuffer->iNumCells, pFile ) == (size_t)( iNumBlocks * pBuffer->iNumCells );
+}
+else
+{
+    pFile = fopen( pBuffer->szFilename, "w" );
+    if( !pFile )
+    {
+        printf( "Failed to open ion population file %s.\n", pBuffer->szFilename );
+        return false;
+    }
+
+    pValue = pBuffer->pValues;
+
+    for( c=0; c<pBuffer->iNumCells; c++ )
+    {
+        if( pBuffer->iFlags & IONFRACWRITER_WRITE_X )
+            fprintf( pFile, "%.8e", pBuffer->px[c] );
+
+        // Same format as CIonFrac::WriteAllIonFracToFile
+        for( i=0; i<NumElements; i++ )
+        {
+            fprintf( pFile, "\n%i", pZ[i] );
+
+            for( j=0; j<=pZ[i]; j++ )
+                fprintf( pFile, "\t%.8e", *(pValue++) );
+        }
+
+        fprintf( pFile, "\n" );
+    }
+}
+
+if( fclose( pFile ) ) bSuccess = false;
+
+if( !bSuccess ) printf( "Failed to write ion population file %s.\n", pBuffer->szFilename );
+
+return bSuccess;
+}
+
+IONFRACWRITERBUFFER* CIonFracWriter::pGetFreeBuffer( char *szFilename, int iNumCells, int iFormat, bool bWritednibydt )
+{
+IONFRACWRITERBUFFER *pBuffer;
+
+pthread_mutex_lock( &Mutex );
+
+// Wait for the writer thread to finish with the buffer
+while( Buffer[iNextFill].bFull )
+    pthread_cond_wait( &BufferFree, &Mutex );
+
+pthread_mutex_unlock( &Mutex );
+
+pBuffer = &(Buffer[iNextFill]);
+
+strncpy( pBuffer->szFilename, szFilename, sizeof(pBuffer->szFilename) - 1 );
+pBuffer->szFilename[sizeof(pBuffer->szFilename)-1] = 0;
+pBuffer->iFormat = iFormat;
+pBuffer->iNumCells = iNumCells;
+pBuffer->iFlags = 0;
+
+// The rates of change are only written in the binary format
+if( bWritednibydt && iFormat == IONFRACWRITER_BINARY )
+    pBuffer->iFlags |= IONFRAC_FILE_DNIBYDT;
+
+return pBuffer;
+}
+
+void CIonFracWriter::QueueBuffer( void )
+{
+// Without a writer thread the buffer is written here and is free again on return
+if( !bThread )
+{
+    if( !WriteBuffer( &(Buffer[iNextFill]) ) ) NumFailed++;
+
+    iNextFill = ( iNextFill + 1 ) % IONFRACWRITER_NUM_BUFFERS;
+    iNextWrite = iNextFill;
+
+    return;
+}
+
+pthread_mutex_lock( &Mutex );
+
+Buffer[iNextFill].bFull = true;
+iNextFill = ( iNextFill + 1 ) % IONFRACWRITER_NUM_BUFFERS;
+pthread_cond_signal( &BufferFull );
+
+pthread_mutex_unlock( &Mutex );
+}
+
+void CIonFracWriter::Snapshot( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj, double *px, int iFormat, bool bWritednibydt )
+{
+IONFRACWRITERBUFFER *pBuffer;
+double *pValue, **ppni;
+int c, i, k, iNumBlocks;
+
+if( iNumCells > MaxNumCells )
+{
+    printf( "Ion population snapshot of %i cells exceeds the writer capacity of %i cells.\n", iNumCells, MaxNumCells );
+    return;
+}
+
+pBuffer = pGetFreeBuffer( szFilename, iNumCells, iFormat, bWritednibydt );
+
+if( px && iFormat == IONFRACWRITER_TEXT )
+{
+    memcpy( pBuffer->px, px, sizeof(double) * iNumCells );
+    pBuffer->iFlags |= IONFRACWRITER_WRITE_X;
+}
+
+iNumBlocks = ( pBuffer->iFlags & IONFRAC_FILE_DNIBYDT ) ? 2 : 1;
+
+pValue = pBuffer->pValues;
+for( k=0; k<iNumBlocks; k++ )
+    for( c=0; c<iNumCells; c++ )
+    {
+        ppni = k ? ppIonFracObj[c]->ppGetdnibydt() : ppIonFracObj[c]->ppGetIonFrac();
+
+        for( i=0; i<NumElements; i++ )
+        {
+            memcpy( pValue, ppni[i], sizeof(double) * ( pZ[i] + 1 ) );
+            pValue += pZ[i] + 1;
+        }
+    }
+
+QueueBuffer();
+}
+
+void CIonFracWriter::Snapshot( char *szFilename, CIonFracGrid *pIonFracGrid, double *px, int iFormat, bool bWritednibydt )
+{
+IONFRACWRITERBUFFER *pBuffer;
+double *pValue, *pBlock;
+int c, k, iNumCells, iCellStride, iNumBlocks;
+
+iNumCells = pIonFracGrid->NumCells;
+
+if( iNumCells > MaxNumCells )
+{
+    printf( "Ion population snapshot of %i cells exceeds the writer capacity of %i cells.\n", iNumCells, MaxNumCells );
+    return;
+}
+
+pBuffer = pGetFreeBuffer( szFilename, iNumCells, iFormat, bWritednibydt );
+
+if( px && iFormat == IONFRACWRITER_TEXT )
+{
+    memcpy( pBuffer->px, px, sizeof(double) * iNumCells );
+    pBuffer->iFlags |= IONFRACWRITER_WRITE_X;
+}
+
+iNumBlocks = ( pBuffer->iFlags & IONFRAC_FILE_DNIBYDT ) ? 2 : 1;
+iCellStride = pIonFracGrid->GetCellStride();
+
+// The elements are held in the same order and contiguously within each cell of the grid
+pValue = pBuffer->pValues;
+for( k=0; k<iNumBlocks; k++ )
+{
+    pBlock = k ? pIonFracGrid->pGetdnibydt() : pIonFracGrid->pGetIonFrac();
+
+    for( c=0; c<iNumCells; c++ )
+    {
+        memcpy( pValue, pBlock + (size_t)c * iCellStride, sizeof(double) * TotalNumIons );
+        pValue += TotalNumIons;
+    }
+}
+
+QueueBuffer();
+}
+
+int CIonFracWriter::Flush( void )
+{
+int iNumFailed;
+
+pthread_mutex_lock( &Mutex );
+
+// Wait for the writer thread to write every queued buffer
+while( Buffer[iNextWrite].bFull )
+    pthread_cond_wait( &BufferFree, &Mutex );
+
+iNumFailed = NumFailed;
+NumFailed = 0;
+
+pthread_mutex_unlock( &Mutex );
+
+return iNumFailed;
+}
@@ -0,0 +1,148 @@
+#ifndef IONFRACWRITER_H
+#define IONFRACWRITER_H
+
+#include <pthread.h>
+
+#include "ionfracgrid.h"
+
+// Number of snapshot buffers held by the writer
+#define IONFRACWRITER_NUM_BUFFERS 2
+
+// Output formats
+#define IONFRACWRITER_TEXT 0	// As <CIonFrac::WriteAllIonFracToFile>, one cell after another
+#define IONFRACWRITER_BINARY 1	// As <CIonFrac::WriteGridToBinaryFile>
+
+// Buffer flag (in addition to the IONFRAC_FILE flags) set when a coordinate is written before each cell
+#define IONFRACWRITER_WRITE_X 256
+
+// Snapshot buffer of the ion population output writer
+typedef struct {
+    /* Output filename */
+    char szFilename[256];
+    /* Output format */
+    int iFormat;
+    /* Combination of IONFRAC_FILE flags */
+    int iFlags;
+    /* Number of cells held */
+    int iNumCells;
+    /* Coordinate of each cell written before its ions in the text format (if present) */
+    double *px;
+    /* Ion population fractions (and their rates of change) of every cell */
+    double *pValues;
+    /* True while the snapshot is waiting to be written or being written */
+    bool bFull;
+} IONFRACWRITERBUFFER;
+
+// Asynchronous ion population output writer
+//
+// Class for writing the ion population fractions of a grid without stalling the
+// calculation. Each call to <Snapshot> copies the ion population fractions into one of
+// <IONFRACWRITER_NUM_BUFFERS> buffers and returns; a background thread formats and writes
+// the buffers in the order they were filled while the integration continues. The memory
+// used is bounded by the buffers: if every buffer is still waiting to be written then
+// <Snapshot> waits for the oldest one to be written first. If the writer thread cannot be
+// started, a warning is printed and each snapshot is written before <Snapshot> returns.
+//
+// The writer uses POSIX threads, so programs using it must be compiled and linked with
+// -pthread.
+//
+class CIonFracWriter {
+
+  private:
+
+    /*- Snapshot buffers */
+    IONFRACWRITERBUFFER Buffer[IONFRACWRITER_NUM_BUFFERS];
+
+    /*- Maximum number of cells held by each buffer */
+    int MaxNumCells;
+
+    /*- Total number of ions of all elements */
+    int TotalNumIons;
+
+    /*- Index of the next buffer to be filled */
+    int iNextFill;
+
+    /*- Index of the next buffer to be written */
+    int iNextWrite;
+
+    /*- Number of snapshots that could not be written */
+    int NumFailed;
+
+    /*- True when the writer thread should finish */
+    bool bFinish;
+
+    /*- True if the writer thread is running (otherwise snapshots are written synchronously) */
+    bool bThread;
+
+    /*- Writer thread, the lock protecting the buffer states and its conditions */
+    pthread_t Thread;
+    pthread_mutex_t Mutex;
+    pthread_cond_t BufferFull;
+    pthread_cond_t BufferFree;
+
+    /*- Writer thread entry point */
+    static void* WriterThread( void *pWriter );
+
+    /*- Write the snapshot held in a buffer */
+    bool WriteBuffer( IONFRACWRITERBUFFER *pBuffer );
+
+    /*- Wait for a free buffer and return it */
+    IONFRACWRITERBUFFER* pGetFreeBuffer( char *szFilename, int iNumCells, int iFormat, bool bWritednibydt );
+
+    /*- Pass a filled buffer to the writer thread */
+    void QueueBuffer( void );
+
+  public:
+
+  	// Default constructor
+    // @iMaxNumCells largest number of cells in any snapshot
+    // @iNumElements number of elements
+    // @pAtomicNumber atomic numbers of the elements
+    //
+    CIonFracWriter( int iMaxNumCells, int iNumElements, int *pAtomicNumber );
+
+    /* Destructor */
+    ~CIonFracWriter( void );
+
+    /* Number of elements */
+    int NumElements;
+
+	  /* Pointer to an array containing each element's atomic number.*/
+    int *pZ;
+
+    // Snapshot a set of cells for writing
+    // @szFilename output filename
+    // @iNumCells number of cells
+    // @ppIonFracObj pointer to array of <CIonFrac> objects, one for each cell
+    // @px coordinate of each cell, written before its ions in the text format (may be NULL)
+    // @iFormat <IONFRACWRITER_TEXT> or <IONFRACWRITER_BINARY>
+    // @bWritednibydt if True, also write the rates of change (binary format only)
+    //
+    // Copy the ion population fractions into a free buffer and queue it to be
+    // written, waiting for a buffer to be written first if none is free. The
+    // objects may be changed as soon as the function returns.
+    //
+    void Snapshot( char *szFilename, int iNumCells, CIonFrac **ppIonFracObj, double *px, int iFormat, bool bWritednibydt );
+
+    // Snapshot a grid for writing
+    // @szFilename output filename
+    // @pIonFracGrid pointer to instance of <CIonFracGrid> class
+    // @px coordinate of each cell, written before its ions in the text format (may be NULL)
+    // @iFormat <IONFRACWRITER_TEXT> or <IONFRACWRITER_BINARY>
+    // @bWritednibydt if True, also write the rates of change (binary format only)
+    //
+    // As above, copying the ions of every cell out of the grid's blocks.
+    //
+    void Snapshot( char *szFilename, CIonFracGrid *pIonFracGrid, double *px, int iFormat, bool bWritednibydt );
+
+    // Wait until every queued snapshot has been written
+    //
+    // @return number of snapshots that could not be written since the last call
+    //
+    int Flush( void );
+
+};
+
+typedef CIonFracWriter* PIONFRACWRITER;
+
+#endif
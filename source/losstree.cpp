@@ -0,0 +1,237 @@
+// ****
+// *
+// * Adaptive Loss Function Table Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "losstree.h"
+#include "interp.h"
+#include "../../rsp_toolkit/source/fitpoly.h"
+#include "../../rsp_toolkit/source/constants.h"
+
+
+CLossTree::CLossTree( double *pTempValues, int iNumTemp, double *pDenValues, int iNumDen, double *pValues, double fTolerance )
+{
+double fMaxValue, fTempWidth, fDenWidth;
+int i, j;
+
+pTemp = pTempValues;
+pDen = pDenValues;
+pValue = pValues;
+NumTemp = iNumTemp;
+NumDen = iNumDen;
+
+fTemp0 = pTemp[0];
+fInvTempRange = 1.0 / ( pTemp[NumTemp-1] - pTemp[0] );
+fDen0 = pDen[0];
+fInvDenRange = 1.0 / ( pDen[NumDen-1] - pDen[0] );
+
+// The relative error is not measured for values much smaller than the largest
+fMaxValue = 0.0;
+for( i=0; i<NumTemp*NumDen; i++ )
+    if( pValue[i] > fMaxValue )
+        fMaxValue = pValue[i];
+fFloor = 1E-6 * fMaxValue;
+
+// The root grid has a power of two cells along each side, each no larger than the average tabulated spacing
+RootNumTemp = RootNumDen = 1;
+while( RootNumTemp < NumTemp - 1 ) RootNumTemp *= 2;
+while( RootNumDen < NumDen - 1 ) RootNumDen *= 2;
+
+fTempWidth = ( pTemp[NumTemp-1] - pTemp[0] ) / RootNumTemp;
+fDenWidth = ( pDen[NumDen-1] - pDen[0] ) / RootNumDen;
+
+NumNodes = RootNumTemp * RootNumDen;
+MaxNodes = 2 * NumNodes;
+MaxPatches = NumNodes;
+pNode = (int*)malloc( sizeof(int) * MaxNodes );
+pPatch = (double*)malloc( sizeof(double) * 4 * MaxPatches );
+
+NumPatches = 0;
+fMaxError = 0.0;
+
+// Refine each cell of the root grid
+for( j=0; j<RootNumDen; j++ )
+    for( i=0; i<RootNumTemp; i++ )
+        Refine( j * RootNumTemp + i, pTemp[0] + i * fTempWidth, pTemp[0] + ( i + 1 ) * fTempWidth, pDen[0] + j * fDenWidth, pDen[0] + ( j + 1 ) * fDenWidth, 0, fTolerance );
+
+// Release the unused space
+pNode = (int*)realloc( pNode, sizeof(int) * NumNodes );
+pPatch = (double*)realloc( pPatch, sizeof(double) * 4 * NumPatches );
+
+// The table is not held after construction
+pTemp = pDen = pValue = NULL;
+}
+
+CLossTree::~CLossTree( void )
+{
+FreeAll();
+}
+
+void CLossTree::FreeAll( void )
+{
+free( pNode );
+free( pPatch );
+}
+
+double CLossTree::GetTableValue( double flog_10T, double flog_10n )
+{
+double x[4], wT[4], wn[4], *pfTemp, result = 0.0;
+int j, k, l, m;
+
+// Select the four temperature and four density values surrounding the desired ones
+j = LocateStencil( pTemp, NumTemp, &flog_10T );
+k = LocateStencil( pDen, NumDen, &flog_10n );
+
+for( l=0; l<4; l++ )
+    x[l] = pTemp[j+l-2];
+GetLagrangeWeights( x, 4, flog_10T, wT, NULL );
+
+for( l=0; l<4; l++ )
+    x[l] = pDen[k+l-2];
+GetLagrangeWeights( x, 4, flog_10n, wn, NULL );
+
+for( l=0; l<4; l++ )
+{
+    pfTemp = pValue + ( k + l - 2 ) * NumTemp + j - 2;
+
+    for( m=0; m<4; m++ )
+        result += wT[m] * wn[l] * pfTemp[m];
+}
+
+// Check the value is physically realistic
+if( result < 0.0 ) result = 0.0;
+
+return result;
+}
+
+void CLossTree::Refine( int iNode, double fT0, double fT1, double fn0, double fn1, int iDepth, double fTolerance )
+{
+double corner[4], u, v, fApprox, fExact, fError, fPatchError, fTm, fnm;
+int i, j, iChild;
+
+// Natural logarithm of the values at the corners of the patch; values of zero are represented by a value far below the floor
+corner[0] = log( max( GetTableValue( fT0, fn0 ), 1E-24 * fFloor ) );
+corner[1] = log( max( GetTableValue( fT1, fn0 ), 1E-24 * fFloor ) );
+corner[2] = log( max( GetTableValue( fT0, fn1 ), 1E-24 * fFloor ) );
+corner[3] = log( max( GetTableValue( fT1, fn1 ), 1E-24 * fFloor ) );
+
+// Measure the error of the bilinear interpolation at the test points
+fPatchError = 0.0;
+for( j=0; j<LOSSTREE_TEST_POINTS; j++ )
+    for( i=0; i<LOSSTREE_TEST_POINTS; i++ )
+    {
+        u = (double)i / ( LOSSTREE_TEST_POINTS - 1 );
+        v = (double)j / ( LOSSTREE_TEST_POINTS - 1 );
+
+        fApprox = exp( ( 1.0 - v ) * ( ( 1.0 - u ) * corner[0] + u * corner[1] ) + v * ( ( 1.0 - u ) * corner[2] + u * corner[3] ) );
+        fExact = GetTableValue( fT0 + u * ( fT1 - fT0 ), fn0 + v * ( fn1 - fn0 ) );
+
+        fError = fabs( fApprox - fExact ) / max( fExact, fFloor );
+        if( fError > fPatchError )
+            fPatchError = fError;
+    }
+
+if( fPatchError > fTolerance && iDepth < LOSSTREE_MAX_DEPTH )
+{
+    // Add the four children of the node
+    if( NumNodes + 4 > MaxNodes )
+    {
+        MaxNodes *= 2;
+        pNode = (int*)realloc( pNode, sizeof(int) * MaxNodes );
+    }
+
+    iChild = NumNodes;
+    NumNodes += 4;
+    pNode[iNode] = iChild;
+
+    fTm = 0.5 * ( fT0 + fT1 );
+    fnm = 0.5 * ( fn0 + fn1 );
+
+    Refine( iChild, fT0, fTm, fn0, fnm, iDepth + 1, fTolerance );
+    Refine( iChild + 1, fTm, fT1, fn0, fnm, iDepth + 1, fTolerance );
+    Refine( iChild + 2, fT0, fTm, fnm, fn1, iDepth + 1, fTolerance );
+    Refine( iChild + 3, fTm, fT1, fnm, fn1, iDepth + 1, fTolerance );
+
+    return;
+}
+
+// The node is a leaf: store its patch
+if( NumPatches == MaxPatches )
+{
+    MaxPatches *= 2;
+    pPatch = (double*)realloc( pPatch, sizeof(double) * 4 * MaxPatches );
+}
+
+for( i=0; i<4; i++ )
+    pPatch[4*NumPatches+i] = corner[i];
+
+pNode[iNode] = - ( NumPatches + 1 );
+NumPatches++;
+
+if( fPatchError > fMaxError )
+    fMaxError = fPatchError;
+}
+
+double CLossTree::GetValue( double flog_10T, double flog_10n )
+{
+double u, v, *pCorner;
+int iNode, iChild, iu, iv;
+
+// Normalise the coordinates to the tabulated ranges, setting them to the appropriate limit if they are out of range
+u = ( flog_10T - fTemp0 ) * fInvTempRange;
+v = ( flog_10n - fDen0 ) * fInvDenRange;
+
+if( u < 0.0 ) u = 0.0;
+else if( u > 1.0 ) u = 1.0;
+if( v < 0.0 ) v = 0.0;
+else if( v > 1.0 ) v = 1.0;
+
+// Select the cell of the root grid containing the point directly and rescale the coordinates to it
+u *= RootNumTemp;
+v *= RootNumDen;
+iu = (int)u;
+iv = (int)v;
+if( iu == RootNumTemp ) iu--;
+if( iv == RootNumDen ) iv--;
+u -= iu;
+v -= iv;
+
+// Descend the tree, selecting the child containing the point and rescaling the coordinates to it
+iNode = iv * RootNumTemp + iu;
+while( ( iChild = pNode[iNode] ) >= 0 )
+{
+    u += u;
+    v += v;
+    iNode = iChild;
+
+    if( u >= 1.0 )
+    {
+        u -= 1.0;
+        iNode += 1;
+    }
+    if( v >= 1.0 )
+    {
+        v -= 1.0;
+        iNode += 2;
+    }
+}
+
+// Blend the corners of the patch
+pCorner = pPatch + 4 * ( - iChild - 1 );
+
+return exp( ( 1.0 - v ) * ( ( 1.0 - u ) * pCorner[0] + u * pCorner[1] ) + v * ( ( 1.0 - u ) * pCorner[2] + u * pCorner[3] ) );
+}
+
+void CLossTree::GetStats( double *pfMaxError, long *plSize, int *piNumPatches )
+{
+*pfMaxError = fMaxError;
+*plSize = (long)( sizeof(int) * NumNodes + sizeof(double) * 4 * NumPatches );
+*piNumPatches = NumPatches;
+}
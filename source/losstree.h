@@ -0,0 +1,97 @@
+#ifndef LOSSTREE_H
+#define LOSSTREE_H
+
+// Deepest level below the root grid to which the patches of a loss tree are refined
+#define LOSSTREE_MAX_DEPTH 12
+
+// Number of test points along each side of a patch at which its error is measured
+#define LOSSTREE_TEST_POINTS 5
+
+// Adaptive loss function table class
+//
+// Class for holding a piecewise bilinear representation of the logarithm of a quantity tabulated
+// on a 2D grid of log_10 T and log_10 n values (the total phi( n, T ) of <CRadiation>), so that it can
+// be looked up without a stencil search or a 4x4 polynomial. The tabulated range is divided into
+// a uniform root grid of cells no larger than the average tabulated spacing, and each cell into a
+// quadtree of patches. A patch is refined into four until exp( bilinear interpolation of ln phi
+// between the patch corners ) is within the requested relative error of the 4x4 polynomial
+// interpolation of the table at a grid of test points across the patch.
+//
+// A look-up indexes the root grid directly, descends the cell's tree by doubling the coordinates
+// within the cell at each level and then blends the four corner values of the patch reached.
+//
+class CLossTree {
+
+  private:
+
+    /*- Lower limits and reciprocal widths of the tabulated log_10 T and log_10 n ranges */
+    double fTemp0, fInvTempRange, fDen0, fInvDenRange;
+
+    /*- Number of cells of the root grid along the temperature and density axes (powers of two) */
+    int RootNumTemp, RootNumDen;
+
+    /*- Node list, starting with the cells of the root grid (cell i, j at j * RootNumTemp + i): the index of
+        a node's first child (its four children are consecutive, ordered by temperature and then density)
+        or -( patch index + 1 ) for a leaf */
+    int *pNode;
+
+    /*- Natural logarithm of the values at the four corners of each patch (ordered as the children) */
+    double *pPatch;
+
+    /*- Number of nodes and patches held, and number allocated */
+    int NumNodes, NumPatches, MaxNodes, MaxPatches;
+
+    /*- Largest relative error found at the test points of the patches */
+    double fMaxError;
+
+    /*- Table being represented and the values below which the relative error is not measured */
+    double *pTemp, *pDen, *pValue, fFloor;
+    int NumTemp, NumDen;
+
+    /*- Interpolate the table at a specified temperature and density with the 4x4 polynomial */
+    double GetTableValue( double flog_10T, double flog_10n );
+
+    /*- Refine the node <iNode> covering the given range of log_10 T and log_10 n */
+    void Refine( int iNode, double fT0, double fT1, double fn0, double fn1, int iDepth, double fTolerance );
+
+    /*- Free all memory allocated by object */
+    void FreeAll( void );
+
+  public:
+
+    // Default constructor
+    // @pTempValues log_10 T values of the table
+    // @iNumTemp number of temperature values
+    // @pDenValues log_10 n values of the table
+    // @iNumDen number of density values
+    // @pValues tabulated values, the value at the j'th temperature and k'th density held at pValues[ k * iNumTemp + j ]
+    // @fTolerance largest relative error of the patches against the 4x4 polynomial interpolation of the table
+    //
+    // The error is not measured relative to values smaller than a millionth of the largest tabulated value.
+    // The table is only used during construction.
+    //
+    CLossTree( double *pTempValues, int iNumTemp, double *pDenValues, int iNumDen, double *pValues, double fTolerance );
+
+    /* Destructor */
+    ~CLossTree( void );
+
+    // Look up the tabulated quantity
+    // @flog_10T log_10 T (clamped to the tabulated range)
+    // @flog_10n log_10 n (clamped to the tabulated range)
+    //
+    // @return the value interpolated from the patch containing the point
+    //
+    double GetValue( double flog_10T, double flog_10n );
+
+    // Return the accuracy and size of the tree
+    // @pfMaxError largest relative error found at the test points of the patches
+    // @plSize memory held by the tree (in bytes)
+    // @piNumPatches number of patches
+    //
+    void GetStats( double *pfMaxError, long *plSize, int *piNumPatches );
+
+};
+
+typedef CLossTree* PLOSSTREE;
+
+#endif
@@ -0,0 +1,272 @@
+// ****
+// *
+// * Piecewise Power Law Class Function Bodies for Radiative Emission Model
+// *
+// * Date last modified: 10/18/2026
+// *
+// ****
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "powerlaw.h"
+#include "interp.h"
+#include "../../rsp_toolkit/source/fitpoly.h"
+#include "../../rsp_toolkit/source/constants.h"
+
+
+CPowerLaw::CPowerLaw( double *pTempValues, int iNumTemp, double *pDenValues, int iNumDen, double *pValues, double fTolerance, double fRefDensity, bool bDensity )
+{
+double fMaxValue, fStep, flog_10T, flog_10n, fLogChi, fAlpha, fBeta, fError, fNextLogChi, fNextAlpha, fNextBeta, fNextError;
+int d, i, j, k, s, s0, s1;
+
+fDen0 = pDenValues[0];
+fDen1 = pDenValues[iNumDen-1];
+
+// The relative error is not measured for values much smaller than the largest
+fMaxValue = 0.0;
+for( i=0; i<iNumTemp*iNumDen; i++ )
+    if( pValues[i] > fMaxValue )
+        fMaxValue = pValues[i];
+fFloor = 1E-6 * fMaxValue;
+
+// Sample the table uniformly in log_10 T at the reference density and, if the fit is density dependent, at each tabulated density
+NumSamples = ( iNumTemp - 1 ) * POWERLAW_SAMPLES_PER_INTERVAL + 1;
+NumRows = bDensity ? iNumDen + 1 : 1;
+
+pSampleTemp = (double*)malloc( sizeof(double) * NumSamples );
+pSampleDen = (double*)malloc( sizeof(double) * NumRows );
+pSampleValue = (double*)malloc( sizeof(double) * NumRows * NumSamples );
+pSampleLog = (double*)malloc( sizeof(double) * NumRows * NumSamples );
+
+fStep = ( pTempValues[iNumTemp-1] - pTempValues[0] ) / ( NumSamples - 1 );
+for( s=0; s<NumSamples; s++ )
+    pSampleTemp[s] = pTempValues[0] + s * fStep;
+pSampleTemp[NumSamples-1] = pTempValues[iNumTemp-1];
+
+pSampleDen[0] = min( max( fRefDensity, fDen0 ), fDen1 );
+for( d=1; d<NumRows; d++ )
+    pSampleDen[d] = pDenValues[d-1];
+
+for( d=0; d<NumRows; d++ )
+    for( s=0; s<NumSamples; s++ )
+    {
+        flog_10T = pSampleTemp[s];
+        flog_10n = pSampleDen[d];
+        j = LocateStencil( pTempValues, iNumTemp, &flog_10T );
+        k = LocateStencil( pDenValues, iNumDen, &flog_10n );
+
+        i = d * NumSamples + s;
+        pSampleValue[i] = max( InterpolateStencil2D( InterpolateCubic, pValues, iNumTemp, pTempValues, j, flog_10T, pDenValues, k, flog_10n, NULL, NULL ), 0.0 );
+
+        // Values of zero are represented by a value far below the floor
+        pSampleLog[i] = log10( max( pSampleValue[i], 1E-24 * fFloor ) );
+    }
+
+// There can be no more segments than intervals between the samples
+pBoundary = (double*)malloc( sizeof(double) * NumSamples );
+pLogChi = (double*)malloc( sizeof(double) * ( NumSamples - 1 ) );
+pAlpha = (double*)malloc( sizeof(double) * ( NumSamples - 1 ) );
+pBeta = (double*)malloc( sizeof(double) * ( NumSamples - 1 ) );
+
+NumSegments = 0;
+fMaxError = 0.0;
+
+s0 = 0;
+while( s0 < NumSamples - 1 )
+{
+    // Extend the segment one sample at a time while the fit remains within the tolerance
+    s1 = s0 + 1;
+    fError = FitSegment( s0, s1, &fLogChi, &fAlpha, &fBeta );
+
+    while( s1 < NumSamples - 1 )
+    {
+        fNextError = FitSegment( s0, s1 + 1, &fNextLogChi, &fNextAlpha, &fNextBeta );
+        if( fNextError > fTolerance ) break;
+
+        s1++;
+        fError = fNextError;
+        fLogChi = fNextLogChi;
+        fAlpha = fNextAlpha;
+        fBeta = fNextBeta;
+    }
+
+    pBoundary[NumSegments] = pSampleTemp[s0];
+    pLogChi[NumSegments] = fLogChi;
+    pAlpha[NumSegments] = fAlpha;
+    pBeta[NumSegments] = fBeta;
+    NumSegments++;
+
+    if( fError > fMaxError )
+        fMaxError = fError;
+
+    s0 = s1;
+}
+pBoundary[NumSegments] = pSampleTemp[NumSamples-1];
+
+// Release the unused space
+pBoundary = (double*)realloc( pBoundary, sizeof(double) * ( NumSegments + 1 ) );
+pLogChi = (double*)realloc( pLogChi, sizeof(double) * NumSegments );
+pAlpha = (double*)realloc( pAlpha, sizeof(double) * NumSegments );
+pBeta = (double*)realloc( pBeta, sizeof(double) * NumSegments );
+
+// The samples are not held after construction
+free( pSampleTemp );
+free( pSampleDen );
+free( pSampleValue );
+free( pSampleLog );
+pSampleTemp = pSampleDen = pSampleValue = pSampleLog = NULL;
+}
+
+CPowerLaw::~CPowerLaw( void )
+{
+FreeAll();
+}
+
+void CPowerLaw::FreeAll( void )
+{
+free( pBoundary );
+free( pLogChi );
+free( pAlpha );
+free( pBeta );
+}
+
+double CPowerLaw::FitSegment( int s0, int s1, double *pflog_10chi, double *palpha, double *pbeta )
+{
+double fa, fAlpha, fBeta, fdn, fSumrdn, fSumdn2, fWeight, fApprox, fError, fSegmentError;
+int d, s, i;
+
+// Power law between the end points of the segment at the reference density
+fAlpha = ( pSampleLog[s1] - pSampleLog[s0] ) / ( pSampleTemp[s1] - pSampleTemp[s0] );
+fa = pSampleLog[s0] - fAlpha * pSampleTemp[s0];
+
+// Least squares fit of the remaining dependence on log_10 n over the tabulated densities. As the error is measured
+// relative to the floor for smaller values, the residuals of such samples are weighted by the square of their ratio
+// to the floor
+fSumrdn = fSumdn2 = 0.0;
+for( d=1; d<NumRows; d++ )
+{
+    fdn = pSampleDen[d] - pSampleDen[0];
+
+    for( s=s0; s<=s1; s++ )
+    {
+        i = d * NumSamples + s;
+        fWeight = min( pSampleValue[i] / fFloor, 1.0 );
+        fWeight *= fWeight;
+
+        fSumrdn += fWeight * ( pSampleLog[i] - fa - fAlpha * pSampleTemp[s] ) * fdn;
+        fSumdn2 += fWeight * fdn * fdn;
+    }
+}
+fBeta = fSumdn2 > 0.0 ? fSumrdn / fSumdn2 : 0.0;
+
+// Measure the error at every sample of the segment
+fSegmentError = 0.0;
+for( d=0; d<NumRows; d++ )
+{
+    fdn = pSampleDen[d] - pSampleDen[0];
+
+    for( s=s0; s<=s1; s++ )
+    {
+        i = d * NumSamples + s;
+        fApprox = exp( LN_10 * ( fa + fAlpha * pSampleTemp[s] + fBeta * fdn ) );
+
+        fError = fabs( fApprox - pSampleValue[i] ) / max( pSampleValue[i], fFloor );
+        if( fError > fSegmentError )
+            fSegmentError = fError;
+    }
+}
+
+*pflog_10chi = fa - fBeta * pSampleDen[0];
+*palpha = fAlpha;
+*pbeta = fBeta;
+
+return fSegmentError;
+}
+
+int CPowerLaw::GetSegment( double flog_10T )
+{
+int iLower, iUpper, iMid;
+
+// Bisect the boundaries for the last segment starting at or below the temperature
+iLower = 0;
+iUpper = NumSegments - 1;
+while( iLower < iUpper )
+{
+    iMid = ( iLower + iUpper + 1 ) / 2;
+
+    if( pBoundary[iMid] <= flog_10T )
+        iLower = iMid;
+    else
+        iUpper = iMid - 1;
+}
+
+return iLower;
+}
+
+double CPowerLaw::GetValue( double flog_10T, double flog_10n )
+{
+int i;
+
+// If the temperature or density is out of range then set it to the appropriate limit
+if( flog_10T < pBoundary[0] )
+    flog_10T = pBoundary[0];
+else if( flog_10T > pBoundary[NumSegments] )
+    flog_10T = pBoundary[NumSegments];
+
+if( flog_10n < fDen0 )
+    flog_10n = fDen0;
+else if( flog_10n > fDen1 )
+    flog_10n = fDen1;
+
+i = GetSegment( flog_10T );
+
+return exp( LN_10 * ( pLogChi[i] + pAlpha[i] * flog_10T + pBeta[i] * flog_10n ) );
+}
+
+int CPowerLaw::GetNumSegments( void )
+{
+return NumSegments;
+}
+
+void CPowerLaw::GetSegment( int iSegment, double *pflog_10T0, double *pflog_10T1, double *pflog_10chi, double *palpha, double *pbeta )
+{
+*pflog_10T0 = pBoundary[iSegment];
+*pflog_10T1 = pBoundary[iSegment+1];
+*pflog_10chi = pLogChi[iSegment];
+*palpha = pAlpha[iSegment];
+*pbeta = pBeta[iSegment];
+}
+
+void CPowerLaw::GetStats( double *pfMaxError, int *piNumSegments )
+{
+*pfMaxError = fMaxError;
+*piNumSegments = NumSegments;
+}
+
+bool CPowerLaw::WriteFile( char *szFilename )
+{
+FILE *pFile;
+int i;
+bool bSuccess = true;
+
+pFile = fopen( szFilename, "w" );
+if( !pFile )
+{
+    printf( "Failed to open power law file %s.\n", szFilename );
+    return false;
+}
+
+fprintf( pFile, "%i\n", NumSegments );
+for( i=0; i<NumSegments; i++ )
+    if( fprintf( pFile, "%.6f\t%.6f\t%.10f\t%.10f\t%.10f\n", pBoundary[i], pBoundary[i+1], pLogChi[i], pAlpha[i], pBeta[i] ) < 0 )
+        bSuccess = false;
+
+if( fclose( pFile ) ) bSuccess = false;
+
+if( !bSuccess ) printf( "Failed to write power law file %s.\n", szFilename );
+
+return bSuccess;
+}
@@ -0,0 +1,126 @@
+#ifndef POWERLAW_H
+#define POWERLAW_H
+
+// Number of points sampled within each tabulated temperature interval when fitting a power law
+#define POWERLAW_SAMPLES_PER_INTERVAL 8
+
+// Piecewise power law class
+//
+// Class for holding a piecewise power law fit, phi = chi_k T^alpha_k n^beta_k, to a quantity tabulated
+// on a 2D grid of log_10 T and log_10 n values (the total phi( n, T ) of <CRadiation>), in the form of
+// the hard-coded fit of <CRadiation::GetPowerLawRad>. The temperature range is divided into as few
+// segments as the requested relative error allows: starting from the lowest temperature, each segment
+// is extended over the points sampled from the 4x4 polynomial interpolation of the table until the
+// power law between its end points (log_10 phi linear in log_10 T at the reference density) no longer
+// reproduces every sample within the error. The segments are therefore continuous at the reference
+// density.
+//
+// If the fit is density dependent, beta_k is the least squares fit of the remaining dependence on
+// log_10 n of each segment over the tabulated densities, and the error is measured at every tabulated
+// density. Otherwise beta_k is zero and the error is only measured at the reference density. Segments
+// are not divided below the spacing of the samples, so the error can exceed the tolerance where the
+// density dependence is not close enough to a power law (see <GetStats>).
+//
+class CPowerLaw {
+
+  private:
+
+    /*- Number of segments */
+    int NumSegments;
+
+    /*- log_10 T of the lower limit of each segment, followed by the upper limit of the last */
+    double *pBoundary;
+
+    /*- log_10 chi, alpha and beta of each segment */
+    double *pLogChi, *pAlpha, *pBeta;
+
+    /*- Limits of the tabulated log_10 n range */
+    double fDen0, fDen1;
+
+    /*- Largest relative error found at the sampled points */
+    double fMaxError;
+
+    /*- log_10 T of the sampled points, log_10 n of each row of samples (the reference density first), the sampled
+        values (the s'th point of the d'th row held at d * NumSamples + s), their log_10 values and the value below
+        which the relative error is not measured */
+    double *pSampleTemp, *pSampleDen, *pSampleValue, *pSampleLog, fFloor;
+    int NumSamples, NumRows;
+
+    /*- Fit a power law to the samples s0 to s1 of every row, returning the largest relative error */
+    double FitSegment( int s0, int s1, double *pflog_10chi, double *palpha, double *pbeta );
+
+    /*- Free all memory allocated by object */
+    void FreeAll( void );
+
+  public:
+
+    // Default constructor
+    // @pTempValues log_10 T values of the table
+    // @iNumTemp number of temperature values
+    // @pDenValues log_10 n values of the table
+    // @iNumDen number of density values
+    // @pValues tabulated values, the value at the j'th temperature and k'th density held at pValues[ k * iNumTemp + j ]
+    // @fTolerance largest relative error of the fit against the 4x4 polynomial interpolation of the table
+    // @fRefDensity log_10 n at which the temperature dependence is fitted (clamped to the tabulated range)
+    // @bDensity if True, also fit the density dependence of each segment
+    //
+    // The error is not measured relative to values smaller than a millionth of the largest tabulated value.
+    // The table is only used during construction.
+    //
+    CPowerLaw( double *pTempValues, int iNumTemp, double *pDenValues, int iNumDen, double *pValues, double fTolerance, double fRefDensity, bool bDensity );
+
+    /* Destructor */
+    ~CPowerLaw( void );
+
+    // Evaluate the power law
+    // @flog_10T log_10 T (clamped to the tabulated range)
+    // @flog_10n log_10 n (clamped to the tabulated range)
+    //
+    // @return chi_k T^alpha_k n^beta_k of the segment containing the temperature
+    //
+    double GetValue( double flog_10T, double flog_10n );
+
+    // Return the segment containing a temperature
+    // @flog_10T log_10 T (clamped to the tabulated range)
+    //
+    // @return index of the segment
+    //
+    int GetSegment( double flog_10T );
+
+    // Return the number of segments
+    //
+    // @return number of segments
+    //
+    int GetNumSegments( void );
+
+    // Return the coefficients of a segment
+    // @iSegment index of the segment
+    // @pflog_10T0 log_10 T of the lower limit of the segment
+    // @pflog_10T1 log_10 T of the upper limit of the segment
+    // @pflog_10chi log_10 chi
+    // @palpha temperature exponent
+    // @pbeta density exponent
+    //
+    void GetSegment( int iSegment, double *pflog_10T0, double *pflog_10T1, double *pflog_10chi, double *palpha, double *pbeta );
+
+    // Return the accuracy and size of the fit
+    // @pfMaxError largest relative error found at the sampled points
+    // @piNumSegments number of segments
+    //
+    void GetStats( double *pfMaxError, int *piNumSegments );
+
+    // Write the segments to a text file
+    // @szFilename output filename
+    //
+    // Write the number of segments followed by one line for each segment holding the limits of
+    // log_10 T, log_10 chi, alpha and beta.
+    //
+    // @return True if the file was written
+    //
+    bool WriteFile( char *szFilename );
+
+};
+
+typedef CPowerLaw* PPOWERLAW;
+
+#endif
@@ -14,12 +14,39 @@
 #include <cmath>
 
 #include "radiation.h"
+#include "fastmath.h"
 #include "../../rsp_toolkit/source/file.h"
 #include "../../rsp_toolkit/source/fitpoly.h"
 #include "../../rsp_toolkit/source/constants.h"
 #include "../../rsp_toolkit/source/xmlreader.h"
 
 
+// The power-law fit of the radiative losses, based on the calculations of John Raymond (1994, private communication)
+// and twice the coronal abundances of Meyer (1985). Each segment is given by the upper boundary of its range of log_10 T,
+// chi and alpha, with Phi = chi T^alpha. Free-free radiation is included in the parameter values for log_10 T > 7.63
+#define NUM_POWER_LAW_SEGMENTS 7
+static const double fPowerLawSegment[NUM_POWER_LAW_SEGMENTS][3] = {
+    { 4.97, 1.09e-31, 2.0 },
+    { 5.67, 8.87e-17, -1.0 },
+    { 6.18, 1.90e-22, 0.0 },
+    { 6.55, 3.53e-13, -3.0/2.0 },
+    { 6.90, 3.46e-25, 1.0/3.0 },
+    { 7.63, 5.49e-16, -1.0 },
+    { LARGEST_DOUBLE, 1.96e-27, 1.0/2.0 } };
+
+// Return the segment of the power-law fit containing a given log_10 T
+static int GetPowerLawSegment( double flog_10T )
+{
+int i;
+
+for( i=0; i<NUM_POWER_LAW_SEGMENTS-1; i++ )
+    if( flog_10T <= fPowerLawSegment[i][0] )
+        break;
+
+return i;
+}
+
+
 CRadiation::CRadiation( char *szFilename, bool doEmissCalc )
 {
 	freeMemory = true;
@@ -29,6 +56,15 @@ CRadiation::CRadiation( char *szFilename, bool doEmissCalc )
 CRadiation::CRadiation(void)
 {
 	freeMemory = false;
+	rate_cache_tolerance = 0.0;
+	loss_tree_tolerance = 0.0;
+	pLossTree = NULL;
+	log_space_tables = false;
+	total_phi_interpolation = INTERP_CUBIC;
+	pTotalPhiKernel = InterpolateCubic;
+	power_law_tolerance = 0.0;
+	power_law_density = false;
+	pPowerLaw = NULL;
 }
 
 CRadiation::~CRadiation( void )
@@ -70,6 +106,22 @@ void CRadiation::Initialise(char *szFilename, bool doEmissCalc)
 	NumElements = atoi(check_element(recursive_read(root,"numElements"),"numElements")->GetText());
 	max_optically_thin_density = atof(check_element(recursive_read(root,"max_optically_thin_density"),"max_optically_thin_density")->GetText());
 
+	//Optional config variables take their default values if they are not present
+	tinyxml2::XMLElement *pOption;
+	pOption = recursive_read(root,"rate_cache_tolerance");
+	rate_cache_tolerance = pOption ? atof(pOption->GetText()) : 0.0;
+	pOption = recursive_read(root,"loss_tree_tolerance");
+	loss_tree_tolerance = pOption ? atof(pOption->GetText()) : 0.0;
+	pOption = recursive_read(root,"log_space_tables");
+	log_space_tables = pOption ? string2bool(pOption->GetText()) : false;
+	pOption = recursive_read(root,"total_phi_interpolation");
+	total_phi_interpolation = pOption ? GetInterpolationOrder(pOption->GetText()) : INTERP_CUBIC;
+	pTotalPhiKernel = GetInterpolationKernel(total_phi_interpolation);
+	pOption = recursive_read(root,"power_law_tolerance");
+	power_law_tolerance = pOption ? atof(pOption->GetText()) : 0.0;
+	pOption = recursive_read(root,"power_law_density");
+	power_law_density = pOption ? string2bool(pOption->GetText()) : false;
+
 	//Set DB filename for use outside of radiation class
 	sprintf(atomicDBFilename,"%s",szAtomicDBFilename);
 	//Set emission calculation bool for use in IonPopSolver
@@ -114,6 +166,26 @@ void CRadiation::Initialise(char *szFilename, bool doEmissCalc)
 	{
 		CalculateTotalPhi();
 	}
+
+	// Build the adaptive table of total phi( n, T ) if requested
+	pLossTree = NULL;
+	if(do_emiss_calc && loss_tree_tolerance > 0.0)
+	{
+		pLossTree = new CLossTree( pTemp, NumTemp, pDen, NumDen, pTotalPhi, loss_tree_tolerance );
+	}
+
+	// Fit the piecewise power law to total phi( n, T ) if requested
+	pPowerLaw = NULL;
+	if(do_emiss_calc && power_law_tolerance > 0.0)
+	{
+		pPowerLaw = new CPowerLaw( pTemp, NumTemp, pDen, NumDen, pTotalPhi, power_law_tolerance, power_law_density ? 0.5 * ( pDen[0] + pDen[NumDen-1] ) : pDen[0], power_law_density );
+	}
+
+	// Hold total phi( n, T ) as log_10 values once the adaptive table and the power law have been built from it
+	if(do_emiss_calc && log_space_tables)
+	{
+		ConvertToLog10( pTotalPhi, NumTemp * NumDen );
+	}
 }
 
 void CRadiation::OpenRangesFile( char *szRangesFilename )
@@ -190,6 +262,12 @@ if(do_emiss_calc)
 	free( pTotalPhi );
 }
 
+if( pLossTree )
+    delete pLossTree;
+
+if( pPowerLaw )
+    delete pPowerLaw;
+
 free( pDen );
 free( pTemp );
 
@@ -221,8 +299,7 @@ return ppElements[i]->GetAbundance();
 
 void CRadiation::GetEquilIonFrac( int iZ, double *pni, double flog_10T )
 {
-double fTotal = 0.0;
-int i, j;
+int i;
 
 // Find the required element
 for( i=0; i<NumElements; i++ )
@@ -230,22 +307,43 @@ for( i=0; i<NumElements; i++ )
 
 if( i == NumElements ) return;
 
-// Get the set of equilibrium ion fractional populations for the specified element
+// Get the normalised set of equilibrium ion fractional populations for the specified element
+ppElements[i]->GetAllEquilIonFrac( flog_10T, pni );
+}
+
+void CRadiation::GetEquilIonFrac( int iZ, double *pni, double flog_10T, double flog_10n )
+{
+int i;
 
-for( j=0; j<=iZ; j++ )
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
+
+if( i == NumElements ) return;
+
+// Get the normalised set of equilibrium ion fractional populations for the specified element
+ppElements[i]->GetAllEquilIonFrac( flog_10T, flog_10n, pni );
+}
+
+void CRadiation::GetAllEquilIonFrac( double flog_10T, double **ppni )
 {
-    pni[j] = ppElements[i]->GetEquilIonFrac( j+1, flog_10T );
-    fTotal += pni[j];
+int i;
+
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetAllEquilIonFrac( flog_10T, ppni[i] );
 }
 
-// Normalise the sum total of the ion fractional populations to 1
-Normalise( iZ, pni, fTotal );
+void CRadiation::GetAllEquilIonFrac( double flog_10T, double flog_10n, double **ppni )
+{
+int i;
+
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetAllEquilIonFrac( flog_10T, flog_10n, ppni[i] );
 }
 
-void CRadiation::GetEquilIonFrac( int iZ, double *pni, double flog_10T, double flog_10n )
+void CRadiation::GetGridEquilIonFrac( int iZ, int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride )
 {
-double fTotal = 0.0;
-int i, j;
+int i;
 
 // Find the required element
 for( i=0; i<NumElements; i++ )
@@ -253,16 +351,15 @@ for( i=0; i<NumElements; i++ )
 
 if( i == NumElements ) return;
 
-// Get the set of equilibrium ion fractional populations for the specified element
+ppElements[i]->GetGridEquilIonFrac( iNumCells, pflog_10T, pflog_10n, pni, iCellStride, iIonStride );
+}
 
-for( j=0; j<=iZ; j++ )
+void CRadiation::GetAllGridEquilIonFrac( int iNumCells, double *pflog_10T, double *pflog_10n, double **ppni )
 {
-    pni[j] = ppElements[i]->GetEquilIonFrac( j+1, flog_10T, flog_10n );
-    fTotal += pni[j];
-}
+int i;
 
-// Normalise the sum total of the ion fractional populations to 1
-Normalise( iZ, pni, fTotal );
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetGridEquilIonFrac( iNumCells, pflog_10T, pflog_10n, ppni[i], pZ[i] + 1, 1 );
 }
 
 void CRadiation::WriteEquilIonFracToFile( void *pFile, int iZ, double flog_10T )
@@ -351,7 +448,7 @@ fEmiss = ppElements[i]->GetEmissivity( iIon, flog_10T, flog_10n );
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * fEmiss;
 // NOTE: free-free radiation is NOT added here
@@ -373,7 +470,7 @@ fEmiss = ppElements[i]->GetEmissivity( flog_10T, flog_10n );
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * fEmiss;
 // NOTE: free-free radiation is NOT added here
@@ -392,6 +489,41 @@ for( i=0; i<NumElements; i++ )
 double x1[5], x2[5], **y, *pfTemp, result, error, n;
 int j, k, l;
 
+if( pLossTree )
+{
+    // Look up total phi( n, T ) from the adaptive table
+    result = pLossTree->GetValue( flog_10T, flog_10n );
+
+    // The density is limited to the tabulated range and to the optically thin range, as below
+    if( flog_10n < pDen[0] )
+        flog_10n = pDen[0];
+    else if ( flog_10n > pDen[NumDen-1] )
+        flog_10n = pDen[NumDen-1];
+
+    if( flog_10n > max_optically_thin_density )
+        flog_10n = max_optically_thin_density;
+
+    n = Exp10( flog_10n );
+
+    return ( n * n ) * result;
+}
+
+if( log_space_tables )
+{
+    // Bilinear interpolation of log_10 total phi( n, T ) between the two temperature and two density values surrounding the desired ones
+    j = LocateLinearInterval( pTemp, NumTemp, &flog_10T, x1 );
+    k = LocateLinearInterval( pDen, NumDen, &flog_10n, x2 );
+
+    result = GetLog10TableValue( pTotalPhi, NumTemp, j, x1[0], k, x2[0] );
+
+    if( flog_10n > max_optically_thin_density )
+        flog_10n = max_optically_thin_density;
+
+    n = Exp10( flog_10n );
+
+    return ( n * n ) * result;
+}
+
 // Select the four temperature values surrounding the desired one
 
 // If the temperature is out of range then set it to the appropriate limit
@@ -434,6 +566,18 @@ x2[2] = pDen[k-1];
 x2[3] = pDen[k];
 x2[4] = pDen[k+1];
 
+if( total_phi_interpolation != INTERP_CUBIC )
+{
+    result = InterpolateStencil2D( pTotalPhiKernel, pTotalPhi, NumTemp, pTemp, j, flog_10T, pDen, k, flog_10n, NULL, NULL );
+
+    if( flog_10n > max_optically_thin_density )
+        flog_10n = max_optically_thin_density;
+
+    n = Exp10( flog_10n );
+
+    return ( n * n ) * result;
+}
+
 // We are using the j-2, j-1, j and j+1 'th temperature values
 // We are using the k-2, k-1, k and k+1 'th density values
 
@@ -471,12 +615,28 @@ if( result < 0.0 ) result = 0.0;
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * result;
 // NOTE: free-free radiation is NOT added here
 }
 
+bool CRadiation::GetLossTreeStats( double *pfMaxError, long *plSize, int *piNumPatches )
+{
+if( !pLossTree )
+{
+    *pfMaxError = 0.0;
+    *plSize = 0;
+    *piNumPatches = 0;
+
+    return false;
+}
+
+pLossTree->GetStats( pfMaxError, plSize, piNumPatches );
+
+return true;
+}
+
 void CRadiation::Getdnibydt( int iZ, double flog_10T, double flog_10n, double *pni0, double *pni1, double *pni2, double *pni3, double *pni4, double *s, double *s_pos, double *pv, double delta_s, double *pdnibydt, double *pTimeScale )
 {
 int i;
@@ -540,6 +700,119 @@ for( i=0; i<NumElements; i++ )
 *pTimeScale = SmallestTimeScale;
 }
 
+void CRadiation::InitialiseRateCache( RATECACHE *pCache, int iNumCaches )
+{
+double *pIonRate, *pRecRate;
+int c, i, iNumRates = 0;
+
+// There are Z rates of each kind for each element
+for( i=0; i<NumElements; i++ )
+    iNumRates += pZ[i];
+
+// Allocate a single block for the rates of all the caches
+pIonRate = (double*)malloc( sizeof(double) * iNumCaches * iNumRates );
+pRecRate = (double*)malloc( sizeof(double) * iNumCaches * iNumRates );
+
+for( c=0; c<iNumCaches; c++ )
+{
+    pCache[c].pIonRate = pIonRate + c * iNumRates;
+    pCache[c].pRecRate = pRecRate + c * iNumRates;
+    pCache[c].iTempHint = -1;
+    pCache[c].bValid = false;
+    pCache[c].iHits = pCache[c].iMisses = 0;
+}
+}
+
+void CRadiation::FreeRateCache( RATECACHE *pCache )
+{
+free( pCache[0].pIonRate );
+free( pCache[0].pRecRate );
+}
+
+void CRadiation::GetAlldnibydt( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double *pTimeScale, RATECACHE *pCache )
+{
+double *pIonRate, *pRecRate, ne, TimeScale, SmallestTimeScale;
+bool bEquilibrium;
+int i;
+
+SmallestTimeScale = LARGEST_DOUBLE;
+
+// The rates depend on temperature alone, so only the electron number density changes with log_10 n
+ne = Exp10( flog_10n );
+
+// Above the optically thin limit the ion populations are held in equilibrium and the rates are not needed
+bEquilibrium = ( flog_10n >= max_optically_thin_density );
+
+if( !bEquilibrium )
+{
+    if( pCache->bValid && fabs( flog_10T - pCache->flog_10T ) <= rate_cache_tolerance )
+        pCache->iHits++;
+    else
+    {
+        // Interpolate the rates of every element at the new temperature, hunting for the stencil
+        // from the last one (every element is tabulated on the same temperature range)
+        pIonRate = pCache->pIonRate;
+        pRecRate = pCache->pRecRate;
+
+        for( i=0; i<NumElements; i++ )
+        {
+            ppElements[i]->GetAllRates( flog_10T, pIonRate, pRecRate, NULL, NULL, &(pCache->iTempHint) );
+            pIonRate += pZ[i];
+            pRecRate += pZ[i];
+        }
+
+        pCache->flog_10T = flog_10T;
+        pCache->bValid = true;
+        pCache->iMisses++;
+    }
+}
+
+pIonRate = pCache->pIonRate;
+pRecRate = pCache->pRecRate;
+
+for( i=0; i<NumElements; i++ )
+{
+    ppElements[i]->GetdnibydtFromRates( flog_10T, ne, bEquilibrium, pIonRate, pRecRate, ppni[i], ppdnibydt[i], &TimeScale );
+    pIonRate += pZ[i];
+    pRecRate += pZ[i];
+
+    if( TimeScale < SmallestTimeScale )
+        SmallestTimeScale = TimeScale;
+}
+
+*pTimeScale = SmallestTimeScale;
+}
+
+double CRadiation::GetRateCacheTolerance( void )
+{
+return rate_cache_tolerance;
+}
+
+void CRadiation::GetGriddnibydt( int iZ, int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale )
+{
+int i;
+
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
+
+if( i == NumElements ) return;
+
+ppElements[i]->GetGriddnibydt( iNumCells, pflog_10T, pflog_10n, pni, iCellStride, iIonStride, s, s_face, pv_face, pdelta_s, pdnibydt, pTimeScale );
+}
+
+void CRadiation::GetAllGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double **ppni, double *s, double *s_face, double *pv_face, double *pdelta_s, double **ppdnibydt, double *pTimeScale )
+{
+int i, j;
+
+for( j=0; j<iNumCells; j++ )
+    pTimeScale[j] = LARGEST_DOUBLE;
+
+// Each element only replaces the time-scale of a cell by a smaller one
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetGriddnibydt( iNumCells, pflog_10T, pflog_10n, ppni[i], pZ[i]+1, 1, s, s_face, pv_face, pdelta_s, ppdnibydt[i], pTimeScale, true );
+}
+
 double CRadiation::GetRadiation( int iZ, int iIon, double flog_10T, double flog_10n, double ni )
 {
 double fEmiss, n;
@@ -556,7 +829,7 @@ fEmiss = ppElements[i]->GetEmissivity( iIon, flog_10T, flog_10n, ni );
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * fEmiss;
 // NOTE: free-free radiation is NOT added here
@@ -578,7 +851,7 @@ fEmiss = ppElements[i]->GetEmissivity( flog_10T, flog_10n, pni );
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * fEmiss;
 // NOTE: free-free radiation is NOT added here
@@ -595,114 +868,358 @@ for( i=0; i<NumElements; i++ )
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return ( n * n ) * fEmiss;
 // NOTE: free-free radiation is NOT added here
 }
 
-double CRadiation::GetPowerLawRad( double flog_10T )
+void CRadiation::GetdnibydtJacobian( int iZ, double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pJacLower, double *pJacDiag, double *pJacUpper, double *pdnibydtbydT, double *pdnibydtbydn )
 {
-	double chi, alpha, fEmiss;
+int i;
 
-	// The formulation used here is based on the calculations of John Raymond (1994, private communication)
-	// and twice the coronal abundances of Meyer (1985)
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
 
-	if( flog_10T <= 4.97 )
-	{
-	    chi = 1.09e-31;
-	    alpha = 2.0;
-	}
-	else if( flog_10T <= 5.67 )
-	{
-	    chi = 8.87e-17;
-	    alpha = -1.0;
-	}
-	else if( flog_10T <= 6.18 )
-	{
-	    chi = 1.90e-22;
-	    alpha = 0.0;
-	}
-	else if( flog_10T <= 6.55 )
-	{
-	    chi = 3.53e-13;
-	    alpha = -3.0/2.0;
-	}
-	else if( flog_10T <= 6.90 )
-	{
-	    chi = 3.46e-25;
-	    alpha = 1.0/3.0;
-	}
-	else if( flog_10T <= 7.63 )
-	{
-	    chi = 5.49e-16;
-	    alpha = -1.0;
-	}
-	else
-	{
-	    chi = 1.96e-27;
-	    alpha = 1.0/2.0;
-	}
+if( i == NumElements ) return;
 
-	fEmiss = chi * std::pow( 10.0, (alpha*flog_10T) );
+ppElements[i]->GetdnibydtJacobian( flog_10T, flog_10n, pni, pdnibydt, pJacLower, pJacDiag, pJacUpper, pdnibydtbydT, pdnibydtbydn );
+}
 
-	return fEmiss;
-	// NOTE: free-free radiation is included in the parameter values for log_10 T > 7.63
+void CRadiation::GetAlldnibydtJacobian( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double **ppJacLower, double **ppJacDiag, double **ppJacUpper, double **ppdnibydtbydT, double **ppdnibydtbydn )
+{
+int i;
+
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetdnibydtJacobian( flog_10T, flog_10n, ppni[i], ppdnibydt[i], ppJacLower[i], ppJacDiag[i], ppJacUpper[i], ppdnibydtbydT[i], ppdnibydtbydn[i] );
 }
 
+double CRadiation::GetRadiationDerivatives( double flog_10T, double flog_10n, double **ppni, double **ppdRadbydni, double *pdRadbydT, double *pdRadbydn )
+{
+double fEmiss = 0.0, dEmissbydlog_10T = 0.0, dEmissbydlog_10n = 0.0, dElementbydlog_10T, dElementbydlog_10n, n, fLn10;
+int i, j;
 
-double CRadiation::GetPowerLawRad( double flog_10T, double flog_10n )
+for( i=0; i<NumElements; i++ )
 {
-double chi, alpha, fEmiss, n;
+    fEmiss += ppElements[i]->GetEmissivityDerivatives( flog_10T, flog_10n, ppni[i], ppdRadbydni[i], &dElementbydlog_10T, &dElementbydlog_10n );
+    dEmissbydlog_10T += dElementbydlog_10T;
+    dEmissbydlog_10n += dElementbydlog_10n;
+}
+
+fLn10 = log( 10.0 );
+
+// Convert the derivatives with respect to log_10 T and log_10 n to derivatives with respect to T and n
+dEmissbydlog_10T /= Exp10( flog_10T ) * fLn10;
+dEmissbydlog_10n /= Exp10( flog_10n ) * fLn10;
+
+if( flog_10n < max_optically_thin_density )
+{
+    n = Exp10( flog_10n );
+
+    *pdRadbydn = ( n * n ) * dEmissbydlog_10n + 2.0 * n * fEmiss;
+}
+else
+{
+    // The density multiplying the emissivity is held at its optically thin limit
+    n = Exp10( max_optically_thin_density );
+
+    *pdRadbydn = ( n * n ) * dEmissbydlog_10n;
+}
+
+*pdRadbydT = ( n * n ) * dEmissbydlog_10T;
+
+for( i=0; i<NumElements; i++ )
+    for( j=0; j<=pZ[i]; j++ )
+        ppdRadbydni[i][j] *= n * n;
+
+return ( n * n ) * fEmiss;
+// NOTE: free-free radiation is NOT added here
+}
+
+double CRadiation::GetdnibydtAndRadiation( int iZ, double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale )
+{
+double fEmiss, n;
+int i;
+
+// Find the required element
+for( i=0; i<NumElements; i++ )
+    if( iZ == pZ[i] ) break;
+
+if( i == NumElements ) return 0.0;
+
+fEmiss = ppElements[i]->GetdnibydtAndEmissivity( flog_10T, flog_10n, pni, pdnibydt, pTimeScale );
+
+if( flog_10n > max_optically_thin_density )
+    flog_10n = max_optically_thin_density;
+
+n = Exp10( flog_10n );
+
+return ( n * n ) * fEmiss;
+// NOTE: free-free radiation is NOT added here
+}
+
+double CRadiation::GetAlldnibydtAndRadiation( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double *pTimeScale, double *pElementRadiation )
+{
+CELLCONTEXT Context;
+
+GetCellContext( flog_10T, flog_10n, &Context );
 
-// The formulation used here is based on the calculations of John Raymond (1994, private communication)
-// and twice the coronal abundances of Meyer (1985)
+return GetAlldnibydtAndRadiation( &Context, ppni, ppdnibydt, pTimeScale, pElementRadiation );
+}
 
-if( flog_10T <= 4.97 )
+void CRadiation::GetCellContext( double flog_10T, double flog_10n, CELLCONTEXT *pContext )
 {
-    chi = 1.09e-31;
-    alpha = 2.0;
+SetCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, flog_10T, flog_10n, pContext );
 }
-else if( flog_10T <= 5.67 )
+
+void CRadiation::GetCellContext( double flog_10T, double flog_10n, CELLCONTEXT *pContext, bool bHint )
 {
-    chi = 8.87e-17;
-    alpha = -1.0;
+SetCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, flog_10T, flog_10n, pContext, bHint );
 }
-else if( flog_10T <= 6.18 )
+
+void CRadiation::GetCellContext( double flog_10T, double flog_10n, double T, double n, CELLCONTEXT *pContext, bool bHint )
 {
-    chi = 1.90e-22;
-    alpha = 0.0;
+SetCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, flog_10T, flog_10n, T, n, pContext, bHint );
 }
-else if( flog_10T <= 6.55 )
+
+void CRadiation::GetLinearCellContext( double T, double n, CELLCONTEXT *pContext, bool bHint )
 {
-    chi = 3.53e-13;
-    alpha = -3.0/2.0;
+SetLinearCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, T, n, pContext, bHint );
 }
-else if( flog_10T <= 6.90 )
+
+void CRadiation::GetGridRadiation( int iNumCells, double *pflog_10T, double *pflog_10n, double *pT, double *pn, double *pRadiation, double *pFreeFree )
+{
+double *pGridlog_10T = pflog_10T, *pGridlog_10n = pflog_10n;
+
+// Calculate the log_10 form of the temperature and density, if it is not given, for the whole grid at once
+if( !pflog_10T )
 {
-    chi = 3.46e-25;
-    alpha = 1.0/3.0;
+    pGridlog_10T = (double*)malloc( sizeof(double) * iNumCells );
+    Log10Array( iNumCells, pT, pGridlog_10T );
+}
+if( !pflog_10n )
+{
+    pGridlog_10n = (double*)malloc( sizeof(double) * iNumCells );
+    Log10Array( iNumCells, pn, pGridlog_10n );
+}
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif // OPENMP
+{
+CELLCONTEXT Context;
+int c;
+bool bHint = false;
+
+#ifdef OPENMP
+#pragma omp for
+#endif // OPENMP
+for( c=0; c<iNumCells; c++ )
+{
+    // The stencils of each cell are hunted for from those of the previous cell handled by the same thread
+    SetCellContext( pTemp, NumTemp, pDen, NumDen, max_optically_thin_density, pGridlog_10T[c], pGridlog_10n[c], pT ? pT[c] : 0.0, pn ? pn[c] : 0.0, &Context, bHint );
+    bHint = true;
+
+    pRadiation[c] = GetRadiation( &Context );
+    if( pFreeFree )
+        pFreeFree[c] = GetFreeFreeRad( &Context );
+}
+}
+
+if( !pflog_10T ) free( pGridlog_10T );
+if( !pflog_10n ) free( pGridlog_10n );
+}
+
+double CRadiation::GetRadiation( CELLCONTEXT *pContext )
+{
+double *pfTemp, wT, wn, result = 0.0, n;
+int j, k, l, m;
+
+if( pLossTree )
+{
+    // Look up total phi( n, T ) from the adaptive table
+    result = pLossTree->GetValue( pContext->flog_10T_clamped, pContext->flog_10n_clamped );
+}
+else if( log_space_tables )
+{
+    // Bilinear interpolation of log_10 total phi( n, T ) within the stencils of the context
+    j = GetLinearInterval( pTemp, NumTemp, pContext->j, pContext->flog_10T_clamped, &wT );
+    k = GetLinearInterval( pDen, NumDen, pContext->k, pContext->flog_10n_clamped, &wn );
+
+    result = GetLog10TableValue( pTotalPhi, NumTemp, j, wT, k, wn );
 }
-else if( flog_10T <= 7.63 )
+else if( total_phi_interpolation != INTERP_CUBIC )
 {
-    chi = 5.49e-16;
-    alpha = -1.0;
+    result = InterpolateStencil2D( pTotalPhiKernel, pTotalPhi, NumTemp, pTemp, pContext->j, pContext->flog_10T_clamped, pDen, pContext->k, pContext->flog_10n_clamped, NULL, NULL );
 }
 else
 {
-    chi = 1.96e-27;
-    alpha = 1.0/2.0;
+    // Interpolate total phi( n, T ) with the weights of the context
+    for( l=0; l<4; l++ )
+    {
+        pfTemp = pTotalPhi + ( pContext->k + l - 2 ) * NumTemp + pContext->j - 2;
+
+        for( m=0; m<4; m++ )
+            result += pContext->wT[m] * pContext->wn[l] * pfTemp[m];
+    }
+}
+
+// Check the value of phi( n, T ) is physically realistic
+if( result < 0.0 ) result = 0.0;
+
+// As <GetRadiation( flog_10T, flog_10n )>, the density is also limited to the tabulated range
+if( pContext->flog_10n_clamped != pContext->flog_10n && pContext->flog_10n_clamped < max_optically_thin_density )
+{
+    n = Exp10( pContext->flog_10n_clamped );
+    return ( n * n ) * result;
+}
+
+return pContext->n2 * result;
+// NOTE: free-free radiation is NOT added here
+}
+
+double CRadiation::GetRadiation( CELLCONTEXT *pContext, double **ppni )
+{
+double fEmiss = 0.0;
+int i;
+
+for( i=0; i<NumElements; i++ )
+    fEmiss += ppElements[i]->GetEmissivity( pContext, ppni[i] );
+
+return pContext->n2 * fEmiss;
+// NOTE: free-free radiation is NOT added here
+}
+
+void CRadiation::GetAlldnibydt( CELLCONTEXT *pContext, double **ppni, double **ppdnibydt, double *pTimeScale )
+{
+double TimeScale, SmallestTimeScale;
+int i;
+
+SmallestTimeScale = LARGEST_DOUBLE;
+
+for( i=0; i<NumElements; i++ )
+{
+    ppElements[i]->Getdnibydt( pContext, ppni[i], ppdnibydt[i], &TimeScale );
+
+    if( TimeScale < SmallestTimeScale )
+        SmallestTimeScale = TimeScale;
+}
+
+*pTimeScale = SmallestTimeScale;
+}
+
+double CRadiation::GetAlldnibydtAndRadiation( CELLCONTEXT *pContext, double **ppni, double **ppdnibydt, double *pTimeScale, double *pElementRadiation )
+{
+double fEmiss = 0.0, fElementEmiss, TimeScale, SmallestTimeScale;
+int i;
+
+SmallestTimeScale = LARGEST_DOUBLE;
+
+for( i=0; i<NumElements; i++ )
+{
+    fElementEmiss = ppElements[i]->GetdnibydtAndEmissivity( pContext, ppni[i], ppdnibydt[i], &TimeScale );
+
+    if( pElementRadiation )
+        pElementRadiation[i] = pContext->n2 * fElementEmiss;
+
+    fEmiss += fElementEmiss;
+
+    if( TimeScale < SmallestTimeScale )
+        SmallestTimeScale = TimeScale;
+}
+
+*pTimeScale = SmallestTimeScale;
+
+return pContext->n2 * fEmiss;
+// NOTE: free-free radiation is NOT added here
+}
+
+void CRadiation::GetAllEquilIonFrac( CELLCONTEXT *pContext, double **ppni )
+{
+int i;
+
+for( i=0; i<NumElements; i++ )
+    ppElements[i]->GetAllEquilIonFrac( pContext, ppni[i] );
+}
+
+double CRadiation::GetPowerLawRad( CELLCONTEXT *pContext )
+{
+// The number density is already limited to the optically thin range
+if( pContext->T > 0.0 )
+    return pContext->n2 * GetPowerLawPhi( pContext->flog_10T, pContext->T );
+
+return pContext->n2 * GetPowerLawRad( pContext->flog_10T );
 }
 
-fEmiss = chi * pow( 10.0, (alpha*flog_10T) );
+double CRadiation::GetFreeFreeRad( CELLCONTEXT *pContext )
+{
+if( pContext->T > 0.0 )
+    return (1.96e-27) * sqrt( pContext->T ) * pContext->ne * pContext->ne;
+
+return (1.96e-27) * Exp10( (0.5*pContext->flog_10T) ) * pContext->ne * pContext->ne;
+}
+
+double CRadiation::GetPowerLawPhi( double flog_10T, double T )
+{
+double chi, alpha;
+int i;
+
+i = GetPowerLawSegment( flog_10T );
+chi = fPowerLawSegment[i][1];
+alpha = fPowerLawSegment[i][2];
+
+// The powers of T used by the fit are calculated without pow
+if( alpha == 2.0 )
+    return chi * T * T;
+else if( alpha == -1.0 )
+    return chi / T;
+else if( alpha == 0.0 )
+    return chi;
+else if( alpha == -3.0/2.0 )
+    return chi / ( T * sqrt( T ) );
+else if( alpha == 1.0/3.0 )
+    return chi * cbrt( T );
+else if( alpha == 1.0/2.0 )
+    return chi * sqrt( T );
+
+return chi * pow( T, alpha );
+}
+
+double CRadiation::GetPowerLawRad( double flog_10T )
+{
+	double chi, alpha, fEmiss;
+	int i;
+
+	// See <fPowerLawSegment> for the formulation used here
+	i = GetPowerLawSegment( flog_10T );
+	chi = fPowerLawSegment[i][1];
+	alpha = fPowerLawSegment[i][2];
+
+	fEmiss = chi * Exp10( (alpha*flog_10T) );
+
+	return fEmiss;
+}
+
+
+double CRadiation::GetPowerLawRad( double flog_10T, double flog_10n )
+{
+double chi, alpha, fEmiss, n;
+int i;
+
+// See <fPowerLawSegment> for the formulation used here
+i = GetPowerLawSegment( flog_10T );
+chi = fPowerLawSegment[i][1];
+alpha = fPowerLawSegment[i][2];
+
+fEmiss = chi * Exp10( (alpha*flog_10T) );
 
 if( flog_10n > max_optically_thin_density )
     flog_10n = max_optically_thin_density;
 
-n = pow( 10.0, flog_10n );
+n = Exp10( flog_10n );
 
 return n * n * fEmiss;
-// NOTE: free-free radiation is included in the parameter values for log_10 T > 7.63
 }
 
 double CRadiation::GetFreeFreeRad( double flog_10T, double flog_10n )
@@ -713,8 +1230,353 @@ double SqrtT, n;
 // The previous formulation used here was taken from Mason & Monsignori Fossi (1994, Astron. Astrophys. Rev., 6, 123) where (1.96e-27) is replaced with (2.40e-27)
 // The current formulation is taken from the power-law fit for log_10 T > 7.63
 
-SqrtT = pow( 10.0, (0.5*flog_10T) );
-n = pow( 10.0, flog_10n );
+SqrtT = Exp10( (0.5*flog_10T) );
+n = Exp10( flog_10n );
 
 return (1.96e-27) * SqrtT * n * n;
 }
+
+double CRadiation::GetFittedPowerLawRad( double flog_10T, double flog_10n )
+{
+double fEmiss, n;
+
+if( !pPowerLaw )
+    return GetRadiation( flog_10T, flog_10n );
+
+fEmiss = pPowerLaw->GetValue( flog_10T, flog_10n );
+
+// The density is limited to the tabulated range and to the optically thin range, as <GetRadiation>
+if( flog_10n < pDen[0] )
+    flog_10n = pDen[0];
+else if ( flog_10n > pDen[NumDen-1] )
+    flog_10n = pDen[NumDen-1];
+
+if( flog_10n > max_optically_thin_density )
+    flog_10n = max_optically_thin_density;
+
+n = Exp10( flog_10n );
+
+return n * n * fEmiss;
+}
+
+double CRadiation::GetFittedPowerLawRad( CELLCONTEXT *pContext )
+{
+double fEmiss, n;
+
+if( !pPowerLaw )
+    return GetRadiation( pContext );
+
+fEmiss = pPowerLaw->GetValue( pContext->flog_10T_clamped, pContext->flog_10n_clamped );
+
+// As <GetRadiation( pContext )>, the density is also limited to the tabulated range
+if( pContext->flog_10n_clamped != pContext->flog_10n && pContext->flog_10n_clamped < max_optically_thin_density )
+{
+    n = Exp10( pContext->flog_10n_clamped );
+    return ( n * n ) * fEmiss;
+}
+
+return pContext->n2 * fEmiss;
+}
+
+double CRadiation::GetLossFunction( int iLossFunction, double flog_10T, double flog_10n )
+{
+if( iLossFunction == LOSS_POWER_LAW )
+    return GetPowerLawRad( flog_10T, flog_10n );
+else if( iLossFunction == LOSS_FITTED_POWER_LAW )
+    return GetFittedPowerLawRad( flog_10T, flog_10n );
+
+return GetRadiation( flog_10T, flog_10n );
+}
+
+double CRadiation::GetLossTempBreakpoint( int iLossFunction, double flog_10T, bool bAbove )
+{
+double fBreak, flog_10T0, flog_10T1, fTemp;
+int i, j;
+
+fBreak = bAbove ? LARGEST_DOUBLE : -LARGEST_DOUBLE;
+
+if( iLossFunction == LOSS_POWER_LAW )
+{
+    // The segment boundaries of <GetPowerLawRad>
+    for( i=0; i<NUM_POWER_LAW_SEGMENTS-1; i++ )
+        if( bAbove && fPowerLawSegment[i][0] > flog_10T )
+            return fPowerLawSegment[i][0];
+        else if( !bAbove && fPowerLawSegment[i][0] < flog_10T )
+            fBreak = fPowerLawSegment[i][0];
+}
+else if( iLossFunction == LOSS_FITTED_POWER_LAW && pPowerLaw )
+{
+    // The boundaries of the segment containing the temperature, or of the neighbouring segment if it lies on one
+    i = pPowerLaw->GetSegment( flog_10T );
+    pPowerLaw->GetSegment( i, &flog_10T0, &flog_10T1, &fTemp, &fTemp, &fTemp );
+
+    if( bAbove )
+    {
+        if( flog_10T < flog_10T0 )
+            fBreak = flog_10T0;
+        else if( flog_10T < flog_10T1 )
+            fBreak = flog_10T1;
+        else if( i + 1 < pPowerLaw->GetNumSegments() )
+        {
+            pPowerLaw->GetSegment( i + 1, &flog_10T0, &flog_10T1, &fTemp, &fTemp, &fTemp );
+            fBreak = flog_10T1;
+        }
+    }
+    else
+    {
+        if( flog_10T1 < flog_10T )
+            fBreak = flog_10T1;
+        else if( flog_10T0 < flog_10T )
+            fBreak = flog_10T0;
+        else if( i > 0 )
+        {
+            pPowerLaw->GetSegment( i - 1, &flog_10T0, &flog_10T1, &fTemp, &fTemp, &fTemp );
+            fBreak = flog_10T0;
+        }
+    }
+}
+else
+{
+    // The tabulated temperatures
+    if( bAbove )
+    {
+        if( flog_10T < pTemp[0] )
+            fBreak = pTemp[0];
+        else if( flog_10T < pTemp[NumTemp-1] )
+            fBreak = pTemp[HuntGrid( pTemp, NumTemp, flog_10T, -1 ) + 1];
+    }
+    else
+    {
+        if( pTemp[NumTemp-1] < flog_10T )
+            fBreak = pTemp[NumTemp-1];
+        else
+        {
+            j = HuntGrid( pTemp, NumTemp, flog_10T, -1 );
+            if( pTemp[j] >= flog_10T ) j--;
+            if( j >= 0 )
+                fBreak = pTemp[j];
+        }
+    }
+}
+
+return fBreak;
+}
+
+double CRadiation::GetLossDenBreakpoint( int iLossFunction, double flog_10n, bool bAbove )
+{
+double fCandidate[3], fBreak;
+int i, iNumCandidates;
+
+// The optically thin limit and, for the fitted power law and the table, the limits of the tabulated range
+fCandidate[0] = max_optically_thin_density;
+fCandidate[1] = pDen[0];
+fCandidate[2] = pDen[NumDen-1];
+iNumCandidates = iLossFunction == LOSS_POWER_LAW ? 1 : 3;
+
+fBreak = bAbove ? LARGEST_DOUBLE : -LARGEST_DOUBLE;
+
+for( i=0; i<iNumCandidates; i++ )
+    if( bAbove ? ( fCandidate[i] > flog_10n && fCandidate[i] < fBreak ) : ( fCandidate[i] < flog_10n && fCandidate[i] > fBreak ) )
+        fBreak = fCandidate[i];
+
+// The tabulated densities
+if( iLossFunction == LOSS_TABULATED || ( iLossFunction == LOSS_FITTED_POWER_LAW && !pPowerLaw ) )
+    for( i=0; i<NumDen; i++ )
+        if( bAbove ? ( pDen[i] > flog_10n && pDen[i] < fBreak ) : ( pDen[i] < flog_10n && pDen[i] > fBreak ) )
+            fBreak = pDen[i];
+
+return fBreak;
+}
+
+double CRadiation::GetCoolingRate( int iLossFunction, int iProcess, double flog_10T, double flog_10n0, double flog_10T0 )
+{
+double flog_10n;
+
+// The density is constant or varies as 1 / T at constant pressure
+flog_10n = flog_10n0;
+if( iProcess == COOLING_ISOBARIC )
+    flog_10n += flog_10T0 - flog_10T;
+
+return GetLossFunction( iLossFunction, flog_10T, flog_10n ) / Exp10( flog_10n );
+}
+
+double CRadiation::GetCoolingBreakpoint( int iLossFunction, int iProcess, double flog_10T, double flog_10n0, double flog_10T0 )
+{
+double fBreak, fDenBreak, fTemp;
+
+fBreak = GetLossTempBreakpoint( iLossFunction, flog_10T, false );
+
+// At constant pressure the density increases as the plasma cools, reaching the next density at which the loss function changes form
+if( iProcess == COOLING_ISOBARIC )
+{
+    fDenBreak = GetLossDenBreakpoint( iLossFunction, flog_10n0 + flog_10T0 - flog_10T, true );
+    if( fDenBreak < LARGEST_DOUBLE )
+    {
+        fTemp = flog_10n0 + flog_10T0 - fDenBreak;
+        if( fTemp > fBreak )
+            fBreak = fTemp;
+    }
+}
+
+return fBreak;
+}
+
+double CRadiation::GetExactCooling( int iLossFunction, int iProcess, double flog_10T, double flog_10n, double delta_t, double *pfRadiated )
+{
+double fHeatCapacity, fRemaining, fUpper, fLower, fa, fb, fRatea, fRateb, fGamma, flog_10G, p, fTime, x, result;
+
+// Thermal energy per particle per K ( 3 / 2 k for each of the electrons and ions), or the enthalpy at constant pressure
+fHeatCapacity = ( iProcess == COOLING_ISOBARIC ? 5.0 : 3.0 ) * BOLTZMANN_CONSTANT;
+
+// Cooling from T0 to T1 takes the time ( heat capacity ) * integral from T1 to T0 of dT / ( energy radiated per unit time per particle )
+fRemaining = delta_t / fHeatCapacity;
+
+result = fUpper = flog_10T;
+while( fRemaining > 0.0 && fUpper > pTemp[0] )
+{
+    fLower = max( GetCoolingBreakpoint( iLossFunction, iProcess, fUpper, flog_10n, flog_10T ), pTemp[0] );
+
+    // The power law G T^gamma through two points within the interval
+    fa = fLower + 0.25 * ( fUpper - fLower );
+    fb = fLower + 0.75 * ( fUpper - fLower );
+    fRatea = GetCoolingRate( iLossFunction, iProcess, fa, flog_10n, flog_10T );
+    fRateb = GetCoolingRate( iLossFunction, iProcess, fb, flog_10n, flog_10T );
+
+    // The plasma does not cool where the loss function is zero
+    if( fRatea <= 0.0 || fRateb <= 0.0 ) break;
+
+    fGamma = Log10( fRateb / fRatea ) / ( fb - fa );
+    flog_10G = Log10( fRatea ) - fGamma * fa;
+
+    // Time integral across the whole interval: ( T_upper^p - T_lower^p ) / ( p G ), where p = 1 - gamma
+    p = 1.0 - fGamma;
+    x = LN_10 * ( fUpper - fLower );
+    if( fabs( p ) > SMALLEST_DOUBLE )
+        fTime = exp( LN_10 * ( p * fLower - flog_10G ) ) * expm1( p * x ) / p;
+    else
+        fTime = exp( LN_10 * ( fLower - flog_10G ) ) * x;
+
+    if( fTime < fRemaining )
+    {
+        // Cool through the whole interval
+        fRemaining -= fTime;
+        result = fUpper = fLower;
+        continue;
+    }
+
+    // Cool part of the way through the interval: T1^p = T_upper^p - p G ( time remaining )
+    x = fRemaining * exp( LN_10 * ( flog_10G - p * fUpper ) );
+    if( fabs( p ) > SMALLEST_DOUBLE )
+        result = fUpper + log1p( - p * x ) / ( p * LN_10 );
+    else
+        result = fUpper - x / LN_10;
+
+    break;
+}
+
+// The energy radiated is the thermal energy (or enthalpy) lost by the plasma
+if( pfRadiated )
+    *pfRadiated = fHeatCapacity * Exp10( flog_10n ) * ( Exp10( flog_10T ) - Exp10( result ) );
+
+return result;
+}
+
+double CRadiation::GetLinearProfileRadiation( int iLossFunction, double flog_10T0, double flog_10T1, double flog_10n0, double flog_10n1 )
+{
+double fdT, fdn, s0, s1, sBreak, sa, sb, fRada, fRadb, fRate, result = 0.0;
+
+fdT = flog_10T1 - flog_10T0;
+fdn = flog_10n1 - flog_10n0;
+
+s0 = 0.0;
+while( s0 < 1.0 )
+{
+    // The part of the profile extends to the next position at which the loss function changes form
+    s1 = 1.0;
+    if( fdT != 0.0 )
+    {
+        sBreak = ( GetLossTempBreakpoint( iLossFunction, flog_10T0 + s0 * fdT, fdT > 0.0 ) - flog_10T0 ) / fdT;
+        if( sBreak > s0 && sBreak < s1 ) s1 = sBreak;
+    }
+    if( fdn != 0.0 )
+    {
+        sBreak = ( GetLossDenBreakpoint( iLossFunction, flog_10n0 + s0 * fdn, fdn > 0.0 ) - flog_10n0 ) / fdn;
+        if( sBreak > s0 && sBreak < s1 ) s1 = sBreak;
+    }
+
+    // The exponential through two points within the part
+    sa = s0 + 0.25 * ( s1 - s0 );
+    sb = s0 + 0.75 * ( s1 - s0 );
+    fRada = GetLossFunction( iLossFunction, flog_10T0 + sa * fdT, flog_10n0 + sa * fdn );
+    fRadb = GetLossFunction( iLossFunction, flog_10T0 + sb * fdT, flog_10n0 + sb * fdn );
+
+    if( fRada <= 0.0 || fRadb <= 0.0 )
+    {
+        // The loss function is zero within the part
+        result += 0.5 * ( fRada + fRadb ) * ( s1 - s0 );
+    }
+    else
+    {
+        // Integral of fRada * exp( fRate * ( s - sa ) ) from s0 to s1
+        fRate = log( fRadb / fRada ) / ( sb - sa );
+        if( fabs( fRate ) > SMALLEST_DOUBLE )
+            result += fRada * exp( fRate * ( s0 - sa ) ) * expm1( fRate * ( s1 - s0 ) ) / fRate;
+        else
+            result += fRada * ( s1 - s0 );
+    }
+
+    s0 = s1;
+}
+
+return result;
+}
+
+double CRadiation::GetCellAveragedRadiation( int iLossFunction, double flog_10T0, double flog_10T1, double flog_10n0, double flog_10n1 )
+{
+return GetLinearProfileRadiation( iLossFunction, flog_10T0, flog_10T1, flog_10n0, flog_10n1 );
+}
+
+double CRadiation::GetCellAveragedRadiation( int iLossFunction, int iNumPoints, double *pfx, double *pflog_10T, double *pflog_10n )
+{
+double fWidth, fTotalWidth = 0.0, result = 0.0;
+int i;
+
+if( iNumPoints < 2 )
+    return GetLossFunction( iLossFunction, pflog_10T[0], pflog_10n[0] );
+
+// Weight the average over each linear part of the profile by its width
+for( i=0; i<iNumPoints-1; i++ )
+{
+    fWidth = pfx ? pfx[i+1] - pfx[i] : 1.0;
+
+    result += fWidth * GetLinearProfileRadiation( iLossFunction, pflog_10T[i], pflog_10T[i+1], pflog_10n[i], pflog_10n[i+1] );
+    fTotalWidth += fWidth;
+}
+
+if( fTotalWidth <= 0.0 )
+    return GetLossFunction( iLossFunction, pflog_10T[0], pflog_10n[0] );
+
+return result / fTotalWidth;
+}
+
+bool CRadiation::GetPowerLawStats( double *pfMaxError, int *piNumSegments )
+{
+if( !pPowerLaw )
+{
+    *pfMaxError = 0.0;
+    *piNumSegments = 0;
+
+    return false;
+}
+
+pPowerLaw->GetStats( pfMaxError, piNumSegments );
+
+return true;
+}
+
+bool CRadiation::WritePowerLawFile( char *szFilename )
+{
+if( !pPowerLaw ) return false;
+
+return pPowerLaw->WriteFile( szFilename );
+}
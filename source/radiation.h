@@ -2,6 +2,38 @@
 #define RADIATION_H
 
 #include "element.h"
+#include "losstree.h"
+#include "powerlaw.h"
+
+// Rate cache
+//
+// The total ionisation and recombination rates of every element interpolated for one cell, re-used by
+// <CRadiation::GetAlldnibydt> while the cell's log_10 T stays within the rate cache tolerance of the value at which
+// they were calculated. The rates depend on temperature alone. Set up with <CRadiation::InitialiseRateCache>.
+//
+typedef struct {
+    /* log_10 T at which the rates were interpolated */
+    double flog_10T;
+    /* Rates of every element; the rates of the i'th element start at the sum of the atomic numbers of the elements before it */
+    double *pIonRate, *pRecRate;
+    /* Temperature stencil index of the last interpolation, from which the next is hunted for */
+    int iTempHint;
+    /* True if the cache holds rates */
+    bool bValid;
+    /* Number of calls that re-used the rates and that interpolated them */
+    int iHits, iMisses;
+} RATECACHE;
+
+// Loss functions integrated by <CRadiation::GetExactCooling>: the hard-coded power law of <CRadiation::GetPowerLawRad>,
+// the power law fitted to the loaded total phi( n, T ) (<CRadiation::GetFittedPowerLawRad>) and the tabulated total
+// phi( n, T ) itself (<CRadiation::GetRadiation>)
+#define LOSS_POWER_LAW 0
+#define LOSS_FITTED_POWER_LAW 1
+#define LOSS_TABULATED 2
+
+// Processes under which <CRadiation::GetExactCooling> integrates the cooling: at constant density or constant pressure
+#define COOLING_ISOCHORIC 0
+#define COOLING_ISOBARIC 1
 
 /* Radiative emission model class
  *
@@ -22,6 +54,9 @@ class CRadiation {
 	  // Config variables--originally set in config.h
 	  double max_optically_thin_density; //log10 of maximum optically thin density value
 
+    // Largest change in log_10 T for which cached rates are re-used (see <RATECACHE>)
+    double rate_cache_tolerance;
+
     // Parameter for skipping emissivity calculation
 	  bool do_emiss_calc;
 
@@ -43,6 +78,27 @@ class CRadiation {
     // Pointer to the factor total phi( n, T ) for all of the elements
     double *pTotalPhi;
 
+    // Largest relative error of the adaptive table of total phi( n, T ) (0 if the table is not used)
+    double loss_tree_tolerance;
+
+    // Adaptive table of total phi( n, T ) used by <GetRadiation> in equilibrium (NULL if not used, see <CLossTree>)
+    PLOSSTREE pLossTree;
+
+    // Option to hold total phi( n, T ) as log_10 values and interpolate it linearly in log space
+    bool log_space_tables;
+
+    // Interpolation order of total phi( n, T ) (see <GetInterpolationKernel>) and its kernel, selected once
+    int total_phi_interpolation;
+    INTERPKERNEL pTotalPhiKernel;
+
+    // Largest relative error of the piecewise power law fit to total phi( n, T ) (0 if the fit is not made), and the
+    // option to also fit its density dependence
+    double power_law_tolerance;
+    bool power_law_density;
+
+    // Piecewise power law fit to total phi( n, T ) used by <GetFittedPowerLawRad> (NULL if not used, see <CPowerLaw>)
+    PPOWERLAW pPowerLaw;
+
     // Function to initialise the radiation object with a set of elements
     void Initialise( char *szFilename, bool doEmissCalc );
 
@@ -52,6 +108,26 @@ class CRadiation {
     // Function to calculate the factor total phi( n, T ), which is multiplied by n^2 to calculate the radiated energy
     void CalculateTotalPhi( void );
 
+    // Function to calculate the factor phi( T ) of <GetPowerLawRad> from the temperature in both log_10 and linear (K) form,
+    // evaluating the power of T of each segment algebraically
+    double GetPowerLawPhi( double flog_10T, double T );
+
+    // Functions to return the energy radiated by a loss function (see <GetExactCooling>), and the nearest log_10 T or log_10 n
+    // strictly above or below a specified one at which the loss function (or the limits applied to the density) changes form
+    double GetLossFunction( int iLossFunction, double flog_10T, double flog_10n );
+    double GetLossTempBreakpoint( int iLossFunction, double flog_10T, bool bAbove );
+    double GetLossDenBreakpoint( int iLossFunction, double flog_10n, bool bAbove );
+
+    // Functions used by <GetExactCooling> to return the energy radiated per unit time per particle by the loss function
+    // at a temperature along the cooling path starting from log_10 T0 and log_10 n0, and the largest log_10 T below a
+    // specified one at which the loss function changes form along the path
+    double GetCoolingRate( int iLossFunction, int iProcess, double flog_10T, double flog_10n0, double flog_10T0 );
+    double GetCoolingBreakpoint( int iLossFunction, int iProcess, double flog_10T, double flog_10n0, double flog_10T0 );
+
+    // Function used by <GetCellAveragedRadiation> to return the energy radiated by the loss function averaged over a profile
+    // along which log_10 T and log_10 n vary linearly
+    double GetLinearProfileRadiation( int iLossFunction, double flog_10T0, double flog_10T1, double flog_10n0, double flog_10n1 );
+
     // Function to free all allocated memory
     void FreeAll( void );
 
@@ -95,6 +171,17 @@ class CRadiation {
     void GetEquilIonFrac( int iZ, double *pni, double flog_10T );
     void GetEquilIonFrac( int iZ, double *pni, double flog_10T, double flog_10n );
 
+    // Function to return the ion fractional populations of every element at a specified
+    // temperature and density in equilibrium
+    void GetAllEquilIonFrac( double flog_10T, double **ppni );
+    void GetAllEquilIonFrac( double flog_10T, double flog_10n, double **ppni );
+
+    // Functions to return the ion fractional populations in equilibrium in every cell of a grid
+    // (see <CElement::GetGridEquilIonFrac>). The all-element version takes one [cell][ion] array
+    // per element. If <pflog_10n> is NULL the temperature only equilibrium is used
+    void GetGridEquilIonFrac( int iZ, int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride );
+    void GetAllGridEquilIonFrac( int iNumCells, double *pflog_10T, double *pflog_10n, double **ppni );
+
     // Functions to write either a given set of ion fractional populations or all
     // fractional populations to a data file
     void WriteEquilIonFracToFile( void *pFile, int iZ, double flog_10T );
@@ -110,6 +197,11 @@ class CRadiation {
     double GetRadiation( int iZ, double flog_10T, double flog_10n );
     double GetRadiation( double flog_10T, double flog_10n );
 
+    // Function to return the accuracy and memory use of the adaptive table of total phi( n, T ) used by the total
+    // equilibrium <GetRadiation> when loss_tree_tolerance is set (see <CLossTree::GetStats>). Returns False, and
+    // sets the values to zero, if the table is not used
+    bool GetLossTreeStats( double *pfMaxError, long *plSize, int *piNumPatches );
+
     // Functions to calculate the rate of change with respect to time of the fractional
     // populations of the ions and the characteristic time-scale
   	// Overload for use in IonPopSolver code
@@ -118,16 +210,116 @@ class CRadiation {
     void GetAlldnibydt( double flog_10T, double flog_10n, double **ppni0, double **ppni1, double **ppni2, double **ppni3, double **ppni4, double *s, double *s_pos, double *pv, double delta_s, double **ppdnibydt, double *pTimeScale );
     void GetAlldnibydt( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double *pTimeScale );
 
+    // Functions to allocate and free the rates of an array of <iNumCaches> rate caches (one for each cell), and a function to
+    // calculate the rate of change with respect to time of the fractional populations of the ions and the characteristic
+    // time-scale (as <GetAlldnibydt>) re-using the rates held in a cell's rate cache while log_10 T is within the rate
+    // cache tolerance (rate_cache_tolerance, default 0) of the value at which they were interpolated. The electron number
+    // density is calculated from log_10 n on every call
+    void InitialiseRateCache( RATECACHE *pCache, int iNumCaches );
+    void FreeRateCache( RATECACHE *pCache );
+    void GetAlldnibydt( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double *pTimeScale, RATECACHE *pCache );
+    double GetRateCacheTolerance( void );
+
+    // Functions to calculate the rate of change with respect to time of the fractional populations of the ions and
+    // the characteristic time-scale in every cell of a 1D grid slice using Barton's method (see <CElement::GetGriddnibydt>)
+    // The all-element version takes one [cell][ion] array per element and returns the smallest time-scale of any
+    // element in each cell
+    void GetGriddnibydt( int iZ, int iNumCells, double *pflog_10T, double *pflog_10n, double *pni, int iCellStride, int iIonStride, double *s, double *s_face, double *pv_face, double *pdelta_s, double *pdnibydt, double *pTimeScale );
+    void GetAllGriddnibydt( int iNumCells, double *pflog_10T, double *pflog_10n, double **ppni, double *s, double *s_face, double *pv_face, double *pdelta_s, double **ppdnibydt, double *pTimeScale );
+
     // Functions to calculate the amount of energy radiated in nonequilibrium
     double GetRadiation( int iZ, int iIon, double flog_10T, double flog_10n, double ni );
     double GetRadiation( int iZ, double flog_10T, double flog_10n, double *pni );
     double GetRadiation( double flog_10T, double flog_10n, double **ppni );
 
+    // Functions to calculate the rate of change with respect to time of the fractional populations of the ions
+    // together with the analytic Jacobian: the lower, main and upper diagonals of d(dnibydt)/dni and the
+    // derivatives d(dnibydt)/dT and d(dnibydt)/dn, with T in K and n in cm^-3
+    void GetdnibydtJacobian( int iZ, double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pJacLower, double *pJacDiag, double *pJacUpper, double *pdnibydtbydT, double *pdnibydtbydn );
+    void GetAlldnibydtJacobian( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double **ppJacLower, double **ppJacDiag, double **ppJacUpper, double **ppdnibydtbydT, double **ppdnibydtbydn );
+
+    // Function to calculate the amount of energy radiated in nonequilibrium together with its derivatives
+    // with respect to the fractional population of each ion, the temperature (K) and the density (cm^-3)
+    double GetRadiationDerivatives( double flog_10T, double flog_10n, double **ppni, double **ppdRadbydni, double *pdRadbydT, double *pdRadbydn );
+
+    // Functions to calculate the rate of change with respect to time of the fractional populations of the ions,
+    // the characteristic time-scale and the amount of energy radiated in nonequilibrium in a single pass over each
+    // element's ions, equivalent to calling <GetAlldnibydt> followed by <GetRadiation>. The amount of energy
+    // radiated by each element is returned in <pElementRadiation> if it is not NULL
+    double GetdnibydtAndRadiation( int iZ, double flog_10T, double flog_10n, double *pni, double *pdnibydt, double *pTimeScale );
+    double GetAlldnibydtAndRadiation( double flog_10T, double flog_10n, double **ppni, double **ppdnibydt, double *pTimeScale, double *pElementRadiation );
+
+    // Function to set up a cell context (see <SetCellContext>) holding the clamped coordinates, stencils, interpolation weights
+    // and densities shared by every element at a specified temperature and density. Create one context per cell and step and
+    // pass it to the functions below in place of the temperature and density
+    void GetCellContext( double flog_10T, double flog_10n, CELLCONTEXT *pContext );
+
+    // Function to set up a cell context as above, hunting for the stencils from those already held by the context if <bHint>
+    // is True. Re-use one context for each cell when sweeping through the cells in order
+    void GetCellContext( double flog_10T, double flog_10n, CELLCONTEXT *pContext, bool bHint );
+
+    // Functions to set up a cell context as above from the temperature (K) and density (cm^-3) in both log_10 and linear
+    // form, or in linear form alone, so that hosts holding linear values need not convert them for each call. The
+    // number density is then taken directly from n, and <GetPowerLawRad> and <GetFreeFreeRad> use T in place of
+    // powers of 10^log_10 T
+    void GetCellContext( double flog_10T, double flog_10n, double T, double n, CELLCONTEXT *pContext, bool bHint );
+    void GetLinearCellContext( double T, double n, CELLCONTEXT *pContext, bool bHint );
+
+    // Function to calculate the amount of energy radiated in equilibrium (see <GetRadiation>) and, if <pFreeFree> is not NULL,
+    // the free-free radiation (see <GetFreeFreeRad>) in every cell of a grid, from log_10 T and log_10 n and/or T (K) and
+    // n (cm^-3) in linear form. Either form may be NULL, in which case it is calculated from the other once for each cell
+    void GetGridRadiation( int iNumCells, double *pflog_10T, double *pflog_10n, double *pT, double *pn, double *pRadiation, double *pFreeFree );
+
+    // Functions equivalent to <GetRadiation>, <GetAlldnibydt>, <GetAlldnibydtAndRadiation>, <GetAllEquilIonFrac> (with density),
+    // <GetPowerLawRad> and <GetFreeFreeRad>, taking a cell context in place of the temperature and density
+    double GetRadiation( CELLCONTEXT *pContext );
+    double GetRadiation( CELLCONTEXT *pContext, double **ppni );
+    void GetAlldnibydt( CELLCONTEXT *pContext, double **ppni, double **ppdnibydt, double *pTimeScale );
+    double GetAlldnibydtAndRadiation( CELLCONTEXT *pContext, double **ppni, double **ppdnibydt, double *pTimeScale, double *pElementRadiation );
+    void GetAllEquilIonFrac( CELLCONTEXT *pContext, double **ppni );
+    double GetPowerLawRad( CELLCONTEXT *pContext );
+    double GetFreeFreeRad( CELLCONTEXT *pContext );
+
     // Functions to calculate energy radiated based upon power-laws
     double GetPowerLawRad( double flog_10T, double flog_10n );
     double GetPowerLawRad( double flog_10T );
     double GetFreeFreeRad( double flog_10T, double flog_10n );
 
+    // Functions to calculate energy radiated based upon the piecewise power law fitted to the loaded total phi( n, T )
+    // when power_law_tolerance is set (see <CPowerLaw>), in place of the hard-coded fit of <GetPowerLawRad>. The fit
+    // is made at the lowest tabulated density unless power_law_density is set, when it is made at the middle of the
+    // tabulated densities and includes their dependence. The density is limited as <GetRadiation>, which is used if
+    // there is no fit
+    double GetFittedPowerLawRad( double flog_10T, double flog_10n );
+    double GetFittedPowerLawRad( CELLCONTEXT *pContext );
+
+    // Function to integrate the radiative cooling of a fully ionised hydrogen plasma of electron and ion number density n
+    // over a time step exactly, with the scheme of Townsend (2009, ApJS, 181, 391), so that the cooling does not limit the
+    // time step. The loss function (LOSS_POWER_LAW, LOSS_FITTED_POWER_LAW or LOSS_TABULATED) is divided into intervals
+    // at its segment boundaries or tabulated temperatures, and at the temperatures at which the density reaches the limits
+    // applied to it, and represented in each by the power law through two points within the interval. This is exact for
+    // the power laws, and the time taken to cool through each interval is then known analytically. The cooling stops at
+    // the lowest tabulated temperature. At constant pressure the density varies as 1 / T. Returns log_10 T at the end of
+    // the time step and the energy radiated per unit (initial) volume in <pfRadiated> if it is not NULL
+    double GetExactCooling( int iLossFunction, int iProcess, double flog_10T, double flog_10n, double delta_t, double *pfRadiated );
+
+    // Functions to calculate the energy radiated by the loss function (see <GetExactCooling>) averaged over a cell across
+    // which log_10 T and log_10 n vary linearly from one face to the other, or piecewise linearly between <iNumPoints>
+    // values at the positions <pfx> (increasing; equally spaced if NULL), in place of sampling the loss function at many
+    // points within the cell. The profile is divided where the loss function or the limits applied to the density change
+    // form, and within each part the energy radiated is represented by the exponential in position through two points
+    // within the part and integrated analytically. This is exact for the power laws
+    double GetCellAveragedRadiation( int iLossFunction, double flog_10T0, double flog_10T1, double flog_10n0, double flog_10n1 );
+    double GetCellAveragedRadiation( int iLossFunction, int iNumPoints, double *pfx, double *pflog_10T, double *pflog_10n );
+
+    // Function to return the accuracy and number of segments of the fitted power law (see <CPowerLaw::GetStats>).
+    // Returns False, and sets the values to zero, if there is no fit
+    bool GetPowerLawStats( double *pfMaxError, int *piNumSegments );
+
+    // Function to write the segments of the fitted power law to a text file (see <CPowerLaw::WriteFile>). Returns
+    // False if there is no fit or the file could not be written
+    bool WritePowerLawFile( char *szFilename );
+
   	// Atomic database filename
   	char atomicDBFilename[512];
 